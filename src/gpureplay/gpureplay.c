@@ -0,0 +1,427 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Replays a dump written by the GPU recorder (see gpu_recorder.h) as fast as
+// possible, without emulating the rest of the system, and reports how fast
+// the frames were drawn and a checksum of VRAM.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gpu.h"
+#include "gpu_recorder.h"
+#include "scheduler.h"
+#include "renderer/sw_mt.h"
+
+// Number of GPUREAD words read at once
+#define GPUREAD_WORDS 4096
+
+struct options
+{
+    const char* path;
+
+    // Number of times the dump is replayed
+    unsigned int loops;
+
+    // Number of threads the software renderer draws with
+    unsigned int render_threads;
+
+    // Internal resolution multiplier
+    unsigned int scale;
+
+    // Are GP0 commands executed on a dedicated thread?
+    bool gpu_thread;
+
+    // Is drawing skipped with the null renderer?
+    bool null_renderer;
+
+    // Number of frames skipped after every frame drawn
+    unsigned int frameskip;
+
+    // Is a checksum of VRAM printed at the start of every frame?
+    bool verbose;
+};
+
+// Records of a dump, following the magic number and version
+struct dump
+{
+    uint32_t* words;
+    size_t count;
+};
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: gpureplay [options] dump\n"
+            "  -l N  replay the dump N times (default 1)\n"
+            "  -t N  draw with N threads (default 1)\n"
+            "  -s N  draw at N times the resolution of VRAM (default 1)\n"
+            "  -g    execute GP0 commands on a dedicated thread\n"
+            "  -n    draw nothing, only fills, copies and transfers\n"
+            "  -f N  skip N frames after every frame drawn (default 0)\n"
+            "  -v    print a checksum of VRAM at the start of every frame\n");
+}
+
+// Parses the numeric value of option `argv[*i]`, which must be `min` to
+// `max`, and advances `*i` past it. Returns `false` if there is no valid
+// value.
+static bool parse_number(const int argc,
+                         char** argv,
+                         int* i,
+                         const unsigned int min,
+                         const unsigned int max,
+                         unsigned int* value)
+{
+    if (++*i >= argc)
+    {
+        return false;
+    }
+
+    char* end;
+    const unsigned long n = strtoul(argv[*i], &end, 10);
+
+    if ((*end != '\0') || (n < min) || (n > max))
+    {
+        return false;
+    }
+
+    *value = (unsigned int)n;
+    return true;
+}
+
+static bool parse_options(const int argc,
+                          char** argv,
+                          struct options* options)
+{
+    options->path           = NULL;
+    options->loops          = 1;
+    options->render_threads = 1;
+    options->scale          = 1;
+    options->gpu_thread     = false;
+    options->null_renderer  = false;
+    options->frameskip      = 0;
+    options->verbose        = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        bool ok         = true;
+
+        if (strcmp(arg, "-l") == 0)
+        {
+            ok = parse_number(argc, argv, &i, 1, 1000000, &options->loops);
+        }
+        else if (strcmp(arg, "-t") == 0)
+        {
+            ok = parse_number(argc,
+                              argv,
+                              &i,
+                              1,
+                              256,
+                              &options->render_threads);
+        }
+        else if (strcmp(arg, "-s") == 0)
+        {
+            ok = parse_number(argc,
+                              argv,
+                              &i,
+                              1,
+                              LIBPS_GPU_MAX_SCALE,
+                              &options->scale);
+        }
+        else if (strcmp(arg, "-g") == 0)
+        {
+            options->gpu_thread = true;
+        }
+        else if (strcmp(arg, "-n") == 0)
+        {
+            options->null_renderer = true;
+        }
+        else if (strcmp(arg, "-f") == 0)
+        {
+            ok = parse_number(argc, argv, &i, 0, 1000, &options->frameskip);
+        }
+        else if (strcmp(arg, "-v") == 0)
+        {
+            options->verbose = true;
+        }
+        else if ((arg[0] != '-') && !options->path)
+        {
+            options->path = arg;
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    return options->path != NULL;
+}
+
+// Reads the dump `path` into `dump`. Returns `false` and prints why if it
+// cannot be read or is not a dump.
+static bool load_dump(const char* path, struct dump* dump)
+{
+    FILE* file = fopen(path, "rb");
+
+    if (!file)
+    {
+        fprintf(stderr, "gpureplay: cannot open %s\n", path);
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version;
+
+    if ((fread(magic, 1, sizeof(magic), file) != sizeof(magic)) ||
+        (memcmp(magic, LIBPS_GPU_DUMP_MAGIC, sizeof(magic)) != 0)   ||
+        (fread(&version, sizeof(version), 1, file) != 1)            ||
+        (version != LIBPS_GPU_DUMP_VERSION))
+    {
+        fprintf(stderr, "gpureplay: %s is not a GPU dump\n", path);
+        fclose(file);
+
+        return false;
+    }
+
+    size_t capacity = 1 << 20;
+
+    dump->words = malloc(capacity * sizeof(uint32_t));
+    dump->count = 0;
+
+    for (;;)
+    {
+        if (dump->count == capacity)
+        {
+            capacity   *= 2;
+            dump->words = realloc(dump->words, capacity * sizeof(uint32_t));
+        }
+
+        if (!dump->words)
+        {
+            fprintf(stderr, "gpureplay: out of memory\n");
+            fclose(file);
+
+            return false;
+        }
+
+        const size_t n = fread(&dump->words[dump->count],
+                               sizeof(uint32_t),
+                               capacity - dump->count,
+                               file);
+
+        dump->count += n;
+
+        if (n == 0)
+        {
+            break;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Returns the FNV-1a hash of VRAM.
+static uint32_t checksum_vram(struct libps_gpu* gpu)
+{
+    libps_gpu_sync(gpu);
+
+    uint32_t hash = 2166136261u;
+
+    const uint8_t* bytes = (const uint8_t*)gpu->vram;
+    const size_t size    = LIBPS_GPU_VRAM_WIDTH  *
+                           LIBPS_GPU_VRAM_HEIGHT *
+                           sizeof(uint16_t);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Feeds every record of `dump` to `gpu`, skipping `frameskip` frames after
+// every frame drawn. Returns the number of frames replayed, or -1 if the dump
+// is malformed.
+static long replay(struct libps_gpu* gpu,
+                   const struct dump* dump,
+                   const unsigned int frameskip,
+                   const bool verbose)
+{
+    static uint32_t gpuread[GPUREAD_WORDS];
+
+    long frames = 0;
+
+    for (size_t pos = 0; pos < dump->count;)
+    {
+        const uint32_t header    = dump->words[pos++];
+        const unsigned int count = header & LIBPS_GPU_DUMP_MAX_COUNT;
+        const uint32_t* payload  = &dump->words[pos];
+
+        switch (header >> 24)
+        {
+            case LIBPS_GPU_DUMP_GP0:
+                if (count > (dump->count - pos))
+                {
+                    return -1;
+                }
+
+                libps_gpu_process_gp0_block(gpu, payload, count);
+                pos += count;
+
+                break;
+
+            case LIBPS_GPU_DUMP_GP1:
+                if (count > (dump->count - pos))
+                {
+                    return -1;
+                }
+
+                for (unsigned int i = 0; i < count; ++i)
+                {
+                    libps_gpu_process_gp1(gpu, payload[i]);
+                }
+                pos += count;
+
+                break;
+
+            case LIBPS_GPU_DUMP_GPUREAD:
+                for (unsigned int left = count; left != 0;)
+                {
+                    const unsigned int n =
+                    (left < GPUREAD_WORDS) ? left : GPUREAD_WORDS;
+
+                    libps_gpu_read_gpuread_block(gpu, gpuread, n);
+                    left -= n;
+                }
+                break;
+
+            case LIBPS_GPU_DUMP_FRAME:
+                // A frame is presented at the start of vertical blank, so it
+                // has to be complete.
+                libps_gpu_sync(gpu);
+
+                if (verbose)
+                {
+                    printf("frame %ld: %08X\n", frames, checksum_vram(gpu));
+                }
+                frames++;
+
+                if (frameskip != 0)
+                {
+                    const bool skip = (frames % (frameskip + 1)) != 0;
+                    libps_gpu_set_frame_skipping(gpu, skip);
+                }
+                break;
+
+            default:
+                return -1;
+        }
+    }
+
+    // This also waits for everything to be drawn.
+    libps_gpu_set_frame_skipping(gpu, false);
+    return frames;
+}
+
+// Returns the current time in seconds.
+static double now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char** argv)
+{
+    struct options options;
+
+    if (!parse_options(argc, argv, &options))
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    struct dump dump;
+
+    if (!load_dump(options.path, &dump))
+    {
+        return EXIT_FAILURE;
+    }
+
+    struct libps_scheduler scheduler;
+    struct libps_gpu gpu;
+
+    libps_gpu_setup(&gpu, &scheduler);
+    libps_scheduler_reset(&scheduler);
+
+    if (options.null_renderer)
+    {
+        libps_gpu_set_renderer(&gpu, &libps_renderer_null, NULL);
+    }
+    else if (options.render_threads > 1)
+    {
+        libps_renderer_sw_mt_setup(&gpu, options.render_threads);
+    }
+
+    libps_gpu_set_scale(&gpu, options.scale);
+    libps_gpu_set_threaded(&gpu, options.gpu_thread);
+
+    int status = EXIT_SUCCESS;
+
+    for (unsigned int loop = 0; loop < options.loops; ++loop)
+    {
+        // Every replay starts from the same state; VRAM is restored by the
+        // dump itself.
+        libps_gpu_reset(&gpu);
+
+        const double start = now();
+        const long frames  = replay(&gpu,
+                                    &dump,
+                                    options.frameskip,
+                                    options.verbose);
+        const double time  = now() - start;
+
+        if (frames < 0)
+        {
+            fprintf(stderr, "gpureplay: %s is malformed\n", options.path);
+            status = EXIT_FAILURE;
+
+            break;
+        }
+
+        printf("replay %u: %ld frames in %.3f s, %.1f frames/s, "
+               "VRAM checksum %08X\n",
+               loop + 1,
+               frames,
+               time,
+               (time > 0.0) ? (frames / time) : 0.0,
+               checksum_vram(&gpu));
+    }
+
+    libps_gpu_cleanup(&gpu);
+    free(dump.words);
+
+    return status;
+}
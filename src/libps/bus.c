@@ -31,14 +31,12 @@ static void dma_gpu_vram_write_process(struct libps_bus* bus)
     const uint16_t ba = bus->dma_gpu_channel.bcr >> 16;
     const uint16_t bs = bus->dma_gpu_channel.bcr & 0x0000FFFF;
 
-    for (uint32_t count = 0; count != (ba * bs); ++count)
-    {
-        const uint32_t data =
-        *(uint32_t *)(bus->ram + (bus->dma_gpu_channel.madr & 0x1FFFFFFF));
+    const uint32_t* data =
+    (const uint32_t *)(bus->ram + (bus->dma_gpu_channel.madr & 0x1FFFFFFF));
 
-        libps_gpu_process_gp0(&bus->gpu, data);
-        bus->dma_gpu_channel.madr += 4;
-    }
+    libps_gpu_process_gp0_block(&bus->gpu, data, ba * bs);
+
+    bus->dma_gpu_channel.madr += (ba * bs) * 4;
 }
 
 // Handles processing of DMA channel 2 - GPU (lists + image data) in VRAM read
@@ -50,16 +48,12 @@ static void dma_gpu_vram_read_process(struct libps_bus* bus)
     const uint16_t ba = bus->dma_gpu_channel.bcr >> 16;
     const uint16_t bs = bus->dma_gpu_channel.bcr & 0x0000FFFF;
 
-    for (uint32_t count = 0; count != (ba * bs); ++count)
-    {
-        // Hack (state should be `LIBPS_GPU_TRANSFERRING_DATA`)
-        libps_gpu_process_gp0(&bus->gpu, 0);
+    uint32_t* data =
+    (uint32_t *)(bus->ram + (bus->dma_gpu_channel.madr & 0x1FFFFFFF));
 
-        *(uint32_t *)(bus->ram + (bus->dma_gpu_channel.madr & 0x1FFFFFFF)) =
-        bus->gpu.gpuread;
+    libps_gpu_read_gpuread_block(&bus->gpu, data, ba * bs);
 
-        bus->dma_gpu_channel.madr += 4;
-    }
+    bus->dma_gpu_channel.madr += (ba * bs) * 4;
 }
 
 // Handles processing of DMA channel 2 - GPU (lists + image data) in linked
@@ -164,6 +158,66 @@ static void dma_otc_process(struct libps_bus* bus)
     bus->dma_otc_channel.chcr &= ~(1 << 24);
 }
 
+// Requests interrupt `irq` (one of the `LIBPS_IRQ_*` bits).
+static void raise_interrupt(struct libps_bus* bus, const uint32_t irq)
+{
+    assert(bus != NULL);
+
+    bus->i_stat |= irq;
+
+#ifdef LIBPS_DEBUG
+    if (bus->debug_interrupt_requested)
+    {
+        bus->debug_interrupt_requested(bus->debug_user_data,
+                                       __builtin_ctz(irq));
+    }
+#endif // LIBPS_DEBUG
+}
+
+// Called by the scheduler when the event of root counter `rcnt_id` fires.
+static void rcnt_event(void* user_data, const unsigned int rcnt_id)
+{
+    struct libps_bus* bus = (struct libps_bus*)user_data;
+
+    if (libps_rcnt_process_event(&bus->rcnt, rcnt_id))
+    {
+        raise_interrupt(bus, LIBPS_IRQ_TMR0 << rcnt_id);
+    }
+}
+
+// Called by the scheduler when the GPU's video timing event fires.
+static void gpu_event(void* user_data, const unsigned int param)
+{
+    (void)param;
+
+    struct libps_bus* bus = (struct libps_bus*)user_data;
+    const unsigned int signals = libps_gpu_process_event(&bus->gpu);
+
+    if (signals & (LIBPS_GPU_HBLANK_START | LIBPS_GPU_HBLANK_END))
+    {
+        libps_rcnt_hblank(&bus->rcnt, signals & LIBPS_GPU_HBLANK_START);
+    }
+
+    if (signals & (LIBPS_GPU_VBLANK_START | LIBPS_GPU_VBLANK_END))
+    {
+        libps_rcnt_vblank(&bus->rcnt, signals & LIBPS_GPU_VBLANK_START);
+    }
+
+    if (signals & LIBPS_GPU_VBLANK_START)
+    {
+        raise_interrupt(bus, LIBPS_IRQ_VBLANK);
+    }
+}
+
+// Tells the root counters about the GPU's current video timing and blanking
+// state.
+static void sync_video_timing(struct libps_bus* bus)
+{
+    libps_rcnt_set_video_timing(&bus->rcnt,
+                                bus->gpu.video.dotclock_divider,
+                                bus->gpu.video.scanline_clocks);
+}
+
 // Initializes the system bus. The system bus is the interconnect between the
 // CPU and devices, and accordingly has primary ownership of devices. The
 // system bus does not directly know about the CPU, however.
@@ -185,8 +239,33 @@ void libps_bus_setup(struct libps_bus* bus, uint8_t* const bios_data_ptr)
 #endif // LIBPS_DEBUG
     bus->ram = libps_safe_malloc(0x200000);
 
-    libps_gpu_setup(&bus->gpu);
+    libps_gpu_setup(&bus->gpu, &bus->scheduler);
     libps_cdrom_setup(&bus->cdrom);
+    libps_rcnt_setup(&bus->rcnt, &bus->scheduler);
+
+    libps_scheduler_set_callback(&bus->scheduler,
+                                 LIBPS_EVENT_RCNT0,
+                                 &rcnt_event,
+                                 bus,
+                                 0);
+
+    libps_scheduler_set_callback(&bus->scheduler,
+                                 LIBPS_EVENT_RCNT1,
+                                 &rcnt_event,
+                                 bus,
+                                 1);
+
+    libps_scheduler_set_callback(&bus->scheduler,
+                                 LIBPS_EVENT_RCNT2,
+                                 &rcnt_event,
+                                 bus,
+                                 2);
+
+    libps_scheduler_set_callback(&bus->scheduler,
+                                 LIBPS_EVENT_GPU,
+                                 &gpu_event,
+                                 bus,
+                                 0);
 }
 
 // Destroys the system bus, destroying all memory and devices. Please note that
@@ -216,13 +295,20 @@ void libps_bus_reset(struct libps_bus* bus)
     memset(&bus->dma_gpu_channel, 0, sizeof(bus->dma_gpu_channel));
     memset(&bus->dma_otc_channel, 0, sizeof(bus->dma_otc_channel));
 
+    libps_scheduler_reset(&bus->scheduler);
+
     libps_gpu_reset(&bus->gpu);
     libps_cdrom_reset(&bus->cdrom);
     libps_rcnt_reset(&bus->rcnt);
+
+    sync_video_timing(bus);
+    libps_rcnt_hblank(&bus->rcnt, bus->gpu.video.in_hblank);
+    libps_rcnt_vblank(&bus->rcnt, bus->gpu.video.in_vblank);
 }
 
-// Handles DMA requests.
-void libps_bus_step(struct libps_bus* bus)
+// Handles DMA requests and advances the devices which are not driven by the
+// scheduler by `cycles` system clock cycles.
+void libps_bus_step(struct libps_bus* bus, const unsigned int cycles)
 {
     assert(bus != NULL);
 
@@ -288,19 +374,10 @@ void libps_bus_step(struct libps_bus* bus)
     if (bus->cdrom.fire_interrupt)
     {
         bus->cdrom.fire_interrupt = false;
-        bus->i_stat |= LIBPS_IRQ_CDROM;
-
-#ifdef LIBPS_DEBUG
-        if (bus->debug_interrupt_requested)
-        {
-            bus->debug_interrupt_requested(bus->debug_user_data,
-                                           2);
-        }
-#endif // LIBPS_DEBUG
+        raise_interrupt(bus, LIBPS_IRQ_CDROM);
     }
 
-    libps_cdrom_step(&bus->cdrom);
-    libps_rcnt_step(&bus->rcnt);
+    libps_cdrom_step(&bus->cdrom, cycles);
 }
 
 // Stores word `data` into memory referenced by virtual address `vaddr`.
@@ -412,14 +489,12 @@ void libps_bus_store_word(struct libps_bus* bus,
                             bus->dicr = data;
                             break;
 
-                        // 0x1F801114 - Timer 1 Counter Mode (R/W)
-                        case 0x114:
-                            libps_rcnt_set_mode(&bus->rcnt, 1, data);
-                            break;
-
-                        // 0x1F801118 - Timer 1 Counter Target Value (R/W)
-                        case 0x118:
-                            bus->rcnt.rcnts[1].target = data;
+                        // 0x1F801100..0x1F80112F - Timers (aka Root
+                        // counters)
+                        case 0x100 ... 0x12F:
+                            libps_rcnt_register_store(&bus->rcnt,
+                                                      paddr & 0x000000FF,
+                                                      data & 0x0000FFFF);
                             break;
 
                         // 0x1F801810 - GP0 Commands/Packets (Rendering and
@@ -431,6 +506,7 @@ void libps_bus_store_word(struct libps_bus* bus,
                         // 0x1F801814 - GP1 Commands (Display Control)
                         case 0x814:
                             libps_gpu_process_gp1(&bus->gpu, data);
+                            sync_video_timing(bus);
                             break;
 #ifdef LIBPS_DEBUG
                         default:
@@ -500,49 +576,12 @@ void libps_bus_store_halfword(struct libps_bus* bus,
                             bus->i_mask = data;
                             break;
 
-                        // 0x1F801100 - Timer 0 Counter Value (R/W)
-                        case 0x100:
-                            bus->rcnt.rcnts[0].value = data;
-                            break;
-
-                        // 0x1F801104 - Timer 0 Counter Mode (R/W)
-                        case 0x104:
-                            libps_rcnt_set_mode(&bus->rcnt, 0, data);
-                            break;
-
-                        // 0x1F801108 - Timer 0 Counter Target Value (R/W)
-                        case 0x108:
-                            bus->rcnt.rcnts[0].target = data;
-                            break;
-
-                        // 0x1F801110 - Timer 1 Counter Value (R/W)
-                        case 0x110:
-                            bus->rcnt.rcnts[1].value = data;
-                            break;
-
-                        // 0x1F801114 - Timer 1 Counter Mode (R/W)
-                        case 0x114:
-                            libps_rcnt_set_mode(&bus->rcnt, 1, data);
-                            break;
-
-                        // 0x1F801118 - Timer 1 Counter Target Value (R/W)
-                        case 0x118:
-                            bus->rcnt.rcnts[1].target = data;
-                            break;
-
-                        // 0x1F801120 - Timer 2 Counter Value (R/W)
-                        case 0x120:
-                            bus->rcnt.rcnts[2].value = data;
-                            break;
-
-                        // 0x1F801124 - Timer 2 Counter Mode (R/W)
-                        case 0x124:
-                            libps_rcnt_set_mode(&bus->rcnt, 2, data);
-                            break;
-
-                        // 0x1F801128 - Timer 2 Counter Target Value (R/W)
-                        case 0x128:
-                            bus->rcnt.rcnts[2].target = data;
+                        // 0x1F801100..0x1F80112F - Timers (aka Root
+                        // counters)
+                        case 0x100 ... 0x12F:
+                            libps_rcnt_register_store(&bus->rcnt,
+                                                      paddr & 0x000000FF,
+                                                      data);
                             break;
 #ifdef LIBPS_DEBUG
                         default:
@@ -723,18 +762,20 @@ uint32_t libps_bus_load_word(struct libps_bus* bus, const uint32_t vaddr)
                         case 0x0F4:
                             return bus->dicr;
 
-                        // 0x1F801110 - Timer 1 Counter Value (R/W)
-                        case 0x110:
-                            return bus->rcnt.rcnts[1].value;
+                        // 0x1F801100..0x1F80112F - Timers (aka Root
+                        // counters)
+                        case 0x100 ... 0x12F:
+                            return libps_rcnt_register_load(&bus->rcnt,
+                                                            paddr & 0x000000FF);
 
                         // 0x1F801810 - Read responses to GP0(C0h) and GP1(10h)
                         // commands
                         case 0x810:
-                            return bus->gpu.gpuread;
+                            return libps_gpu_read_gpuread(&bus->gpu);
 
                         // 0x1F801814 - GPU Status Register (R)
                         case 0x814:
-                            return 0x1FF00000;
+                            return libps_gpu_read_gpustat(&bus->gpu);
 
                         default:
 #ifdef LIBPS_DEBUG
@@ -809,9 +850,11 @@ uint16_t libps_bus_load_halfword(struct libps_bus* bus, const uint32_t vaddr)
                         case 0x074:
                             return bus->i_mask & 0x0000FFFF;
 
-                        // 0x1F801120 - Timer 2 (1/8 system clock) value
-                        case 0x120:
-                            return bus->rcnt.rcnts[2].value & 0x0000FFFF;
+                        // 0x1F801100..0x1F80112F - Timers (aka Root
+                        // counters)
+                        case 0x100 ... 0x12F:
+                            return libps_rcnt_register_load(&bus->rcnt,
+                                                            paddr & 0x000000FF);
 
                         default:
 #ifdef LIBPS_DEBUG
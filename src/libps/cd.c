@@ -121,8 +121,9 @@ void libps_cdrom_reset(struct libps_cdrom* cdrom)
     cdrom->fire_interrupt = false;
 }
 
-// Checks to see if interrupts needs to be fired.
-void libps_cdrom_step(struct libps_cdrom* cdrom)
+// Advances the CD-ROM drive by `cycles` system clock cycles, checking to see if
+// interrupts need to be fired.
+void libps_cdrom_step(struct libps_cdrom* cdrom, const unsigned int cycles)
 {
     assert(cdrom != NULL);
 
@@ -152,7 +153,7 @@ void libps_cdrom_step(struct libps_cdrom* cdrom)
         }
         else
         {
-            cdrom->sector_read_cycle_count++;
+            cdrom->sector_read_cycle_count += cycles;
         }
     }
 
@@ -160,9 +161,9 @@ void libps_cdrom_step(struct libps_cdrom* cdrom)
     if ((cdrom->current_interrupt != NULL) &&
          cdrom->current_interrupt->pending)
     {
-        if (cdrom->current_interrupt->cycles != 0)
+        if (cdrom->current_interrupt->cycles > cycles)
         {
-            cdrom->current_interrupt->cycles--;
+            cdrom->current_interrupt->cycles -= cycles;
         }
         else
         {
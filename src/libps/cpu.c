@@ -33,6 +33,12 @@
 //
 // * No support for load delays. Undoubtedly will be required for games, but
 //   apparently they don't seem to be required for the BIOS.
+//
+// * Instruction timing is approximated: every instruction costs the time it
+//   takes to fetch it, plus the wait states of any memory access it performs
+//   and any stall waiting on a multiplication or division. Since there is no
+//   instruction cache, fetches from cached regions are assumed to always hit.
+//   Branches have no additional cost; the delay slot hides the redirect.
 
 #include <assert.h>
 #include <stdlib.h>
@@ -52,6 +58,137 @@ static struct libps_bus* bus;
 
 static bool in_delay_slot = false;
 
+// Access times in system clock cycles, using the delay/size settings the BIOS
+// programs into the memory control registers.
+#define CYCLES_CACHED_FETCH 1
+#define CYCLES_RAM 5
+#define CYCLES_SCRATCHPAD 1
+#define CYCLES_IO 3
+#define CYCLES_STORE 1
+
+// The BIOS ROM, expansion region 1 and the CD-ROM controller sit on an 8-bit
+// bus, and the SPU on a 16-bit bus, so wider accesses are split up.
+#define CYCLES_BIOS_PER_BYTE 6
+#define CYCLES_EXP1_PER_BYTE 6
+#define CYCLES_CDROM_PER_BYTE 8
+#define CYCLES_SPU_PER_HALFWORD 18
+
+// Multiplication time depends on the magnitude of the first operand.
+#define CYCLES_MULT_SMALL 6
+#define CYCLES_MULT_MEDIUM 9
+#define CYCLES_MULT_LARGE 13
+#define CYCLES_DIV 36
+
+// Returns the number of cycles a read of `size` bytes from virtual address
+// `vaddr` takes.
+static unsigned int access_cycles(const uint32_t vaddr,
+                                  const unsigned int size)
+{
+    const uint32_t paddr = vaddr & 0x1FFFFFFF;
+
+    switch (paddr)
+    {
+        // Main RAM, including its mirrors
+        case 0x00000000 ... 0x007FFFFF:
+            return CYCLES_RAM;
+
+        // Expansion Region 1
+        case 0x1F000000 ... 0x1F7FFFFF:
+            return CYCLES_EXP1_PER_BYTE * size;
+
+        // Scratchpad
+        case 0x1F800000 ... 0x1F8003FF:
+            return CYCLES_SCRATCHPAD;
+
+        // CD-ROM controller
+        case 0x1F801800 ... 0x1F80180F:
+            return CYCLES_CDROM_PER_BYTE * size;
+
+        // SPU
+        case 0x1F801C00 ... 0x1F801FFF:
+            return CYCLES_SPU_PER_HALFWORD * ((size + 1) / 2);
+
+        // Remaining I/O ports
+        case 0x1F801000 ... 0x1F8017FF:
+        case 0x1F801810 ... 0x1F801BFF:
+            return CYCLES_IO;
+
+        // BIOS ROM
+        case 0x1FC00000 ... 0x1FC7FFFF:
+            return CYCLES_BIOS_PER_BYTE * size;
+
+        default:
+            return CYCLES_IO;
+    }
+}
+
+// Returns the number of cycles a store of `size` bytes to virtual address
+// `vaddr` takes. Stores to RAM and the scratchpad go through the write buffer
+// and do not stall the CPU.
+static unsigned int store_cycles(const uint32_t vaddr,
+                                 const unsigned int size)
+{
+    const uint32_t paddr = vaddr & 0x1FFFFFFF;
+
+    if ((paddr < 0x00800000) ||
+        ((paddr >= 0x1F800000) && (paddr <= 0x1F8003FF)))
+    {
+        return CYCLES_STORE;
+    }
+    return access_cycles(vaddr, size);
+}
+
+// Returns the number of cycles fetching the instruction at virtual address
+// `vaddr` takes.
+static unsigned int fetch_cycles(const uint32_t vaddr)
+{
+    // KSEG1 is uncached; everything else is assumed to hit the instruction
+    // cache.
+    if ((vaddr >= 0xA0000000) && (vaddr <= 0xBFFFFFFF))
+    {
+        return access_cycles(vaddr, 4);
+    }
+    return CYCLES_CACHED_FETCH;
+}
+
+// Returns the number of cycles a multiplication with first operand `rs`
+// takes. `is_signed` selects between MULT and MULTU.
+static unsigned int mult_cycles(const uint32_t rs, const bool is_signed)
+{
+    // Count the significant bits of the operand.
+    const uint32_t magnitude =
+    (is_signed && (rs & 0x80000000)) ? ~rs : rs;
+
+    if (magnitude < 0x00000800)
+    {
+        return CYCLES_MULT_SMALL;
+    }
+
+    if (magnitude < 0x00100000)
+    {
+        return CYCLES_MULT_MEDIUM;
+    }
+    return CYCLES_MULT_LARGE;
+}
+
+// Lets the multiplier run alongside an instruction which took `cycles` cycles,
+// and returns `cycles`.
+static unsigned int retire(struct libps_cpu* cpu, const unsigned int cycles)
+{
+    cpu->hilo_cycles = (cpu->hilo_cycles > cycles) ?
+                       (cpu->hilo_cycles - cycles) : 0;
+    return cycles;
+}
+
+// Returns the number of cycles the CPU stalls for when reading HI/LO.
+static unsigned int hilo_stall(struct libps_cpu* cpu)
+{
+    const unsigned int stall = cpu->hilo_cycles;
+
+    cpu->hilo_cycles = 0;
+    return stall;
+}
+
 // Throws exception `exccode`.
 static void raise_exception(struct libps_cpu* cpu,
                             const unsigned int exccode,
@@ -112,14 +249,17 @@ void libps_cpu_reset(struct libps_cpu* cpu)
     memset(cpu->gpr,      0, sizeof(cpu->gpr));
     memset(cpu->cop0_cpr, 0, sizeof(cpu->cop0_cpr));
 
+    cpu->hilo_cycles = 0;
+
     cpu->pc      = 0xBFC00000;
     cpu->next_pc = 0xBFC00000;
 
     cpu->instruction = libps_bus_load_word(bus, cpu->pc);
 }
 
-// Executes one instruction.
-void libps_cpu_step(struct libps_cpu* cpu)
+// Executes one instruction, returning the number of system clock cycles it
+// took.
+unsigned int libps_cpu_step(struct libps_cpu* cpu)
 {
     assert(cpu != NULL);
 
@@ -130,9 +270,12 @@ void libps_cpu_step(struct libps_cpu* cpu)
         raise_exception(cpu, LIBPS_CPU_EXCCODE_Int, UNUSED);
 
         cpu->instruction = libps_bus_load_word(bus, cpu->pc += 4);
-        return;
+        return retire(cpu, fetch_cycles(cpu->pc));
     }
 
+    // The cost of the instruction itself is the cost of having fetched it.
+    unsigned int cycles = fetch_cycles(cpu->next_pc);
+
     cpu->pc = cpu->next_pc;
     cpu->next_pc += 4;
 
@@ -236,6 +379,8 @@ void libps_cpu_step(struct libps_cpu* cpu)
 #endif // LIBPS_DEBUG
 
                 case LIBPS_CPU_OP_MFHI:
+                    cycles += hilo_stall(cpu);
+
                     cpu->gpr[LIBPS_CPU_DECODE_RD(cpu->instruction)] =
                     cpu->reg_hi;
 
@@ -248,6 +393,8 @@ void libps_cpu_step(struct libps_cpu* cpu)
                     break;
 
                 case LIBPS_CPU_OP_MFLO:
+                    cycles += hilo_stall(cpu);
+
                     cpu->gpr[LIBPS_CPU_DECODE_RD(cpu->instruction)] =
                     cpu->reg_lo;
 
@@ -268,6 +415,9 @@ void libps_cpu_step(struct libps_cpu* cpu)
                     cpu->reg_lo = result & 0x00000000FFFFFFFF;
                     cpu->reg_hi = result >> 32;
 
+                    cpu->hilo_cycles =
+                    mult_cycles(cpu->gpr[LIBPS_CPU_DECODE_RS(cpu->instruction)],
+                                true);
                     break;
                 }
 
@@ -280,6 +430,9 @@ void libps_cpu_step(struct libps_cpu* cpu)
                     cpu->reg_lo = result & 0x00000000FFFFFFFF;
                     cpu->reg_hi = result >> 32;
 
+                    cpu->hilo_cycles =
+                    mult_cycles(cpu->gpr[LIBPS_CPU_DECODE_RS(cpu->instruction)],
+                                false);
                     break;
                 }
 
@@ -294,6 +447,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
                     const int32_t rs =
                     (int32_t)cpu->gpr[LIBPS_CPU_DECODE_RS(cpu->instruction)];
 
+                    cpu->hilo_cycles = CYCLES_DIV;
 #ifdef LIBPS_DEBUG
                     // Divisor is zero
                     if (rt == 0)
@@ -334,6 +488,8 @@ void libps_cpu_step(struct libps_cpu* cpu)
                     
                     const uint32_t rs =
                     cpu->gpr[LIBPS_CPU_DECODE_RS(cpu->instruction)];
+
+                    cpu->hilo_cycles = CYCLES_DIV;
 #ifdef LIBPS_DEBUG
                     // In the case of unsigned division, the dividend can't be
                     // negative and thus the quotient is always -1 (0xFFFFFFFF)
@@ -649,6 +805,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             cpu->gpr[LIBPS_CPU_DECODE_BASE(cpu->instruction)];
 
             const int8_t data = (int8_t)libps_bus_load_byte(bus, vaddr);
+            cycles += access_cycles(vaddr, 1);
 
             cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] = data;
             break;
@@ -667,6 +824,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             }
 #endif // LIBPS_DEBUG
             const int16_t data = (int16_t)libps_bus_load_halfword(bus, vaddr);
+            cycles += access_cycles(vaddr, 2);
 
             cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] = data;
             break;
@@ -679,6 +837,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             cpu->gpr[LIBPS_CPU_DECODE_BASE(cpu->instruction)];
 
             const uint32_t data = libps_bus_load_word(bus, vaddr & 0xFFFFFFFC);
+            cycles += access_cycles(vaddr, 4);
 
             const unsigned int rt = LIBPS_CPU_DECODE_RT(cpu->instruction);
 
@@ -721,6 +880,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
 #endif // LIBPS_DEBUG
 
             const uint32_t data = libps_bus_load_word(bus, vaddr);
+            cycles += access_cycles(vaddr, 4);
 
             cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] = data;
             break;
@@ -733,6 +893,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             cpu->gpr[LIBPS_CPU_DECODE_BASE(cpu->instruction)];
 
             const uint8_t data = libps_bus_load_byte(bus, vaddr);
+            cycles += access_cycles(vaddr, 1);
 
             cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] = data;
             break;
@@ -752,6 +913,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
 #endif // LIBPS_DEBUG
 
             const uint16_t data = libps_bus_load_halfword(bus, vaddr);
+            cycles += access_cycles(vaddr, 2);
 
             cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] = data;
             break;
@@ -764,6 +926,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             cpu->gpr[LIBPS_CPU_DECODE_BASE(cpu->instruction)];
 
             const uint32_t data = libps_bus_load_word(bus, vaddr & 0xFFFFFFFC);
+            cycles += access_cycles(vaddr, 4);
 
             const unsigned int rt = LIBPS_CPU_DECODE_RT(cpu->instruction);
 
@@ -797,6 +960,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             libps_bus_store_byte(bus,
                                  vaddr,
                 cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] & 0x000000FF);
+            cycles += store_cycles(vaddr, 1);
             break;
         }
 
@@ -817,6 +981,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             libps_bus_store_halfword(bus,
                                      vaddr,
                  cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)] & 0x0000FFFF);
+            cycles += store_cycles(vaddr, 2);
             break;
         }
 
@@ -829,6 +994,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             const unsigned int rt = LIBPS_CPU_DECODE_RT(cpu->instruction);
 
             uint32_t data = libps_bus_load_word(bus, vaddr & 0xFFFFFFFC);
+            cycles += store_cycles(vaddr, 4);
 
             switch (vaddr & 3)
             {
@@ -873,6 +1039,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
                 libps_bus_store_word(bus,
                                      vaddr,
                               cpu->gpr[LIBPS_CPU_DECODE_RT(cpu->instruction)]);
+                cycles += store_cycles(vaddr, 4);
             }
             break;
         }
@@ -886,6 +1053,7 @@ void libps_cpu_step(struct libps_cpu* cpu)
             const unsigned int rt = LIBPS_CPU_DECODE_RT(cpu->instruction);
 
             uint32_t data = libps_bus_load_word(bus, vaddr & 0xFFFFFFFC);
+            cycles += store_cycles(vaddr, 4);
 
             switch (vaddr & 3)
             {
@@ -925,4 +1093,6 @@ void libps_cpu_step(struct libps_cpu* cpu)
 
     cpu->instruction = libps_bus_load_word(bus, cpu->pc += 4);
     cpu->gpr[0] = 0x00000000;
+
+    return retire(cpu, cycles);
 }
@@ -18,624 +18,1331 @@
 #include <stdio.h>
 #include "cpu_defs.h"
 #include "gpu.h"
+#include "gpu_frameskip.h"
+#include "gpu_recorder.h"
+#include "gpu_thread.h"
+#include "scheduler.h"
+#include "utility/math.h"
 #include "utility/memory.h"
 #include "renderer/sw.h"
+#include "renderer/sw_texture.h"
+#include "renderer/sw_vram.h"
+
+// GPUSTAT bits
+#define GPUSTAT_INTERLACE_FIELD (1 << 13)
+#define GPUSTAT_VERTICAL_RESOLUTION (1 << 19)
+#define GPUSTAT_VIDEO_MODE_PAL (1 << 20)
+#define GPUSTAT_COLOR_DEPTH_24BIT (1 << 21)
+#define GPUSTAT_VERTICAL_INTERLACE (1 << 22)
+#define GPUSTAT_DISPLAY_DISABLED (1 << 23)
+#define GPUSTAT_DMA_REQUEST (1 << 25)
+#define GPUSTAT_READY_CMD (1 << 26)
+#define GPUSTAT_READY_VRAM_TO_CPU (1 << 27)
+#define GPUSTAT_READY_DMA (1 << 28)
+#define GPUSTAT_ODD_LINE (1U << 31)
 
 static void (*cmd_func)(struct libps_gpu*);
 static unsigned int params_pos;
 
-// Handles the GP0(A0h) command - Copy Rectangle (CPU to VRAM)
-static void copy_rect_from_cpu(struct libps_gpu* gpu)
+// Waits for the renderer to finish drawing. Commands which access VRAM
+// directly call this, on whichever thread executes GP0 commands.
+static void sync_renderer(struct libps_gpu* gpu)
 {
     assert(gpu != NULL);
 
-    // Current X position
-    static unsigned int vram_x_pos;
-
-    // Current Y position
-    static unsigned int vram_y_pos;
-
-    // Maximum length of a line (should be Xxxx+Xsiz)
-    static unsigned int vram_x_pos_max;
-
-    if (gpu->state == LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS)
+    if (gpu->renderer->sync)
     {
-        const uint16_t width =
-        (((gpu->cmd_packet.params[1] & 0x0000FFFF) - 1) & 0x000003FF) + 1;
+        gpu->renderer->sync(gpu);
+    }
+}
 
-        const uint16_t height =
-        (((gpu->cmd_packet.params[1] >> 16) - 1) & 0x000001FF) + 1;
+// Makes the statistics of the frame in progress those of the last complete
+// frame, and starts over. The GPU must have been synced.
+static void finish_frame_stats(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
 
-        vram_x_pos =
-        ((gpu->cmd_packet.params[0] & 0x0000FFFF) & 0x000003FF);
+    struct libps_gpu_stats* stats = &gpu->stats;
 
-        vram_y_pos =
-        ((gpu->cmd_packet.params[0] >> 16) & 0x000001FF);
+    stats->texture_cache_hits   = gpu->texture_cache->hits;
+    stats->texture_cache_misses = gpu->texture_cache->misses;
 
-        vram_x_pos_max = vram_x_pos + width;
+    gpu->texture_cache->hits   = 0;
+    gpu->texture_cache->misses = 0;
 
-        gpu->cmd_packet.remaining_words = (width * height) / 2;
+    // Pixels are counted as written when the primitive is submitted, but
+    // only the renderer can tell which of them are masked.
+    stats->pixels_written -= stats->pixels_masked;
 
-        // Lock the GP0 state to this function.
-        gpu->state = LIBPS_GPU_RECEIVING_COMMAND_DATA;
+    gpu->frame_stats = *stats;
+    memset(stats, 0, sizeof(*stats));
+}
 
-        // Again, we don't want to do anything until we receive at least one
-        // data word.
-        return;
-    }
+// Records that the inclusive screen area (`x1`, `y1`) - (`x2`, `y2`) has been
+// drawn to. Only the part inside the drawing area can actually change.
+static void mark_drawn(struct libps_gpu* gpu,
+                       int32_t x1,
+                       int32_t y1,
+                       int32_t x2,
+                       int32_t y2)
+{
+    x1 = LIBPS_MAX(x1, (int32_t)gpu->drawing_area.x1);
+    y1 = LIBPS_MAX(y1, (int32_t)gpu->drawing_area.y1);
+    x2 = LIBPS_MIN(x2, (int32_t)gpu->drawing_area.x2);
+    y2 = LIBPS_MIN(y2, (int32_t)gpu->drawing_area.y2);
 
-    if (gpu->state == LIBPS_GPU_RECEIVING_COMMAND_DATA)
+    if ((x1 <= x2) && (y1 <= y2))
     {
-        if (gpu->cmd_packet.remaining_words != 0)
-        {
-            gpu->vram[vram_x_pos++ + (LIBPS_GPU_VRAM_WIDTH * vram_y_pos)] =
-            gpu->received_data & 0x0000FFFF;
-
-            if (vram_x_pos >= vram_x_pos_max)
-            {
-                vram_y_pos++;
-                vram_x_pos = ((gpu->cmd_packet.params[0] & 0x0000FFFF) & 0x000003FF);
-            }
-
-            gpu->vram[vram_x_pos++ + (LIBPS_GPU_VRAM_WIDTH * vram_y_pos)] =
-            gpu->received_data >> 16;
+        libps_gpu_mark_vram(gpu, x1, y1, (x2 - x1) + 1, (y2 - y1) + 1);
+    }
+}
 
-            if (vram_x_pos >= vram_x_pos_max)
-            {
-                vram_y_pos++;
-                vram_x_pos = ((gpu->cmd_packet.params[0] & 0x0000FFFF) & 0x000003FF);
-            }
-            gpu->cmd_packet.remaining_words--;
-        }
-        else
-        {
-            // All of the expected data has been sent. Return to normal
-            // operation.
-            memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-            params_pos = 0;
+// Recomputes the GPUSTAT bits which reflect the drawing mode and the mask
+// settings, and publishes them if GP0 commands run on the GPU thread.
+static void update_draw_status(struct libps_gpu* gpu)
+{
+    // GP0(E1h) bits 0-10 are GPUSTAT bits 0-10 and bit 11 is GPUSTAT bit 15.
+    // GP0(E6h) bits 0-1 are GPUSTAT bits 11-12.
+    gpu->draw_status = (gpu->draw_mode & 0x07FF)         |
+                       ((gpu->draw_mode & 0x0800) << 4)  |
+                       (gpu->mask_settings << 11);
 
-            gpu->state = LIBPS_GPU_AWAITING_COMMAND;
-        }
+    if (gpu->thread)
+    {
+        libps_gpu_thread_set_status(gpu->thread, gpu->draw_status);
     }
 }
 
-// Handles the GP0(C0h) command - Copy Rectangle (VRAM to CPU)
-static void copy_rect_to_cpu(struct libps_gpu* gpu)
+// Returns the absolute system clock cycle on which GPU clock `gpu_clock`
+// begins. The GPU clock runs at 11/7 times the system clock.
+static uint64_t gpu_clock_to_cycles(const uint64_t gpu_clock)
+{
+    return ((gpu_clock * 7) + 10) / 11;
+}
+
+// Derives the video timing parameters from the display mode in GPUSTAT.
+static void update_video_timing(struct libps_gpu* gpu)
 {
     assert(gpu != NULL);
 
-    // Current X position
-    static unsigned int vram_x_pos;
+    if (gpu->gpustat & GPUSTAT_VIDEO_MODE_PAL)
+    {
+        gpu->video.scanline_clocks = 3406;
+        gpu->video.scanlines       = 314;
+    }
+    else
+    {
+        gpu->video.scanline_clocks = 3413;
+        gpu->video.scanlines       = 263;
+    }
+
+    // Horizontal Resolution 2 (bit 16) overrides Horizontal Resolution 1
+    // (bits 17-18).
+    static const unsigned int dotclock_dividers[4] = { 10, 8, 5, 4 };
 
-    // Current Y position
-    static unsigned int vram_y_pos;
+    gpu->video.dotclock_divider = (gpu->gpustat & (1 << 16)) ?
+                                  7 :
+                                  dotclock_dividers[(gpu->gpustat >> 17) & 3];
+}
 
-    // Maximum length of a line (should be Xxxx+Xsiz)
-    static unsigned int vram_x_pos_max;
+// Returns the GPU clock (relative to the start of a scanline) the horizontal
+// blanking period ends on and the one it starts on.
+static void hblank_bounds(const struct libps_gpu* gpu,
+                          unsigned int* end,
+                          unsigned int* start)
+{
+    unsigned int x2 = gpu->display_x2;
+    unsigned int x1 = gpu->display_x1;
 
-    if (gpu->state == LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS)
+    if (x2 >= gpu->video.scanline_clocks)
     {
-        const uint16_t width =
-        (((gpu->cmd_packet.params[1] & 0x0000FFFF) - 1) & 0x000003FF) + 1;
+        x2 = gpu->video.scanline_clocks - 1;
+    }
+
+    // An empty display range would leave no time outside of horizontal
+    // blanking (or none inside it); fall back to the standard range.
+    if (x1 >= x2)
+    {
+        x1 = 0x260;
+        x2 = 0xC60;
+    }
 
-        const uint16_t height =
-        (((gpu->cmd_packet.params[1] >> 16) - 1) & 0x000001FF) + 1;
+    *end   = x1;
+    *start = x2;
+}
 
-        vram_x_pos =
-        ((gpu->cmd_packet.params[0] & 0x0000FFFF) & 0x000003FF);
+// Returns `true` if scanline `scanline` is inside the vertical blanking
+// period, which spans everything outside of the vertical display range.
+static bool in_vblank(const struct libps_gpu* gpu, const unsigned int scanline)
+{
+    unsigned int y1 = gpu->display_y1;
+    unsigned int y2 = gpu->display_y2;
 
-        vram_y_pos =
-        ((gpu->cmd_packet.params[0] >> 16) & 0x000001FF);
+    if (y2 > gpu->video.scanlines)
+    {
+        y2 = gpu->video.scanlines;
+    }
 
-        vram_x_pos_max = vram_x_pos + width;
+    // An empty display range would never leave vertical blanking, and thus
+    // never produce a frame; fall back to the standard range.
+    if (y1 >= y2)
+    {
+        const bool pal = gpu->gpustat & GPUSTAT_VIDEO_MODE_PAL;
 
-        gpu->cmd_packet.remaining_words = (width * height) / 2;
+        y1 = pal ? 20  : 16;
+        y2 = pal ? 308 : 256;
+    }
+    return (scanline < y1) || (scanline >= y2);
+}
 
-        // Lock the GP0 state to this function.
-        gpu->state = LIBPS_GPU_TRANSFERRING_DATA;
+// Updates the bits of GPUSTAT which depend on the beam position.
+static void update_field_bits(struct libps_gpu* gpu)
+{
+    const bool interlaced = gpu->gpustat & GPUSTAT_VERTICAL_INTERLACE;
 
-        return;
+    // Bit 13 is always set when not interlacing.
+    if (!interlaced || gpu->video.odd_field)
+    {
+        gpu->gpustat |= GPUSTAT_INTERLACE_FIELD;
+    }
+    else
+    {
+        gpu->gpustat &= ~GPUSTAT_INTERLACE_FIELD;
     }
 
-    if (gpu->state == LIBPS_GPU_TRANSFERRING_DATA)
+    // Bit 31 changes per frame in 480-line mode, per scanline otherwise, and
+    // is always zero during vertical blanking.
+    bool odd;
+
+    if (gpu->video.in_vblank)
     {
-        if (gpu->cmd_packet.remaining_words != 0)
-        {
-            const uint16_t pixel0 =
-            gpu->vram[vram_x_pos++ + (LIBPS_GPU_VRAM_WIDTH * vram_y_pos)];
+        odd = false;
+    }
+    else if (interlaced && (gpu->gpustat & (1 << 19)))
+    {
+        odd = gpu->video.odd_field;
+    }
+    else
+    {
+        odd = gpu->video.scanline & 1;
+    }
 
-            if (vram_x_pos >= vram_x_pos_max)
-            {
-                vram_y_pos++;
-                vram_x_pos = ((gpu->cmd_packet.params[0] & 0x0000FFFF) & 0x000003FF);
-            }
+    if (odd)
+    {
+        gpu->gpustat |= GPUSTAT_ODD_LINE;
+    }
+    else
+    {
+        gpu->gpustat &= ~GPUSTAT_ODD_LINE;
+    }
+}
 
-            const uint16_t pixel1 =
-            gpu->vram[vram_x_pos++ + (LIBPS_GPU_VRAM_WIDTH * vram_y_pos)];
+// Schedules the next video timing event.
+static void schedule_video_event(struct libps_gpu* gpu)
+{
+    unsigned int hblank_end;
+    unsigned int hblank_start;
 
-            if (vram_x_pos >= vram_x_pos_max)
-            {
-                vram_y_pos++;
-                vram_x_pos = ((gpu->cmd_packet.params[0] & 0x0000FFFF) & 0x000003FF);
-            }
+    hblank_bounds(gpu, &hblank_end, &hblank_start);
 
-            gpu->gpuread = ((pixel1 << 16) | pixel0);
-            gpu->cmd_packet.remaining_words--;
-        }
-        else
-        {
-            // All of the expected data has been sent. Return to normal
-            // operation.
-            memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-            params_pos = 0;
+    const uint64_t next = gpu->video.line_start +
+                          (gpu->video.in_hblank ? hblank_end : hblank_start);
 
-            gpu->state = LIBPS_GPU_AWAITING_COMMAND;
-        }
-    }
+    libps_scheduler_schedule(gpu->scheduler,
+                             LIBPS_EVENT_GPU,
+                             gpu_clock_to_cycles(next));
 }
 
-static void fill_rect_in_vram(struct libps_gpu* gpu)
+// Starts a GP0(A0h) or GP0(C0h) transfer from the command parameters.
+static void start_transfer(struct libps_gpu* gpu)
 {
-    const unsigned int color = gpu->cmd_packet.params[0];
+    assert(gpu != NULL);
 
-    const unsigned int x_pos = gpu->cmd_packet.params[1] & 0x0000FFFF;
-    const unsigned int y_pos = gpu->cmd_packet.params[1] >> 16;
+    const uint32_t* params = gpu->cmd_packet.params;
 
-    const unsigned int width  = gpu->cmd_packet.params[2] & 0x0000FFFF;
-    const unsigned int height = gpu->cmd_packet.params[2] >> 16;
+    gpu->transfer.x = params[1] & 0x000003FF;
+    gpu->transfer.y = (params[1] >> 16) & 0x000001FF;
 
-    for (unsigned int x = x_pos; x != (x_pos + width); ++x)
-    {
-        for (unsigned int y = y_pos; y != (y_pos + height); ++y)
-        {
-            const unsigned int pixel_r = (color & 0x000000FF) / 8;
-            const unsigned int pixel_g = ((color >> 8) & 0xFF) / 8;
-            const unsigned int pixel_b = ((color >> 16) & 0xFF) / 8;
+    gpu->transfer.width  = (((params[2] & 0x0000FFFF) - 1) & 0x000003FF) + 1;
+    gpu->transfer.height = (((params[2] >> 16) - 1) & 0x000001FF) + 1;
 
-            gpu->vram[(x & 0x3FF) + (LIBPS_GPU_VRAM_WIDTH * (y & 0x1FF))] =
-            (pixel_g << 5) | (pixel_b << 10) | pixel_r;
-        }
-    }
+    gpu->transfer.column = 0;
+    gpu->transfer.row    = 0;
+}
 
-    memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-    params_pos = 0;
+// Returns the number of words left in the current transfer. The last word
+// of a rectangle with an odd number of pixels is only half used.
+static unsigned int transfer_words_left(const struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
 
-    gpu->state = LIBPS_GPU_AWAITING_COMMAND;
-    return;
+    const unsigned int pixels =
+    ((gpu->transfer.height - gpu->transfer.row) * gpu->transfer.width) -
+    gpu->transfer.column;
+
+    return (pixels + 1) / 2;
 }
 
-// This function is called whenever we must render a polygon. It assembles
-// vertices primarily based on the following flags:
-//
-// * DRAW_FLAG_MONOCHROME
-// * DRAW_FLAG_TEXTURED
-// * DRAW_FLAG_SHADED
-//
-// It will call the renderer's `draw_polygon()` function once all of the
-// vertices have been assembled, and resets the parameter FIFO.
-static void draw_polygon_helper(struct libps_gpu* gpu)
+// Moves `count` pixels between `pixels` and the current transfer's
+// rectangle, storing them into VRAM if `store` is `true` and loading them
+// otherwise. Rows are moved in runs which end at the right edge of VRAM.
+static void move_transfer_pixels(struct libps_gpu* gpu,
+                                 uint16_t* pixels,
+                                 unsigned int count,
+                                 const bool store)
 {
     assert(gpu != NULL);
+    assert(pixels != NULL);
 
-    if (gpu->cmd_packet.flags & DRAW_FLAG_MONOCHROME)
+    while ((count != 0) && (gpu->transfer.row < gpu->transfer.height))
     {
-        const struct libps_gpu_vertex v0 =
-        {
-            .x     = (int16_t)(gpu->cmd_packet.params[1] & 0x0000FFFF),
-            .y     = (int16_t)(gpu->cmd_packet.params[1] >> 16),
-            .color = gpu->cmd_packet.params[0]
-        };
+        const unsigned int x =
+        (gpu->transfer.x + gpu->transfer.column) % LIBPS_GPU_VRAM_WIDTH;
 
-        const struct libps_gpu_vertex v1 =
-        {
-            .x     = (int16_t)(gpu->cmd_packet.params[2] & 0x0000FFFF),
-            .y     = (int16_t)(gpu->cmd_packet.params[2] >> 16),
-            .color = gpu->cmd_packet.params[0]
-        };
+        const unsigned int y =
+        (gpu->transfer.y + gpu->transfer.row) % LIBPS_GPU_VRAM_HEIGHT;
 
-        const struct libps_gpu_vertex v2 =
-        {
-            .x     = (int16_t)(gpu->cmd_packet.params[3] & 0x0000FFFF),
-            .y     = (int16_t)(gpu->cmd_packet.params[3] >> 16),
-            .color = gpu->cmd_packet.params[0]
-        };
+        const unsigned int run =
+        LIBPS_MIN(LIBPS_MIN(gpu->transfer.width - gpu->transfer.column,
+                            LIBPS_GPU_VRAM_WIDTH - x),
+                  count);
 
-        gpu->draw_polygon(gpu, &v0, &v1, &v2);
+        uint16_t* vram = &gpu->vram[x + (LIBPS_GPU_VRAM_WIDTH * y)];
 
-        if (gpu->cmd_packet.flags & DRAW_FLAG_QUAD)
+        if (store)
         {
-            const struct libps_gpu_vertex v3 =
-            {
-                .x     = (int16_t)(gpu->cmd_packet.params[4] & 0x0000FFFF),
-                .y     = (int16_t)(gpu->cmd_packet.params[4] >> 16),
-                .color = gpu->cmd_packet.params[0]
-            };
-            gpu->draw_polygon(gpu, &v1, &v2, &v3);
+            libps_renderer_sw_store_pixels(gpu, vram, pixels, run);
         }
-
-        memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-        params_pos = 0;
-
-        gpu->state = LIBPS_GPU_AWAITING_COMMAND;
-        return;
-    }
-
-    if (gpu->cmd_packet.flags & DRAW_FLAG_TEXTURED)
-    {
-        const struct libps_gpu_vertex v0 =
-        {
-            .x        = (int16_t)(gpu->cmd_packet.params[1] & 0x0000FFFF),
-            .y        = (int16_t)(gpu->cmd_packet.params[1] >> 16),
-            .palette  = gpu->cmd_packet.params[2] >> 16,
-            .texcoord = gpu->cmd_packet.params[2] & 0x0000FFFF,
-            .color    = gpu->cmd_packet.params[0]
-        };
-
-        const struct libps_gpu_vertex v1 =
-        {
-            .x        = (int16_t)(gpu->cmd_packet.params[3] & 0x0000FFFF),
-            .y        = (int16_t)(gpu->cmd_packet.params[3] >> 16),
-            .palette  = gpu->cmd_packet.params[2] >> 16, // Hack
-            .texpage  = gpu->cmd_packet.params[4] >> 16,
-            .texcoord = gpu->cmd_packet.params[4] & 0x0000FFFF,
-            .color    = gpu->cmd_packet.params[0]
-        };
-
-        const struct libps_gpu_vertex v2 =
+        else
         {
-            .x        = (int16_t)(gpu->cmd_packet.params[5] & 0x0000FFFF),
-            .y        = (int16_t)(gpu->cmd_packet.params[5] >> 16),
-            .texpage  = gpu->cmd_packet.params[4] >> 16, // Hack
-            .texcoord = gpu->cmd_packet.params[6] & 0x0000FFFF,
-            .color    = gpu->cmd_packet.params[0]
-        };
-
-        gpu->draw_polygon(gpu, &v0, &v1, &v2);
+            memcpy(pixels, vram, run * sizeof(uint16_t));
+        }
 
-        if (gpu->cmd_packet.flags & DRAW_FLAG_QUAD)
+        if (gpu->stats_enabled)
         {
-            const struct libps_gpu_vertex v3 =
+            if (store)
             {
-                .x        = (int16_t)(gpu->cmd_packet.params[7] & 0x0000FFFF),
-                .y        = (int16_t)(gpu->cmd_packet.params[7] >> 16),
-                .texcoord = gpu->cmd_packet.params[8] & 0x0000FFFF,
-                .color    = gpu->cmd_packet.params[0]
-            };
-            gpu->draw_polygon(gpu, &v1, &v2, &v3);
+                gpu->stats.vram_upload_bytes += run * sizeof(uint16_t);
+            }
+            else
+            {
+                gpu->stats.vram_download_bytes += run * sizeof(uint16_t);
+            }
         }
 
-        memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-        params_pos = 0;
+        pixels += run;
+        count  -= run;
 
-        gpu->state = LIBPS_GPU_AWAITING_COMMAND;
-        return;
-    }
+        gpu->transfer.column += run;
 
-    if (gpu->cmd_packet.flags & DRAW_FLAG_SHADED)
-    {
-        const struct libps_gpu_vertex v0 =
+        if (gpu->transfer.column == gpu->transfer.width)
         {
-            .x     = (int16_t)(gpu->cmd_packet.params[1] & 0x0000FFFF),
-            .y     = (int16_t)(gpu->cmd_packet.params[1] >> 16),
-            .color = gpu->cmd_packet.params[0] & 0x00FFFFFF
-        };
+            gpu->transfer.column = 0;
+            gpu->transfer.row++;
+        }
+    }
+}
 
-        const struct libps_gpu_vertex v1 =
-        {
-            .x     = (int16_t)(gpu->cmd_packet.params[3] & 0x0000FFFF),
-            .y     = (int16_t)(gpu->cmd_packet.params[3] >> 16),
-            .color = gpu->cmd_packet.params[2] & 0x00FFFFFF
-        };
+// Stores up to `count` words of GP0(A0h) image data from `words` into VRAM
+// and returns the number of words used. Once the rectangle is complete, the
+// GPU returns to normal operation.
+static unsigned int store_transfer_words(struct libps_gpu* gpu,
+                                         const uint32_t* words,
+                                         unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(words != NULL);
 
-        const struct libps_gpu_vertex v2 =
-        {
-            .x     = (int16_t)(gpu->cmd_packet.params[5] & 0x0000FFFF),
-            .y     = (int16_t)(gpu->cmd_packet.params[5] >> 16),
-            .color = gpu->cmd_packet.params[4] & 0x00FFFFFF
-        };
+    count = LIBPS_MIN(count, transfer_words_left(gpu));
 
-        gpu->draw_polygon(gpu, &v0, &v1, &v2);
+    uint16_t pixels[LIBPS_GPU_VRAM_WIDTH];
+
+    for (unsigned int done = 0; done != count;)
+    {
+        const unsigned int batch =
+        LIBPS_MIN(count - done, LIBPS_GPU_VRAM_WIDTH / 2);
 
-        if (gpu->cmd_packet.flags & DRAW_FLAG_QUAD)
+        for (unsigned int i = 0; i < batch; ++i)
         {
-            const struct libps_gpu_vertex v3 =
-            {
-                .x     = (int16_t)(gpu->cmd_packet.params[7] & 0x0000FFFF),
-                .y     = (int16_t)(gpu->cmd_packet.params[7] >> 16),
-                .color = gpu->cmd_packet.params[6] & 0x00FFFFFF
-            };
-            gpu->draw_polygon(gpu, &v1, &v2, &v3);
+            pixels[(i * 2) + 0] = words[done + i] & 0x0000FFFF;
+            pixels[(i * 2) + 1] = words[done + i] >> 16;
         }
+
+        move_transfer_pixels(gpu, pixels, batch * 2, true);
+        done += batch;
     }
 
-    memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-    params_pos = 0;
+    if (gpu->transfer.row == gpu->transfer.height)
+    {
+        gpu->renderer->store_rect(gpu,
+                                  gpu->transfer.x,
+                                  gpu->transfer.y,
+                                  gpu->transfer.width,
+                                  gpu->transfer.height);
 
-    gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+        gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+    }
+    return count;
 }
 
-static void draw_rect_helper(struct libps_gpu* gpu)
+// Loads `count` words of GP0(C0h) image data from VRAM into `words`. Once
+// the rectangle is complete, the GPU returns to normal operation and the
+// remaining words repeat the last value of GPUREAD.
+static void load_transfer_words(struct libps_gpu* gpu,
+                                uint32_t* words,
+                                const unsigned int count)
 {
     assert(gpu != NULL);
+    assert(words != NULL);
 
-    const struct libps_gpu_vertex vertex =
-    {
-        .color    = gpu->cmd_packet.params[0],
-        .y        = gpu->cmd_packet.params[1] >> 16,
-        .x        = gpu->cmd_packet.params[1] & 0x0000FFFF,
-        .texcoord = gpu->cmd_packet.params[2] >> 16,
-        .palette  = gpu->cmd_packet.params[2] & 0x0000FFFF
-    };
+    const unsigned int used = LIBPS_MIN(count, transfer_words_left(gpu));
 
-    gpu->draw_rect(gpu, &vertex);
+    uint16_t pixels[LIBPS_GPU_VRAM_WIDTH];
 
-    memset(&gpu->cmd_packet, 0, sizeof(gpu->cmd_packet));
-    params_pos = 0;
+    for (unsigned int done = 0; done != used;)
+    {
+        const unsigned int batch =
+        LIBPS_MIN(used - done, LIBPS_GPU_VRAM_WIDTH / 2);
 
-    gpu->state = LIBPS_GPU_AWAITING_COMMAND;
-}
+        // The unused half of the last word reads as 0.
+        pixels[(batch * 2) - 1] = 0x0000;
+        move_transfer_pixels(gpu, pixels, batch * 2, false);
 
-// Initializes a GPU.
-void libps_gpu_setup(struct libps_gpu* gpu)
-{
-    assert(gpu != NULL);
+        for (unsigned int i = 0; i < batch; ++i)
+        {
+            words[done + i] = pixels[(i * 2) + 0] |
+                              (pixels[(i * 2) + 1] << 16);
+        }
+        done += batch;
+    }
+
+    if (used != 0)
+    {
+        gpu->gpuread = words[used - 1];
+    }
 
-    gpu->draw_polygon = &libps_renderer_sw_draw_polygon;
-    gpu->draw_rect    = &libps_renderer_sw_draw_rect;
+    for (unsigned int i = used; i < count; ++i)
+    {
+        words[i] = gpu->gpuread;
+    }
 
-    gpu->vram =
-    libps_safe_malloc(LIBPS_GPU_VRAM_WIDTH  *
-                      LIBPS_GPU_VRAM_HEIGHT *
-                      sizeof(uint16_t));
+    if (gpu->transfer.row == gpu->transfer.height)
+    {
+        gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+    }
 }
 
-// Destroys the PlayStation GPU.
-void libps_gpu_cleanup(struct libps_gpu* gpu)
+// Handles the GP0(A0h) command - Copy Rectangle (CPU to VRAM)
+static void copy_rect_from_cpu(struct libps_gpu* gpu)
 {
     assert(gpu != NULL);
-    libps_safe_free(gpu->vram);
+
+    if (gpu->state == LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS)
+    {
+        start_transfer(gpu);
+
+        libps_gpu_frameskip_access(gpu,
+                                   gpu->transfer.x,
+                                   gpu->transfer.y,
+                                   gpu->transfer.width,
+                                   gpu->transfer.height,
+                                   true);
+        sync_renderer(gpu);
+
+        libps_gpu_mark_vram(gpu,
+                            gpu->transfer.x,
+                            gpu->transfer.y,
+                            gpu->transfer.width,
+                            gpu->transfer.height);
+
+        // Lock the GP0 state to this function until the whole rectangle has
+        // been received.
+        gpu->state = LIBPS_GPU_RECEIVING_COMMAND_DATA;
+        return;
+    }
+
+    store_transfer_words(gpu, &gpu->received_data, 1);
 }
 
-// Resets the GPU to the initial state.
-void libps_gpu_reset(struct libps_gpu* gpu)
+// Handles the GP0(C0h) command - Copy Rectangle (VRAM to CPU). The data is
+// read through GPUREAD.
+static void copy_rect_to_cpu(struct libps_gpu* gpu)
 {
     assert(gpu != NULL);
 
-    gpu->gpustat = 0x14802000;
-    gpu->gpuread = 0x00000000;
-
-    gpu->drawing_offset_x = 0x00000000;
-    gpu->drawing_offset_y = 0x00000000;
-
-    gpu->received_data = 0x00000000;
+    start_transfer(gpu);
 
-    memset(&gpu->cmd_packet,   0, sizeof(gpu->cmd_packet));
-    memset(&gpu->drawing_area, 0, sizeof(gpu->drawing_area));
-    memset(gpu->vram,          0, (LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_VRAM_HEIGHT) * sizeof(uint16_t));
+    libps_gpu_frameskip_access(gpu,
+                               gpu->transfer.x,
+                               gpu->transfer.y,
+                               gpu->transfer.width,
+                               gpu->transfer.height,
+                               false);
+    sync_renderer(gpu);
 
-    params_pos = 0;
-    gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+    gpu->state = LIBPS_GPU_TRANSFERRING_DATA;
 }
 
-// Processes a GP0 packet.
-void libps_gpu_process_gp0(struct libps_gpu* gpu, const uint32_t packet)
+// Handles the GP0(80h) command - Copy Rectangle (VRAM to VRAM)
+static void copy_rect_in_vram(struct libps_gpu* gpu)
 {
     assert(gpu != NULL);
 
-    switch (gpu->state)
-    {
-        case LIBPS_GPU_AWAITING_COMMAND:
-            switch (packet >> 24)
-            {
-                // GP0(00h) - NOP(?)
-                case 0x00:
-                    break;
+    const uint32_t* params = gpu->cmd_packet.params;
 
-                // GP0(01h) - Clear Cache
-                case 0x01:
-                    break;
+    const unsigned int src_x = params[1] & 0x000003FF;
+    const unsigned int src_y = (params[1] >> 16) & 0x000001FF;
 
-                // GP0(02h) - Fill Rectangle in VRAM
-                case 0x02:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    const unsigned int dst_x = params[2] & 0x000003FF;
+    const unsigned int dst_y = (params[2] >> 16) & 0x000001FF;
 
-                    gpu->cmd_packet.remaining_words = 2;
+    const unsigned int width  = (((params[3] & 0x0000FFFF) - 1) & 0x3FF) + 1;
+    const unsigned int height = (((params[3] >> 16) - 1) & 0x1FF) + 1;
 
-                    gpu->cmd_packet.raw = packet;
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    libps_gpu_frameskip_access(gpu, src_x, src_y, width, height, false);
+    libps_gpu_frameskip_access(gpu, dst_x, dst_y, width, height, true);
 
-                    cmd_func = &fill_rect_in_vram;
-                    break;
+    sync_renderer(gpu);
 
-                // GP0(28h) - Monochrome four-point polygon, opaque
-                //
-                // XXX: monochrome means "uses constant color"
-                case 0x28:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    libps_gpu_mark_vram(gpu, dst_x, dst_y, width, height);
 
-                    gpu->cmd_packet.remaining_words = 4;
+    if (gpu->stats_enabled)
+    {
+        gpu->stats.vram_copy_bytes += width * height * sizeof(uint16_t);
+    }
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_MONOCHROME;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_QUAD;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
+    gpu->renderer->copy_rect(gpu, src_x, src_y, dst_x, dst_y, width, height);
+}
 
-                    gpu->cmd_packet.raw = packet;
+// Handles the GP0(02h) command - Fill Rectangle in VRAM. The position and
+// width are in units of 16 pixels, and the rectangle wraps around the edges of
+// VRAM. Neither the drawing area nor the mask bit setting apply.
+static void fill_rect_in_vram(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    const uint32_t* params = gpu->cmd_packet.params;
 
-                    cmd_func = &draw_polygon_helper;
-                    break;
+    const unsigned int x = params[1] & 0x000003F0;
+    const unsigned int y = (params[1] >> 16) & 0x000001FF;
 
-                // GP0(2Dh) - Textured four-point polygon, opaque, raw-texture
-                case 0x2D:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    const unsigned int width  = ((params[2] & 0x000003FF) + 0x0F) & ~0x0F;
+    const unsigned int height = (params[2] >> 16) & 0x000001FF;
 
-                    gpu->cmd_packet.remaining_words = 8;
+    if (gpu->stats_enabled)
+    {
+        gpu->stats.fills++;
+        gpu->stats.pixels_written += width * height;
+    }
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_TEXTURED;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_QUAD;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_RAW_TEXTURE;
+    if ((width == 0) || (height == 0))
+    {
+        return;
+    }
 
-                    gpu->cmd_packet.raw = packet;
+    libps_gpu_frameskip_access(gpu, x, y, width, height, true);
+    sync_renderer(gpu);
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    libps_gpu_mark_vram(gpu, x, y, width, height);
 
-                    cmd_func = &draw_polygon_helper;
-                    break;
+    // 24-bit RGB to 15-bit BGR
+    const uint16_t color = ((params[0] >> 3) & 0x001F) |
+                           ((params[0] >> 6) & 0x03E0) |
+                           ((params[0] >> 9) & 0x7C00);
 
-                // GP0(2Ch) - Textured four-point polygon, opaque, texture-blending
-                case 0x2C:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    gpu->renderer->fill_rect(gpu, x, y, width, height, color);
+}
 
-                    gpu->cmd_packet.remaining_words = 8;
+// Handles the GP0(20h..3Fh) commands - Polygons. The vertices are parsed
+// straight from the parameter words according to the command's flags:
+//
+// * DRAW_FLAG_SHADED: every vertex but the first is preceded by its color
+// * DRAW_FLAG_TEXTURED: every vertex is followed by its texture coordinate
+// * DRAW_FLAG_QUAD: there are four vertices instead of three
+//
+// Quads are made of the two triangles (v0, v1, v2) and (v1, v2, v3).
+static void draw_polygon_helper(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_TEXTURED;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_QUAD;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_TEXTURE_BLENDING;
+    const uint32_t* params   = gpu->cmd_packet.params;
+    const unsigned int flags = gpu->cmd_packet.flags;
+    const unsigned int count = (flags & DRAW_FLAG_QUAD) ? 4 : 3;
 
-                    gpu->cmd_packet.raw = packet;
+    struct libps_gpu_vertex vertices[4];
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    uint32_t color   = params[0];
+    uint16_t palette = 0;
+    uint16_t texpage = 0;
 
-                    cmd_func = &draw_polygon_helper;
-                    break;
+    unsigned int pos = 1;
 
-                // GP0(30h) - Shaded three-point polygon, opaque
-                case 0x30:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if ((flags & DRAW_FLAG_SHADED) && (i != 0))
+        {
+            color = params[pos++] & 0x00FFFFFF;
+        }
 
-                    gpu->cmd_packet.remaining_words = 5;
+        vertices[i].x     = (int16_t)(params[pos] & 0x0000FFFF);
+        vertices[i].y     = (int16_t)(params[pos] >> 16);
+        vertices[i].color = color;
+        pos++;
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_SHADED;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
+        vertices[i].texcoord = 0;
 
-                    gpu->cmd_packet.raw = packet;
+        if (flags & DRAW_FLAG_TEXTURED)
+        {
+            // The palette is sent along with the first texture coordinate
+            // and the texture page along with the second.
+            if (i == 0)
+            {
+                palette = params[pos] >> 16;
+            }
+            else if (i == 1)
+            {
+                texpage = params[pos] >> 16;
+            }
+            vertices[i].texcoord = params[pos++] & 0x0000FFFF;
+        }
+    }
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    // Both apply to the whole polygon.
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        vertices[i].palette = palette;
+        vertices[i].texpage = texpage;
+    }
 
-                    cmd_func = &draw_polygon_helper;
-                    break;
+    // The texture page of a textured polygon replaces the one set by
+    // GP0(E1h), along with its semi-transparency mode.
+    if (flags & DRAW_FLAG_TEXTURED)
+    {
+        gpu->draw_mode = (gpu->draw_mode & ~0x09FF) | (texpage & 0x09FF);
+        update_draw_status(gpu);
+    }
 
-                // GP0(38h) - Shaded four-point polygon, opaque
-                case 0x38:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    int32_t x1 = vertices[0].x;
+    int32_t y1 = vertices[0].y;
+    int32_t x2 = vertices[0].x;
+    int32_t y2 = vertices[0].y;
 
-                    gpu->cmd_packet.remaining_words = 7;
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        x1 = LIBPS_MIN(x1, vertices[i].x);
+        y1 = LIBPS_MIN(y1, vertices[i].y);
+        x2 = LIBPS_MAX(x2, vertices[i].x);
+        y2 = LIBPS_MAX(y2, vertices[i].y);
+    }
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_SHADED;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_QUAD;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
+    if (gpu->stats_enabled)
+    {
+        struct libps_renderer_sw_state state;
+        libps_renderer_sw_get_state(gpu, &state);
 
-                    gpu->cmd_packet.raw = packet;
+        if (flags & DRAW_FLAG_QUAD)
+        {
+            gpu->stats.quads++;
+
+            libps_renderer_sw_count_triangle(&state,
+                                             &vertices[1],
+                                             &vertices[2],
+                                             &vertices[3],
+                                             &gpu->stats.pixels_written,
+                                             &gpu->stats.pixels_clipped);
+        }
+        else
+        {
+            gpu->stats.triangles++;
+        }
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+        libps_renderer_sw_count_triangle(&state,
+                                         &vertices[0],
+                                         &vertices[1],
+                                         &vertices[2],
+                                         &gpu->stats.pixels_written,
+                                         &gpu->stats.pixels_clipped);
+    }
 
-                    cmd_func = &draw_polygon_helper;
-                    break;
+    if (gpu->skipping_frame)
+    {
+        libps_gpu_frameskip_polygon(gpu, vertices, count);
+        return;
+    }
 
-                // GP0(65h) - Textured Rectangle, variable size, opaque,
-                // raw-texture
-                case 0x65:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    if (flags & DRAW_FLAG_QUAD)
+    {
+        gpu->renderer->draw_quad(gpu, vertices);
+    }
+    else
+    {
+        gpu->renderer->draw_polygon(gpu,
+                                    &vertices[0],
+                                    &vertices[1],
+                                    &vertices[2]);
+    }
 
-                    gpu->cmd_packet.remaining_words = 3;
+    // Only marked once the polygon has been drawn, so a polygon drawing to
+    // its own texture page invalidates the texels it was drawn with.
+    mark_drawn(gpu,
+               x1 + gpu->drawing_offset_x,
+               y1 + gpu->drawing_offset_y,
+               x2 + gpu->drawing_offset_x,
+               y2 + gpu->drawing_offset_y);
+}
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_TEXTURED;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_RAW_TEXTURE;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_VARIABLE_SIZE;
+// Handles the GP0(60h..7Fh) commands - Rectangles
+static void draw_rect_helper(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
 
-                    gpu->cmd_packet.raw = packet;
+    const uint32_t* params = gpu->cmd_packet.params;
+    const unsigned int flags = gpu->cmd_packet.flags;
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    struct libps_gpu_vertex vertex =
+    {
+        .color = params[0],
+        .x     = (int16_t)(params[1] & 0x0000FFFF),
+        .y     = (int16_t)(params[1] >> 16)
+    };
 
-                    cmd_func = &draw_rect_helper;
-                    break;
+    unsigned int pos = 2;
 
-                // GP0(68h) - Monochrome Rectangle (1x1) (Dot) (opaque)
-                case 0x68:
-                    gpu->cmd_packet.params[params_pos++] =
-                    packet & 0x00FFFFFF;
+    // Rectangles use the texture page of the current drawing mode.
+    if (flags & DRAW_FLAG_TEXTURED)
+    {
+        vertex.texcoord = params[pos] & 0x0000FFFF;
+        vertex.palette  = params[pos] >> 16;
+        vertex.texpage  = gpu->draw_mode & 0x09FF;
 
-                    gpu->cmd_packet.remaining_words = 1;
+        pos++;
+    }
 
-                    gpu->cmd_packet.flags |= DRAW_FLAG_MONOCHROME;
-                    gpu->cmd_packet.flags |= DRAW_FLAG_OPAQUE;
+    unsigned int width;
+    unsigned int height;
 
-                    gpu->cmd_packet.raw = packet;
+    if (flags & DRAW_FLAG_VARIABLE_SIZE)
+    {
+        width  = params[pos] & 0x000003FF;
+        height = (params[pos] >> 16) & 0x000001FF;
+    }
+    else
+    {
+        // Opcode bits 3-4 select a 1x1, 8x8 or 16x16 rectangle.
+        static const unsigned int sizes[4] = { 0, 1, 8, 16 };
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+        width  = sizes[(gpu->cmd_packet.raw >> 27) & 0x03];
+        height = width;
+    }
 
-                    cmd_func = &draw_rect_helper;
-                    break;
+    if ((width == 0) || (height == 0))
+    {
+        return;
+    }
 
-                // GP0(A0h) - Copy Rectangle (CPU to VRAM)
-                case 0xA0:
-                    gpu->cmd_packet.remaining_words = 2;
+    if (gpu->stats_enabled)
+    {
+        struct libps_renderer_sw_state state;
+        libps_renderer_sw_get_state(gpu, &state);
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+        gpu->stats.rectangles++;
 
-                    cmd_func = &copy_rect_from_cpu;
-                    break;
+        libps_renderer_sw_count_sprite(&state,
+                                       &vertex,
+                                       width,
+                                       height,
+                                       &gpu->stats.pixels_written,
+                                       &gpu->stats.pixels_clipped);
+    }
+
+    if (gpu->skipping_frame)
+    {
+        libps_gpu_frameskip_rect(gpu, &vertex, width, height);
+        return;
+    }
 
-                // GP0(C0h) - Copy Rectangle (VRAM to CPU)
-                case 0xC0:
-                    gpu->cmd_packet.remaining_words = 2;
+    gpu->renderer->draw_rect(gpu, &vertex, width, height);
 
-                    gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
+    mark_drawn(gpu,
+               vertex.x + gpu->drawing_offset_x,
+               vertex.y + gpu->drawing_offset_y,
+               vertex.x + gpu->drawing_offset_x + (int32_t)width - 1,
+               vertex.y + gpu->drawing_offset_y + (int32_t)height - 1);
+}
 
-                    gpu->cmd_packet.raw = packet;
+// Draws the polyline vertices received so far. The last one stays to start
+// the next batch.
+static void flush_polyline(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
 
-                    cmd_func = &copy_rect_to_cpu;
-                    break;
+    const struct libps_gpu_vertex* vertices = gpu->polyline.vertices;
+    const unsigned int count = gpu->polyline.count;
 
-                // GP0(E1h) - Draw Mode setting(aka "Texpage")
-                case 0xE1:
-                    break;
+    if (count >= 2)
+    {
+        if (gpu->stats_enabled)
+        {
+            struct libps_renderer_sw_state state;
+            libps_renderer_sw_get_state(gpu, &state);
 
-                // GP0(E2h) - Texture Window setting
-                case 0xE2:
-                    break;
+            gpu->stats.lines += count - 1;
 
-                // GP0(E3h) - Set Drawing Area top left (X1, Y1)
-                case 0xE3:
-                    gpu->drawing_area.x1 = packet & 0x000003FF;
-                    gpu->drawing_area.y1 = (packet >> 10) & 0x000001FF;
+            for (unsigned int i = 1; i < count; ++i)
+            {
+                libps_renderer_sw_count_line(&state,
+                                             &vertices[i - 1],
+                                             &vertices[i],
+                                             &gpu->stats.pixels_written,
+                                             &gpu->stats.pixels_clipped);
+            }
+        }
 
-                    break;
+        if (gpu->skipping_frame)
+        {
+            libps_gpu_frameskip_line(gpu, vertices, count);
+        }
+        else
+        {
+            gpu->renderer->draw_line(gpu, vertices, count);
 
-                // GP0(E4h) - Set Drawing Area bottom right (X2,Y2)
-                case 0xE4:
-                    gpu->drawing_area.x2 = packet & 0x000003FF;
-                    gpu->drawing_area.y2 = (packet >> 10) & 0x000001FF;
+            int32_t x1 = vertices[0].x;
+            int32_t y1 = vertices[0].y;
+            int32_t x2 = vertices[0].x;
+            int32_t y2 = vertices[0].y;
 
-                    break;
+            for (unsigned int i = 1; i < count; ++i)
+            {
+                x1 = LIBPS_MIN(x1, vertices[i].x);
+                y1 = LIBPS_MIN(y1, vertices[i].y);
+                x2 = LIBPS_MAX(x2, vertices[i].x);
+                y2 = LIBPS_MAX(y2, vertices[i].y);
+            }
 
-                // GP0(E5h) - Set Drawing Offset (X,Y)
-                case 0xE5:
-                    gpu->drawing_offset_x = packet & 0x000003FF;
-                    gpu->drawing_offset_y = (packet >> 10) & 0x000001FF;
+            mark_drawn(gpu,
+                       x1 + gpu->drawing_offset_x,
+                       y1 + gpu->drawing_offset_y,
+                       x2 + gpu->drawing_offset_x,
+                       y2 + gpu->drawing_offset_y);
+        }
 
-                    break;
+        gpu->polyline.vertices[0] = vertices[count - 1];
+        gpu->polyline.count       = 1;
+    }
+}
 
-                // GP0(E6h) - Mask Bit Setting
-                case 0xE6:
-                    break;
+// Adds the vertex at the position encoded by `word` with color `color` to
+// the polyline, drawing the vertices received so far first if there is no
+// room left.
+static void add_polyline_vertex(struct libps_gpu* gpu,
+                                const uint32_t word,
+                                const uint32_t color)
+{
+    assert(gpu != NULL);
 
-                default:
-                    __debugbreak();
-                    break;
+    if (gpu->polyline.count == LIBPS_GPU_POLYLINE_VERTICES)
+    {
+        flush_polyline(gpu);
+    }
+
+    struct libps_gpu_vertex* vertex =
+    &gpu->polyline.vertices[gpu->polyline.count++];
+
+    vertex->x        = (int16_t)(word & 0x0000FFFF);
+    vertex->y        = (int16_t)(word >> 16);
+    vertex->color    = color & 0x00FFFFFF;
+    vertex->palette  = 0;
+    vertex->texcoord = 0;
+    vertex->texpage  = 0;
+}
+
+// Handles the GP0(40h..5Fh) commands - Lines. The first two vertices are
+// received as parameters; shaded lines send the color of the second vertex
+// before it.
+//
+// Polylines go on receiving vertices as data until a word of the form
+// 5xxx5xxxh is sent where a vertex (or, for shaded polylines, its color)
+// would start. Their vertices are drawn in batches rather than one line at a
+// time.
+static void draw_line_helper(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    const uint32_t* params = gpu->cmd_packet.params;
+    const bool shaded      = gpu->cmd_packet.flags & DRAW_FLAG_SHADED;
+
+    if (gpu->state == LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS)
+    {
+        gpu->polyline.count = 0;
+
+        add_polyline_vertex(gpu, params[1], params[0]);
+
+        if (shaded)
+        {
+            add_polyline_vertex(gpu, params[3], params[2]);
+        }
+        else
+        {
+            add_polyline_vertex(gpu, params[2], params[0]);
+        }
+
+        // Opcode bit 3 is set for polylines.
+        if (gpu->cmd_packet.raw & 0x08000000)
+        {
+            gpu->polyline.color     = params[0];
+            gpu->polyline.has_color = false;
+
+            gpu->state = LIBPS_GPU_RECEIVING_COMMAND_DATA;
+        }
+        else
+        {
+            flush_polyline(gpu);
+        }
+        return;
+    }
+
+    const uint32_t word = gpu->received_data;
+
+    if ((!shaded || !gpu->polyline.has_color) &&
+        ((word & 0xF000F000) == 0x50005000))
+    {
+        flush_polyline(gpu);
+
+        gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+        return;
+    }
+
+    if (shaded && !gpu->polyline.has_color)
+    {
+        gpu->polyline.color     = word;
+        gpu->polyline.has_color = true;
+
+        return;
+    }
+
+    add_polyline_vertex(gpu, word, gpu->polyline.color);
+    gpu->polyline.has_color = false;
+}
+
+// Handles the GP0(00h) - NOP and GP0(01h) - Clear Cache commands, along with
+// the settings which aren't emulated yet.
+static void nop(struct libps_gpu* gpu)
+{
+    (void)gpu;
+}
+
+// Handles the GP0(E3h) command - Set Drawing Area top left (X1, Y1)
+static void set_drawing_area_top_left(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    gpu->drawing_area.x1 = gpu->cmd_packet.raw & 0x000003FF;
+    gpu->drawing_area.y1 = (gpu->cmd_packet.raw >> 10) & 0x000001FF;
+}
+
+// Handles the GP0(E4h) command - Set Drawing Area bottom right (X2, Y2)
+static void set_drawing_area_bottom_right(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    gpu->drawing_area.x2 = gpu->cmd_packet.raw & 0x000003FF;
+    gpu->drawing_area.y2 = (gpu->cmd_packet.raw >> 10) & 0x000001FF;
+}
+
+// Handles the GP0(E5h) command - Set Drawing Offset (X, Y)
+//
+// Both offsets are signed 11-bit values.
+static void set_drawing_offset(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    const uint32_t packet = gpu->cmd_packet.raw;
+
+    gpu->drawing_offset_x = (int16_t)((packet & 0x000007FF) << 5) >> 5;
+
+    gpu->drawing_offset_y =
+    (int16_t)(((packet >> 11) & 0x000007FF) << 5) >> 5;
+}
+
+// Handles the GP0(E1h) command - Draw Mode setting
+static void set_draw_mode(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    gpu->draw_mode = gpu->cmd_packet.raw & 0x00003FFF;
+    update_draw_status(gpu);
+}
+
+// Handles the GP0(E2h) command - Texture Window setting
+static void set_texture_window(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+    gpu->texture_window = gpu->cmd_packet.raw & 0x000FFFFF;
+}
+
+// Handles the GP0(E6h) command - Mask Bit Setting
+//
+// 0 Set mask while drawing (0=TextureBit15/None, 1=Always)
+// 1 Check mask before draw (0=Draw Always, 1=Draw if Bit15=0)
+static void set_mask_settings(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    gpu->mask_settings = gpu->cmd_packet.raw & 0x00000003;
+    update_draw_status(gpu);
+}
+
+// Describes how a GP0 command is decoded.
+struct gp0_command
+{
+    // Number of parameter words following the command word
+    uint8_t params;
+
+    // `DRAW_FLAG_*` of the command, if it draws anything
+    uint8_t flags;
+
+    // Called once every parameter word has been received, or `NULL` if the
+    // command isn't implemented.
+    void (*handler)(struct libps_gpu* gpu);
+};
+
+// Polygon opcodes encode their layout: bit 4 is set for shaded polygons, bit
+// 3 for quads, bit 2 for textured polygons, bit 1 for semi-transparent ones
+// and bit 0 for raw textures.
+#define POLYGON_PARAMS(op)                                                   \
+((((op) & 0x08) ? 4 : 3) * (1 + !!((op) & 0x04) + !!((op) & 0x10)) -       \
+ !!((op) & 0x10))
+
+#define POLYGON_FLAGS(op)                                                    \
+((((op) & 0x10) ? DRAW_FLAG_SHADED : DRAW_FLAG_MONOCHROME) |                 \
+ (((op) & 0x08) ? DRAW_FLAG_QUAD : 0)                      |                 \
+ (((op) & 0x04) ? (DRAW_FLAG_TEXTURED |                                      \
+                   (((op) & 0x01) ? DRAW_FLAG_RAW_TEXTURE :                  \
+                                    DRAW_FLAG_TEXTURE_BLENDING)) : 0)       |\
+ (((op) & 0x02) ? 0 : DRAW_FLAG_OPAQUE))
+
+// Rectangle opcodes encode their layout: bits 3-4 are the size (0 meaning
+// variable, sent after the vertex), bit 2 is set for textured rectangles,
+// bit 1 for semi-transparent ones and bit 0 for raw textures.
+#define RECT_PARAMS(op)                                                      \
+(1 + !!((op) & 0x04) + (((op) & 0x18) == 0))
+
+#define RECT_FLAGS(op)                                                       \
+((((op) & 0x04) ? (DRAW_FLAG_TEXTURED |                                      \
+                   (((op) & 0x01) ? DRAW_FLAG_RAW_TEXTURE :                  \
+                                    DRAW_FLAG_TEXTURE_BLENDING)) :           \
+                  DRAW_FLAG_MONOCHROME)            |                         \
+ (((op) & 0x02) ? 0 : DRAW_FLAG_OPAQUE)            |                         \
+ ((((op) & 0x18) == 0) ? DRAW_FLAG_VARIABLE_SIZE : 0))
+
+// Line opcodes encode their layout: bit 4 is set for shaded lines, bit 3 for
+// polylines and bit 1 for semi-transparent ones.
+#define LINE_PARAMS(op) (((op) & 0x10) ? 3 : 2)
+
+#define LINE_FLAGS(op)                                                       \
+((((op) & 0x10) ? DRAW_FLAG_SHADED : DRAW_FLAG_MONOCHROME) |                 \
+ (((op) & 0x02) ? 0 : DRAW_FLAG_OPAQUE))
+
+#define POLYGON(op) \
+[op] = { POLYGON_PARAMS(op), POLYGON_FLAGS(op), &draw_polygon_helper },
+
+#define LINE(op) [op] = { LINE_PARAMS(op), LINE_FLAGS(op), &draw_line_helper },
+#define RECT(op) [op] = { RECT_PARAMS(op), RECT_FLAGS(op), &draw_rect_helper },
+
+#define REPEAT4(m, op) m(op) m((op) + 1) m((op) + 2) m((op) + 3)
+#define REPEAT16(m, op)                                                      \
+REPEAT4(m, op) REPEAT4(m, (op) + 4) REPEAT4(m, (op) + 8) REPEAT4(m, (op) + 12)
+#define REPEAT32(m, op) REPEAT16(m, op) REPEAT16(m, (op) + 16)
+
+static const struct gp0_command gp0_commands[256] =
+{
+    [0x00] = { 0, 0, &nop },
+    [0x01] = { 0, 0, &nop },
+    [0x02] = { 2, 0, &fill_rect_in_vram },
+
+    REPEAT32(POLYGON, 0x20)
+    REPEAT32(LINE, 0x40)
+    REPEAT32(RECT, 0x60)
+
+    [0x80] = { 3, 0, &copy_rect_in_vram },
+    [0xA0] = { 2, 0, &copy_rect_from_cpu },
+    [0xC0] = { 2, 0, &copy_rect_to_cpu },
+
+    [0xE1] = { 0, 0, &set_draw_mode },
+    [0xE2] = { 0, 0, &set_texture_window },
+    [0xE3] = { 0, 0, &set_drawing_area_top_left },
+    [0xE4] = { 0, 0, &set_drawing_area_bottom_right },
+    [0xE5] = { 0, 0, &set_drawing_offset },
+    [0xE6] = { 0, 0, &set_mask_settings }
+};
+
+#undef REPEAT32
+#undef REPEAT16
+#undef REPEAT4
+#undef RECT
+#undef LINE
+#undef POLYGON
+#undef RECT_FLAGS
+#undef RECT_PARAMS
+#undef LINE_FLAGS
+#undef LINE_PARAMS
+#undef POLYGON_FLAGS
+#undef POLYGON_PARAMS
+
+// Initializes a GPU. `scheduler` drives the video timing and cannot be
+// `NULL`.
+void libps_gpu_setup(struct libps_gpu* gpu, struct libps_scheduler* scheduler)
+{
+    assert(gpu != NULL);
+    assert(scheduler != NULL);
+
+    gpu->scheduler = scheduler;
+
+    libps_renderer_sw_setup();
+
+    gpu->renderer      = &libps_renderer_sw;
+    gpu->renderer_data = NULL;
+    gpu->thread        = NULL;
+    gpu->recorder      = NULL;
+
+    gpu->stats_enabled  = false;
+    gpu->skipping_frame = false;
+    gpu->frameskip      = NULL;
+
+    memset(&gpu->stats,       0, sizeof(gpu->stats));
+    memset(&gpu->frame_stats, 0, sizeof(gpu->frame_stats));
+
+    gpu->texture_cache = libps_renderer_sw_texture_cache_create();
+    gpu->vram_stamp    = 0;
+
+    gpu->draw_mode      = 0;
+    gpu->texture_window = 0;
+    gpu->mask_settings  = 0;
+    gpu->draw_status   = 0;
+
+    gpu->vram =
+    libps_safe_malloc(LIBPS_GPU_VRAM_WIDTH  *
+                      LIBPS_GPU_VRAM_HEIGHT *
+                      sizeof(uint16_t));
+
+    gpu->scale         = 1;
+    gpu->upscaled_vram = NULL;
+}
+
+// Destroys the PlayStation GPU.
+void libps_gpu_cleanup(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    libps_gpu_set_threaded(gpu, false);
+    libps_gpu_stop_recording(gpu);
+
+    if (gpu->renderer->cleanup)
+    {
+        gpu->renderer->cleanup(gpu);
+    }
+
+    if (gpu->frameskip)
+    {
+        libps_gpu_frameskip_destroy(gpu->frameskip);
+    }
+
+    libps_renderer_sw_texture_cache_destroy(gpu->texture_cache);
+
+    if (gpu->upscaled_vram)
+    {
+        libps_safe_free(gpu->upscaled_vram);
+    }
+    libps_safe_free(gpu->vram);
+}
+
+// Resets the GPU to the initial state.
+void libps_gpu_reset(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    libps_gpu_sync(gpu);
+    libps_gpu_frameskip_discard(gpu);
+
+    gpu->gpustat = 0x14802000;
+    gpu->gpuread = 0x00000000;
+
+    gpu->drawing_offset_x = 0x00000000;
+    gpu->drawing_offset_y = 0x00000000;
+
+    gpu->draw_mode      = 0x0000;
+    gpu->texture_window = 0x00000000;
+    gpu->mask_settings  = 0x00;
+
+    update_draw_status(gpu);
+
+    gpu->received_data = 0x00000000;
+
+    memset(&gpu->cmd_packet,   0, sizeof(gpu->cmd_packet));
+    memset(&gpu->transfer,     0, sizeof(gpu->transfer));
+    memset(&gpu->drawing_area, 0, sizeof(gpu->drawing_area));
+    memset(gpu->vram,          0, (LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_VRAM_HEIGHT) * sizeof(uint16_t));
+
+    libps_gpu_mark_vram(gpu,
+                        0,
+                        0,
+                        LIBPS_GPU_VRAM_WIDTH,
+                        LIBPS_GPU_VRAM_HEIGHT);
+
+    gpu->renderer->store_rect(gpu,
+                              0,
+                              0,
+                              LIBPS_GPU_VRAM_WIDTH,
+                              LIBPS_GPU_VRAM_HEIGHT);
+
+    params_pos = 0;
+    gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+
+    gpu->display_area_x = 0;
+    gpu->display_area_y = 0;
+
+    gpu->display_x1 = 0x260;
+    gpu->display_x2 = 0xC60;
+    gpu->display_y1 = 0x010;
+    gpu->display_y2 = 0x100;
+
+    update_video_timing(gpu);
+
+    // The beam starts out at the top left corner, in both blanking periods.
+    gpu->video.line_start = 0;
+    gpu->video.scanline   = 0;
+    gpu->video.in_hblank  = true;
+    gpu->video.in_vblank  = true;
+    gpu->video.odd_field  = false;
+
+    gpu->frame_count = 0;
+
+    update_field_bits(gpu);
+    schedule_video_event(gpu);
+
+    // None of this went through GP0 or GP1.
+    if (gpu->recorder)
+    {
+        libps_gpu_recorder_restart(gpu->recorder);
+    }
+}
+
+// Processes a GP0 packet. If the GPU thread is running, the packet is only
+// queued.
+void libps_gpu_process_gp0(struct libps_gpu* gpu, const uint32_t packet)
+{
+    assert(gpu != NULL);
+
+    if (gpu->recorder)
+    {
+        libps_gpu_recorder_gp0(gpu->recorder, &packet, 1);
+    }
+
+    if (gpu->thread)
+    {
+        libps_gpu_thread_push(gpu->thread, packet);
+    }
+    else
+    {
+        libps_gpu_execute_gp0(gpu, packet);
+    }
+}
+
+// Processes `count` GP0 packets from `packets`. Image data for GP0(A0h) is
+// stored a row at a time rather than a packet at a time.
+void libps_gpu_process_gp0_block(struct libps_gpu* gpu,
+                                 const uint32_t* packets,
+                                 const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(packets != NULL);
+
+    if (gpu->recorder)
+    {
+        // The capture can only start between two commands, which are found
+        // a word at a time.
+        if (!libps_gpu_recorder_capturing(gpu->recorder))
+        {
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                libps_gpu_process_gp0(gpu, packets[i]);
+            }
+            return;
+        }
+        libps_gpu_recorder_gp0(gpu->recorder, packets, count);
+    }
+
+    if (gpu->thread)
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            libps_gpu_thread_push(gpu->thread, packets[i]);
+        }
+        return;
+    }
+
+    for (unsigned int i = 0; i < count;)
+    {
+        if ((gpu->state == LIBPS_GPU_RECEIVING_COMMAND_DATA) &&
+            (cmd_func == &copy_rect_from_cpu))
+        {
+            const unsigned int used =
+            store_transfer_words(gpu, &packets[i], count - i);
+
+            if (gpu->stats_enabled)
+            {
+                gpu->stats.gp0_words += used;
+            }
+            i += used;
+        }
+        else
+        {
+            libps_gpu_execute_gp0(gpu, packets[i++]);
+        }
+    }
+}
+
+// Executes a GP0 packet on the calling thread. While the GPU thread is
+// running, only the GPU thread may call this.
+void libps_gpu_execute_gp0(struct libps_gpu* gpu, const uint32_t packet)
+{
+    assert(gpu != NULL);
+
+    if (gpu->stats_enabled)
+    {
+        gpu->stats.gp0_words++;
+    }
+
+    switch (gpu->state)
+    {
+        case LIBPS_GPU_AWAITING_COMMAND:
+        {
+            const struct gp0_command* command = &gp0_commands[packet >> 24];
+
+            if (!command->handler)
+            {
+                __debugbreak();
+                break;
+            }
+
+            gpu->cmd_packet.params[0]       = packet & 0x00FFFFFF;
+            gpu->cmd_packet.raw             = packet;
+            gpu->cmd_packet.flags           = command->flags;
+            gpu->cmd_packet.remaining_words = command->params;
+
+            params_pos = 1;
+            cmd_func   = command->handler;
+
+            if (command->params == 0)
+            {
+                cmd_func(gpu);
+            }
+            else
+            {
+                gpu->state = LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS;
             }
             break;
+        }
 
         case LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS:
             gpu->cmd_packet.params[params_pos++] = packet;
@@ -644,6 +1351,12 @@ void libps_gpu_process_gp0(struct libps_gpu* gpu, const uint32_t packet)
             if (gpu->cmd_packet.remaining_words == 0)
             {
                 cmd_func(gpu);
+
+                // Commands transferring data switch to another state.
+                if (gpu->state == LIBPS_GPU_RECEIVING_COMMAND_PARAMETERS)
+                {
+                    gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+                }
             }
             break;
 
@@ -653,9 +1366,12 @@ void libps_gpu_process_gp0(struct libps_gpu* gpu, const uint32_t packet)
 
             break;
 
-        // Used only by GP0(C0h)
+        // GP0(C0h) is sending data through GPUREAD. Writing a new command
+        // cancels the rest of the transfer.
         case LIBPS_GPU_TRANSFERRING_DATA:
-            cmd_func(gpu);
+            gpu->state = LIBPS_GPU_AWAITING_COMMAND;
+            libps_gpu_execute_gp0(gpu, packet);
+
             break;
     }
 }
@@ -665,11 +1381,40 @@ void libps_gpu_process_gp1(struct libps_gpu* gpu, const uint32_t packet)
 {
     assert(gpu != NULL);
 
+    if (gpu->recorder)
+    {
+        libps_gpu_recorder_gp1(gpu->recorder, packet);
+    }
+
     switch (packet >> 24)
     {
         // GP1(00h) - Reset GPU
         case 0x00:
+            // This also resets the drawing mode, texture window and mask
+            // settings, which belong to the GPU thread.
+            libps_gpu_sync(gpu);
+
+            gpu->draw_mode      = 0x0000;
+            gpu->texture_window = 0x00000000;
+            gpu->mask_settings  = 0x00;
+
+            update_draw_status(gpu);
+
             gpu->gpustat = 0x14802000;
+
+            gpu->display_area_x = 0;
+            gpu->display_area_y = 0;
+
+            gpu->display_x1 = 0x260;
+            gpu->display_x2 = 0xC60;
+            gpu->display_y1 = 0x010;
+            gpu->display_y2 = 0x100;
+
+            update_video_timing(gpu);
+            update_field_bits(gpu);
+
+            // The pending event was scheduled with the old video timing.
+            schedule_video_event(gpu);
             break;
 
         // GP1(01h) - Reset Command Buffer
@@ -682,30 +1427,71 @@ void libps_gpu_process_gp1(struct libps_gpu* gpu, const uint32_t packet)
 
         // GP1(03h) - Display Enable
         case 0x03:
+            if (packet & 1)
+            {
+                gpu->gpustat |= GPUSTAT_DISPLAY_DISABLED;
+            }
+            else
+            {
+                gpu->gpustat &= ~GPUSTAT_DISPLAY_DISABLED;
+            }
             break;
 
         // GP1(04h) - DMA Direction / Data Request
         case 0x04:
+            gpu->gpustat = (gpu->gpustat & ~0x60000000) |
+                           ((packet & 0x03) << 29);
             break;
 
         // GP1(05h) - Start of Display area (in VRAM)
         case 0x05:
+            gpu->display_area_x = packet & 0x000003FF;
+            gpu->display_area_y = (packet >> 10) & 0x000001FF;
+
             break;
 
         // GP1(06h) - Horizontal Display range (on Screen)
         case 0x06:
+            gpu->display_x1 = packet & 0x00000FFF;
+            gpu->display_x2 = (packet >> 12) & 0x00000FFF;
+
+            // The pending event was scheduled with the old range.
+            schedule_video_event(gpu);
             break;
 
         // GP1(07h) - Vertical Display range (on Screen)
         case 0x07:
+            gpu->display_y1 = packet & 0x000003FF;
+            gpu->display_y2 = (packet >> 10) & 0x000003FF;
+
+            schedule_video_event(gpu);
             break;
 
         // GP1(08h) - Display mode
         case 0x08:
+            // 0-1 Horizontal Resolution 1 -> GPUSTAT.17-18
+            // 2   Vertical Resolution     -> GPUSTAT.19
+            // 3   Video Mode              -> GPUSTAT.20
+            // 4   Display Area Color Depth-> GPUSTAT.21
+            // 5   Vertical Interlace      -> GPUSTAT.22
+            // 6   Horizontal Resolution 2 -> GPUSTAT.16
+            // 7   "Reverseflag"           -> GPUSTAT.14
+            gpu->gpustat = (gpu->gpustat & ~0x007F4000) |
+                           ((packet & 0x3F) << 17)      |
+                           ((packet & 0x40) << 10)      |
+                           ((packet & 0x80) << 7);
+
+            update_video_timing(gpu);
+            update_field_bits(gpu);
+
+            schedule_video_event(gpu);
             break;
 
         // GP1(10h) - Get GPU Info
         case 0x10:
+            // GPUREAD is also written by GP0(C0h).
+            libps_gpu_sync(gpu);
+
             switch (packet & 0x00FFFFFF)
             {
                 // Returns Nothing (old value in GPUREAD remains unchanged)
@@ -724,3 +1510,471 @@ void libps_gpu_process_gp1(struct libps_gpu* gpu, const uint32_t packet)
             break;
     }
 }
+
+// Waits for the GPU thread and the renderer to finish all work queued so
+// far. This must be called before accessing GPU state owned by the GPU
+// thread, such as `vram` and `gpuread`, from outside of the GPU.
+void libps_gpu_sync(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    if (gpu->thread)
+    {
+        libps_gpu_thread_wait(gpu->thread);
+    }
+    sync_renderer(gpu);
+}
+
+// Starts (`threaded` is `true`) or stops executing GP0 commands on a
+// dedicated thread.
+void libps_gpu_set_threaded(struct libps_gpu* gpu, const bool threaded)
+{
+    assert(gpu != NULL);
+
+    if (threaded && !gpu->thread)
+    {
+        gpu->thread = libps_gpu_thread_create(gpu);
+    }
+    else if (!threaded && gpu->thread)
+    {
+        libps_gpu_thread_destroy(gpu->thread);
+        gpu->thread = NULL;
+    }
+}
+
+// Starts recording a dump of the GP0 and GP1 words written to the GPU, see
+// gpu_recorder.h, into the file `path`, stopping any recording in progress.
+// Returns `false` if the file could not be created.
+bool libps_gpu_start_recording(struct libps_gpu* gpu, const char* path)
+{
+    assert(gpu != NULL);
+    assert(path != NULL);
+
+    libps_gpu_stop_recording(gpu);
+
+    FILE* file = fopen(path, "wb");
+
+    if (!file)
+    {
+        return false;
+    }
+
+    gpu->recorder = libps_gpu_recorder_create(gpu, file);
+    return true;
+}
+
+// Stops recording, if a recording is in progress. Returns `false` if writing
+// any part of the dump failed.
+bool libps_gpu_stop_recording(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    if (!gpu->recorder)
+    {
+        return true;
+    }
+
+    const bool ok = libps_gpu_recorder_destroy(gpu->recorder);
+    gpu->recorder = NULL;
+
+    return ok;
+}
+
+// Starts (`enabled` is `true`) or stops collecting statistics of the work
+// done every frame. Collecting them slows drawing down slightly.
+void libps_gpu_set_stats_enabled(struct libps_gpu* gpu, const bool enabled)
+{
+    assert(gpu != NULL);
+
+    // The statistics of the frame in progress belong to the GPU thread.
+    libps_gpu_sync(gpu);
+
+    gpu->stats_enabled = enabled;
+
+    memset(&gpu->stats,       0, sizeof(gpu->stats));
+    memset(&gpu->frame_stats, 0, sizeof(gpu->frame_stats));
+
+    gpu->texture_cache->hits   = 0;
+    gpu->texture_cache->misses = 0;
+}
+
+// Starts (`skipping` is `true`) or stops skipping the drawing of frames. While
+// a frame is skipped, polygons, rectangles and lines are only drawn if
+// something else reads VRAM they would have drawn to (see gpu_frameskip.h),
+// and the rest of them are thrown away at the start of vertical blanking.
+// This is meant to be called between frames, and skipped frames shouldn't be
+// presented. Anything recorded but not drawn yet is thrown away.
+void libps_gpu_set_frame_skipping(struct libps_gpu* gpu, const bool skipping)
+{
+    assert(gpu != NULL);
+
+    // The recording belongs to the GPU thread.
+    libps_gpu_sync(gpu);
+
+    if (skipping && !gpu->frameskip)
+    {
+        gpu->frameskip = libps_gpu_frameskip_create();
+    }
+
+    // Anything still recorded belongs to a skipped frame which is over.
+    libps_gpu_frameskip_discard(gpu);
+
+    gpu->skipping_frame = skipping;
+}
+
+// Fills `stats` with the statistics of the last complete frame. Everything
+// is 0 if statistics aren't being collected.
+void libps_gpu_get_stats(const struct libps_gpu* gpu,
+                         struct libps_gpu_stats* stats)
+{
+    assert(gpu != NULL);
+    assert(stats != NULL);
+
+    *stats = gpu->frame_stats;
+}
+
+// Makes `gpu` draw with `renderer`, which takes ownership of `data` (its
+// `renderer_data`). The renderer in use so far finishes drawing and is
+// cleaned up.
+void libps_gpu_set_renderer(struct libps_gpu* gpu,
+                            const struct libps_gpu_renderer* renderer,
+                            void* data)
+{
+    assert(gpu != NULL);
+    assert(renderer != NULL);
+
+    // The renderer may be in use by the GPU thread.
+    libps_gpu_sync(gpu);
+
+    if (gpu->renderer->cleanup)
+    {
+        gpu->renderer->cleanup(gpu);
+    }
+
+    gpu->renderer      = renderer;
+    gpu->renderer_data = data;
+}
+
+// Sets the internal resolution multiplier to `scale` (1 to
+// `LIBPS_GPU_MAX_SCALE`). Polygons, rectangles and lines are drawn at `scale`
+// times the resolution of VRAM for display, while VRAM itself is drawn
+// exactly as before.
+void libps_gpu_set_scale(struct libps_gpu* gpu, const unsigned int scale)
+{
+    assert(gpu != NULL);
+    assert((scale >= 1) && (scale <= LIBPS_GPU_MAX_SCALE));
+
+    // The upscaled VRAM may be in use by the GPU thread and the renderer.
+    libps_gpu_sync(gpu);
+
+    if (gpu->upscaled_vram)
+    {
+        libps_safe_free(gpu->upscaled_vram);
+        gpu->upscaled_vram = NULL;
+    }
+
+    gpu->scale = scale;
+
+    if (scale > 1)
+    {
+        gpu->upscaled_vram =
+        libps_safe_malloc(LIBPS_GPU_VRAM_WIDTH  *
+                          LIBPS_GPU_VRAM_HEIGHT *
+                          (scale * scale)       *
+                          sizeof(uint16_t));
+
+        // Nothing drawn so far can be drawn again at the higher resolution.
+        gpu->renderer->store_rect(gpu,
+                                  0,
+                                  0,
+                                  LIBPS_GPU_VRAM_WIDTH,
+                                  LIBPS_GPU_VRAM_HEIGHT);
+    }
+}
+
+// Returns the value of GPUREAD, waiting for the GPU thread if needed. During
+// a GP0(C0h) transfer, this returns the next two pixels of the rectangle.
+uint32_t libps_gpu_read_gpuread(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    if (gpu->recorder)
+    {
+        libps_gpu_recorder_gpuread(gpu->recorder, 1);
+    }
+
+    libps_gpu_sync(gpu);
+
+    if (gpu->state == LIBPS_GPU_TRANSFERRING_DATA)
+    {
+        uint32_t word;
+        load_transfer_words(gpu, &word, 1);
+    }
+    return gpu->gpuread;
+}
+
+// Reads `count` words of GPUREAD into `words` at once, waiting for the GPU
+// thread if needed.
+void libps_gpu_read_gpuread_block(struct libps_gpu* gpu,
+                                  uint32_t* words,
+                                  const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(words != NULL);
+
+    if (gpu->recorder)
+    {
+        libps_gpu_recorder_gpuread(gpu->recorder, count);
+    }
+
+    // Once the GPU thread (if any) is idle, nothing else is queued until the
+    // caller is done, so the transfer can be advanced on this thread.
+    libps_gpu_sync(gpu);
+
+    if (gpu->state == LIBPS_GPU_TRANSFERRING_DATA)
+    {
+        load_transfer_words(gpu, words, count);
+        return;
+    }
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        words[i] = gpu->gpuread;
+    }
+}
+
+// Records that the `width` by `height` pixel area of VRAM starting at (`x`,
+// `y`) has been written. Areas crossing the edges of VRAM wrap around.
+void libps_gpu_mark_vram(struct libps_gpu* gpu,
+                         const unsigned int x,
+                         const unsigned int y,
+                         const unsigned int width,
+                         const unsigned int height)
+{
+    assert(gpu != NULL);
+
+    if ((width == 0) || (height == 0))
+    {
+        return;
+    }
+
+    const unsigned int block_x = x / LIBPS_GPU_VRAM_BLOCK_WIDTH;
+    const unsigned int block_y = y / LIBPS_GPU_VRAM_BLOCK_HEIGHT;
+
+    const unsigned int blocks_x =
+    LIBPS_MIN(((x % LIBPS_GPU_VRAM_BLOCK_WIDTH) + width +
+               (LIBPS_GPU_VRAM_BLOCK_WIDTH - 1)) / LIBPS_GPU_VRAM_BLOCK_WIDTH,
+              LIBPS_GPU_VRAM_BLOCKS_X);
+
+    const unsigned int blocks_y =
+    LIBPS_MIN(((y % LIBPS_GPU_VRAM_BLOCK_HEIGHT) + height +
+               (LIBPS_GPU_VRAM_BLOCK_HEIGHT - 1)) / LIBPS_GPU_VRAM_BLOCK_HEIGHT,
+              LIBPS_GPU_VRAM_BLOCKS_Y);
+
+    gpu->vram_stamp++;
+
+    for (unsigned int j = 0; j < blocks_y; ++j)
+    {
+        const unsigned int row = (block_y + j) % LIBPS_GPU_VRAM_BLOCKS_Y;
+
+        for (unsigned int i = 0; i < blocks_x; ++i)
+        {
+            const unsigned int column = (block_x + i) % LIBPS_GPU_VRAM_BLOCKS_X;
+
+            gpu->vram_block_stamps[column + (row * LIBPS_GPU_VRAM_BLOCKS_X)] =
+            gpu->vram_stamp;
+        }
+    }
+}
+
+// Fills `dirty` with a bitmap of the VRAM blocks written since `*stamp` and
+// sets `*stamp` to the current write stamp.
+bool libps_gpu_get_dirty_vram(struct libps_gpu* gpu,
+                              uint64_t* stamp,
+                              uint32_t dirty[LIBPS_GPU_VRAM_DIRTY_WORDS])
+{
+    assert(gpu != NULL);
+    assert(stamp != NULL);
+    assert(dirty != NULL);
+
+    // The stamps are only current once every queued command has run.
+    libps_gpu_sync(gpu);
+
+    bool any_dirty = false;
+
+    memset(dirty, 0, LIBPS_GPU_VRAM_DIRTY_WORDS * sizeof(uint32_t));
+
+    for (unsigned int block = 0;
+         block < (LIBPS_GPU_VRAM_BLOCKS_X * LIBPS_GPU_VRAM_BLOCKS_Y);
+         ++block)
+    {
+        if (gpu->vram_block_stamps[block] > *stamp)
+        {
+            dirty[block / 32] |= 1U << (block % 32);
+            any_dirty = true;
+        }
+    }
+
+    *stamp = gpu->vram_stamp;
+    return any_dirty;
+}
+
+// Fills `area` with the part of VRAM currently shown on screen.
+void libps_gpu_get_display_area(const struct libps_gpu* gpu,
+                                struct libps_gpu_display_area* area)
+{
+    assert(gpu != NULL);
+    assert(area != NULL);
+
+    area->x = gpu->display_area_x;
+    area->y = gpu->display_area_y;
+
+    // The horizontal display range is in GPU clocks. The hardware rounds the
+    // number of dots to a multiple of 4.
+    const unsigned int clocks = (gpu->display_x2 > gpu->display_x1) ?
+                                (gpu->display_x2 - gpu->display_x1) : 0;
+
+    area->width = LIBPS_MIN(((clocks / gpu->video.dotclock_divider) + 2) & ~3,
+                            LIBPS_GPU_VRAM_WIDTH);
+
+    // The vertical display range is in scanlines, each of which shows two
+    // lines of VRAM in 480-line interlaced mode.
+    unsigned int height = (gpu->display_y2 > gpu->display_y1) ?
+                          (gpu->display_y2 - gpu->display_y1) : 0;
+
+    if ((gpu->gpustat & GPUSTAT_VERTICAL_RESOLUTION) &&
+        (gpu->gpustat & GPUSTAT_VERTICAL_INTERLACE))
+    {
+        height *= 2;
+    }
+
+    area->height      = LIBPS_MIN(height, LIBPS_GPU_VRAM_HEIGHT);
+    area->color_24bit = gpu->gpustat & GPUSTAT_COLOR_DEPTH_24BIT;
+    area->disabled    = gpu->gpustat & GPUSTAT_DISPLAY_DISABLED;
+
+    // 24-bit images are only ever uploaded, never drawn, so they have no
+    // more detail to show.
+    area->scale = area->color_24bit ? 1 : gpu->scale;
+}
+
+// Converts the display area `area` to `format` and stores it in `pixels`,
+// which must have room for `area->height * area->scale` rows of `stride`
+// pixels each. A disabled display is stored as black.
+void libps_gpu_scanout(struct libps_gpu* gpu,
+                       const struct libps_gpu_display_area* area,
+                       uint32_t* pixels,
+                       const unsigned int stride,
+                       const enum libps_gpu_scanout_format format)
+{
+    assert(gpu != NULL);
+    assert(area != NULL);
+    assert(pixels != NULL);
+
+    assert((area->scale == 1) || (area->scale == gpu->scale));
+
+    libps_gpu_sync(gpu);
+
+    gpu->renderer->scanout(gpu, area, pixels, stride, format);
+}
+
+// Returns the value of GPUSTAT as seen by the CPU.
+uint32_t libps_gpu_read_gpustat(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    // Commands are either executed synchronously or queued for the GPU
+    // thread, so the GPU is always ready to receive them.
+    uint32_t gpustat = gpu->gpustat       |
+                       GPUSTAT_READY_CMD  |
+                       GPUSTAT_READY_VRAM_TO_CPU |
+                       GPUSTAT_READY_DMA;
+
+    // The drawing mode bits are only as up to date as the GP0 commands the
+    // GPU thread has executed.
+    gpustat |= gpu->thread ? libps_gpu_thread_get_status(gpu->thread) :
+                             gpu->draw_status;
+
+    // Bit 25 depends on the DMA direction (bits 29-30); it is always 0 when
+    // the direction is "Off", otherwise it mirrors a ready bit.
+    if (gpustat & 0x60000000)
+    {
+        gpustat |= GPUSTAT_DMA_REQUEST;
+    }
+    else
+    {
+        gpustat &= ~GPUSTAT_DMA_REQUEST;
+    }
+    return gpustat;
+}
+
+// Called by the scheduler when the video timing event fires. Returns the
+// `LIBPS_GPU_*BLANK*` signals which occurred.
+unsigned int libps_gpu_process_event(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    unsigned int signals;
+
+    if (gpu->video.in_hblank)
+    {
+        gpu->video.in_hblank = false;
+        signals = LIBPS_GPU_HBLANK_END;
+    }
+    else
+    {
+        // The visible part of the scanline is over; the rest of it belongs
+        // to the next one.
+        gpu->video.in_hblank = true;
+        signals = LIBPS_GPU_HBLANK_START;
+
+        gpu->video.line_start += gpu->video.scanline_clocks;
+
+        if (++gpu->video.scanline >= gpu->video.scanlines)
+        {
+            gpu->video.scanline  = 0;
+            gpu->video.odd_field = !gpu->video.odd_field;
+        }
+
+        const bool vblank = in_vblank(gpu, gpu->video.scanline);
+
+        if (vblank != gpu->video.in_vblank)
+        {
+            gpu->video.in_vblank = vblank;
+
+            if (vblank)
+            {
+                // The frontend presents the frame now, so it has to be
+                // complete.
+                libps_gpu_sync(gpu);
+
+                // Whatever the skipped frame didn't need to draw by now only
+                // changed what would have been displayed.
+                if (gpu->skipping_frame)
+                {
+                    libps_gpu_frameskip_discard(gpu);
+                }
+
+                signals |= LIBPS_GPU_VBLANK_START;
+                gpu->frame_count++;
+
+                if (gpu->stats_enabled)
+                {
+                    finish_frame_stats(gpu);
+                }
+
+                if (gpu->recorder)
+                {
+                    libps_gpu_recorder_frame(gpu->recorder);
+                }
+            }
+            else
+            {
+                signals |= LIBPS_GPU_VBLANK_END;
+            }
+        }
+        update_field_bits(gpu);
+    }
+
+    schedule_video_event(gpu);
+    return signals;
+}
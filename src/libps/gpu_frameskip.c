@@ -0,0 +1,498 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "gpu.h"
+#include "gpu_frameskip.h"
+#include "utility/math.h"
+#include "utility/memory.h"
+
+// Number of primitives which can be recorded, and of vertices for all of
+// them. When either runs out, everything recorded so far is drawn.
+#define MAX_PRIMITIVES 8192
+#define MAX_VERTICES (MAX_PRIMITIVES * 4)
+
+enum primitive_type
+{
+    PRIMITIVE_POLYGON,
+    PRIMITIVE_RECT,
+    PRIMITIVE_LINE
+};
+
+// The parts of the GPU's state which renderers draw primitives with
+struct drawing_state
+{
+    uint16_t area_x1;
+    uint16_t area_y1;
+    uint16_t area_x2;
+    uint16_t area_y2;
+
+    int16_t offset_x;
+    int16_t offset_y;
+
+    unsigned int flags;
+    uint16_t draw_mode;
+    uint32_t texture_window;
+    uint8_t mask_settings;
+};
+
+struct primitive
+{
+    enum primitive_type type;
+    struct drawing_state state;
+
+    // The vertices of the primitive are `count` vertices of `vertices`,
+    // starting at `first`.
+    unsigned int first;
+    unsigned int count;
+
+    // Size of rectangles
+    unsigned int width;
+    unsigned int height;
+};
+
+struct libps_gpu_frameskip
+{
+    // Primitives recorded so far, in the order they were submitted
+    struct primitive primitives[MAX_PRIMITIVES];
+    unsigned int primitive_count;
+
+    struct libps_gpu_vertex vertices[MAX_VERTICES];
+    unsigned int vertex_count;
+
+    // Bitmaps of the VRAM blocks the recorded primitives draw to and take
+    // texels from. Block N (counting along the rows) is bit `N % 32` of word
+    // `N / 32`.
+    uint32_t drawn[LIBPS_GPU_VRAM_DIRTY_WORDS];
+    uint32_t sampled[LIBPS_GPU_VRAM_DIRTY_WORDS];
+};
+
+// Returns `true` if any block of the `width` x `height` area of VRAM at (`x`,
+// `y`) is set in `bitmap`, and sets all of them if `mark` is `true`. Areas
+// crossing the edges of VRAM wrap around.
+static bool test_blocks(uint32_t* bitmap,
+                        const unsigned int x,
+                        const unsigned int y,
+                        const unsigned int width,
+                        const unsigned int height,
+                        const bool mark)
+{
+    assert(bitmap != NULL);
+
+    const unsigned int block_x = x / LIBPS_GPU_VRAM_BLOCK_WIDTH;
+    const unsigned int block_y = y / LIBPS_GPU_VRAM_BLOCK_HEIGHT;
+
+    const unsigned int blocks_x =
+    LIBPS_MIN(((x % LIBPS_GPU_VRAM_BLOCK_WIDTH) + width +
+               (LIBPS_GPU_VRAM_BLOCK_WIDTH - 1)) / LIBPS_GPU_VRAM_BLOCK_WIDTH,
+              LIBPS_GPU_VRAM_BLOCKS_X);
+
+    const unsigned int blocks_y =
+    LIBPS_MIN(((y % LIBPS_GPU_VRAM_BLOCK_HEIGHT) + height +
+               (LIBPS_GPU_VRAM_BLOCK_HEIGHT - 1)) / LIBPS_GPU_VRAM_BLOCK_HEIGHT,
+              LIBPS_GPU_VRAM_BLOCKS_Y);
+
+    bool set = false;
+
+    for (unsigned int j = 0; j < blocks_y; ++j)
+    {
+        const unsigned int row = (block_y + j) % LIBPS_GPU_VRAM_BLOCKS_Y;
+
+        for (unsigned int i = 0; i < blocks_x; ++i)
+        {
+            const unsigned int column = (block_x + i) % LIBPS_GPU_VRAM_BLOCKS_X;
+            const unsigned int block  =
+            column + (row * LIBPS_GPU_VRAM_BLOCKS_X);
+
+            const uint32_t bit = 1U << (block % 32);
+
+            set |= (bitmap[block / 32] & bit) != 0;
+
+            if (mark)
+            {
+                bitmap[block / 32] |= bit;
+            }
+        }
+    }
+    return set;
+}
+
+// Returns `true` if any block of the VRAM which texture page `texpage` with
+// palette `clut` is decoded from is set in `bitmap`, and sets all of them if
+// `mark` is `true`.
+static bool test_texture_blocks(uint32_t* bitmap,
+                                const uint16_t texpage,
+                                const uint16_t clut,
+                                const bool mark)
+{
+    assert(bitmap != NULL);
+
+    // Texture pages are 64, 128 or 256 pixels wide depending on the color
+    // depth (GP0(E1h) bits 7-8, where 3 is the same as 2), and always 256
+    // lines tall.
+    const unsigned int depth = LIBPS_MIN((texpage >> 7) & 0x03, 2);
+
+    bool set = test_blocks(bitmap,
+                           (texpage & 0x0F) * 64,
+                           (texpage & (1 << 4)) ? 256 : 0,
+                           64 << depth,
+                           256,
+                           mark);
+
+    // 4-bit and 8-bit textures also use a palette of 16 or 256 pixels.
+    if (depth != 2)
+    {
+        set |= test_blocks(bitmap,
+                           (clut & 0x3F) * 16,
+                           (clut >> 6) & 0x1FF,
+                           (depth == 0) ? 16 : 256,
+                           1,
+                           mark);
+    }
+    return set;
+}
+
+static void save_state(const struct libps_gpu* gpu,
+                       struct drawing_state* state)
+{
+    state->area_x1        = gpu->drawing_area.x1;
+    state->area_y1        = gpu->drawing_area.y1;
+    state->area_x2        = gpu->drawing_area.x2;
+    state->area_y2        = gpu->drawing_area.y2;
+    state->offset_x       = gpu->drawing_offset_x;
+    state->offset_y       = gpu->drawing_offset_y;
+    state->flags          = gpu->cmd_packet.flags;
+    state->draw_mode      = gpu->draw_mode;
+    state->texture_window = gpu->texture_window;
+    state->mask_settings  = gpu->mask_settings;
+}
+
+static void restore_state(struct libps_gpu* gpu,
+                          const struct drawing_state* state)
+{
+    gpu->drawing_area.x1   = state->area_x1;
+    gpu->drawing_area.y1   = state->area_y1;
+    gpu->drawing_area.x2   = state->area_x2;
+    gpu->drawing_area.y2   = state->area_y2;
+    gpu->drawing_offset_x  = state->offset_x;
+    gpu->drawing_offset_y  = state->offset_y;
+    gpu->cmd_packet.flags  = state->flags;
+    gpu->draw_mode         = state->draw_mode;
+    gpu->texture_window    = state->texture_window;
+    gpu->mask_settings     = state->mask_settings;
+}
+
+// Records a primitive of `count` vertices `vertices` drawn by `gpu` with its
+// current drawing state, which draws to the inclusive screen area (`x1`,
+// `y1`) - (`x2`, `y2`) at most.
+static void record(struct libps_gpu* gpu,
+                   const enum primitive_type type,
+                   const struct libps_gpu_vertex* vertices,
+                   const unsigned int count,
+                   const unsigned int width,
+                   const unsigned int height,
+                   int32_t x1,
+                   int32_t y1,
+                   int32_t x2,
+                   int32_t y2)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    struct libps_gpu_frameskip* frameskip = gpu->frameskip;
+
+    // Only the part inside the drawing area can change.
+    x1 = LIBPS_MAX(x1 + gpu->drawing_offset_x, (int32_t)gpu->drawing_area.x1);
+    y1 = LIBPS_MAX(y1 + gpu->drawing_offset_y, (int32_t)gpu->drawing_area.y1);
+    x2 = LIBPS_MIN(x2 + gpu->drawing_offset_x, (int32_t)gpu->drawing_area.x2);
+    y2 = LIBPS_MIN(y2 + gpu->drawing_offset_y, (int32_t)gpu->drawing_area.y2);
+
+    if ((x1 > x2) || (y1 > y2))
+    {
+        return;
+    }
+
+    const bool textured = gpu->cmd_packet.flags & DRAW_FLAG_TEXTURED;
+
+    // Texels drawn by recorded primitives have to be there first.
+    if (textured && test_texture_blocks(frameskip->drawn,
+                                        vertices[0].texpage,
+                                        vertices[0].palette,
+                                        false))
+    {
+        libps_gpu_frameskip_draw(gpu);
+    }
+
+    if ((frameskip->primitive_count == MAX_PRIMITIVES) ||
+        ((frameskip->vertex_count + count) > MAX_VERTICES))
+    {
+        libps_gpu_frameskip_draw(gpu);
+    }
+
+    struct primitive* primitive =
+    &frameskip->primitives[frameskip->primitive_count++];
+
+    primitive->type   = type;
+    primitive->first  = frameskip->vertex_count;
+    primitive->count  = count;
+    primitive->width  = width;
+    primitive->height = height;
+
+    save_state(gpu, &primitive->state);
+
+    memcpy(&frameskip->vertices[frameskip->vertex_count],
+           vertices,
+           count * sizeof(struct libps_gpu_vertex));
+
+    frameskip->vertex_count += count;
+
+    test_blocks(frameskip->drawn,
+                (unsigned int)x1,
+                (unsigned int)y1,
+                (unsigned int)(x2 - x1) + 1,
+                (unsigned int)(y2 - y1) + 1,
+                true);
+
+    if (textured)
+    {
+        test_texture_blocks(frameskip->sampled,
+                            vertices[0].texpage,
+                            vertices[0].palette,
+                            true);
+    }
+}
+
+// Records the bounding box of the `count` vertices `vertices` in `*x1`,
+// `*y1`, `*x2` and `*y2`.
+static void bounding_box(const struct libps_gpu_vertex* vertices,
+                         const unsigned int count,
+                         int32_t* x1,
+                         int32_t* y1,
+                         int32_t* x2,
+                         int32_t* y2)
+{
+    *x1 = vertices[0].x;
+    *y1 = vertices[0].y;
+    *x2 = vertices[0].x;
+    *y2 = vertices[0].y;
+
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        *x1 = LIBPS_MIN(*x1, vertices[i].x);
+        *y1 = LIBPS_MIN(*y1, vertices[i].y);
+        *x2 = LIBPS_MAX(*x2, vertices[i].x);
+        *y2 = LIBPS_MAX(*y2, vertices[i].y);
+    }
+}
+
+// Creates an empty recording.
+struct libps_gpu_frameskip* libps_gpu_frameskip_create(void)
+{
+    struct libps_gpu_frameskip* frameskip =
+    libps_safe_malloc(sizeof(struct libps_gpu_frameskip));
+
+    frameskip->primitive_count = 0;
+    frameskip->vertex_count    = 0;
+
+    memset(frameskip->drawn,   0, sizeof(frameskip->drawn));
+    memset(frameskip->sampled, 0, sizeof(frameskip->sampled));
+
+    return frameskip;
+}
+
+// Destroys `frameskip` without drawing anything.
+void libps_gpu_frameskip_destroy(struct libps_gpu_frameskip* frameskip)
+{
+    assert(frameskip != NULL);
+    libps_safe_free(frameskip);
+}
+
+// Records the polygon of `count` (3 or 4) `vertices` about to be drawn by
+// `gpu` with its current drawing state.
+void libps_gpu_frameskip_polygon(struct libps_gpu* gpu,
+                                 const struct libps_gpu_vertex* vertices,
+                                 const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+    assert((count == 3) || (count == 4));
+
+    int32_t x1, y1, x2, y2;
+    bounding_box(vertices, count, &x1, &y1, &x2, &y2);
+
+    record(gpu, PRIMITIVE_POLYGON, vertices, count, 0, 0, x1, y1, x2, y2);
+}
+
+// Records the `width` x `height` rectangle whose top left corner is `vertex`.
+void libps_gpu_frameskip_rect(struct libps_gpu* gpu,
+                              const struct libps_gpu_vertex* vertex,
+                              const unsigned int width,
+                              const unsigned int height)
+{
+    assert(gpu != NULL);
+    assert(vertex != NULL);
+
+    record(gpu,
+           PRIMITIVE_RECT,
+           vertex,
+           1,
+           width,
+           height,
+           vertex->x,
+           vertex->y,
+           vertex->x + (int32_t)width - 1,
+           vertex->y + (int32_t)height - 1);
+}
+
+// Records the `count` - 1 lines joining the `count` vertices `vertices`.
+void libps_gpu_frameskip_line(struct libps_gpu* gpu,
+                              const struct libps_gpu_vertex* vertices,
+                              const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+    assert((count >= 2) && (count <= LIBPS_GPU_POLYLINE_VERTICES));
+
+    int32_t x1, y1, x2, y2;
+    bounding_box(vertices, count, &x1, &y1, &x2, &y2);
+
+    record(gpu, PRIMITIVE_LINE, vertices, count, 0, 0, x1, y1, x2, y2);
+}
+
+// Called before `gpu` accesses the `width` x `height` area of VRAM at (`x`,
+// `y`) directly, writing to it if `write` is `true` and reading from it
+// otherwise. Draws everything recorded if any of it depends on the area.
+void libps_gpu_frameskip_access(struct libps_gpu* gpu,
+                                const unsigned int x,
+                                const unsigned int y,
+                                const unsigned int width,
+                                const unsigned int height,
+                                const bool write)
+{
+    assert(gpu != NULL);
+
+    struct libps_gpu_frameskip* frameskip = gpu->frameskip;
+
+    if (!frameskip || (frameskip->primitive_count == 0))
+    {
+        return;
+    }
+
+    // Writes have to come after what recorded primitives draw, and after
+    // they have taken their texels.
+    if (test_blocks(frameskip->drawn, x, y, width, height, false) ||
+        (write &&
+         test_blocks(frameskip->sampled, x, y, width, height, false)))
+    {
+        libps_gpu_frameskip_draw(gpu);
+    }
+}
+
+// Draws everything recorded for `gpu` with its renderer, in order and each
+// primitive with the drawing state it was recorded with, and empties the
+// recording.
+void libps_gpu_frameskip_draw(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    struct libps_gpu_frameskip* frameskip = gpu->frameskip;
+
+    if (!frameskip || (frameskip->primitive_count == 0))
+    {
+        return;
+    }
+
+    struct drawing_state current;
+    save_state(gpu, &current);
+
+    for (unsigned int i = 0; i < frameskip->primitive_count; ++i)
+    {
+        const struct primitive* primitive = &frameskip->primitives[i];
+        struct libps_gpu_vertex* vertices =
+        &frameskip->vertices[primitive->first];
+
+        restore_state(gpu, &primitive->state);
+
+        switch (primitive->type)
+        {
+            case PRIMITIVE_POLYGON:
+                if (primitive->count == 4)
+                {
+                    gpu->renderer->draw_quad(gpu, vertices);
+                }
+                else
+                {
+                    gpu->renderer->draw_polygon(gpu,
+                                                &vertices[0],
+                                                &vertices[1],
+                                                &vertices[2]);
+                }
+                break;
+
+            case PRIMITIVE_RECT:
+                gpu->renderer->draw_rect(gpu,
+                                         vertices,
+                                         primitive->width,
+                                         primitive->height);
+                break;
+
+            case PRIMITIVE_LINE:
+                gpu->renderer->draw_line(gpu, vertices, primitive->count);
+                break;
+        }
+    }
+
+    restore_state(gpu, &current);
+
+    // Recorded primitives don't mark VRAM as written, so that discarding
+    // them doesn't invalidate anything. Only now have they been drawn.
+    for (unsigned int block = 0;
+         block < (LIBPS_GPU_VRAM_BLOCKS_X * LIBPS_GPU_VRAM_BLOCKS_Y);
+         ++block)
+    {
+        if (frameskip->drawn[block / 32] & (1U << (block % 32)))
+        {
+            libps_gpu_mark_vram(gpu,
+                                (block % LIBPS_GPU_VRAM_BLOCKS_X) *
+                                LIBPS_GPU_VRAM_BLOCK_WIDTH,
+                                (block / LIBPS_GPU_VRAM_BLOCKS_X) *
+                                LIBPS_GPU_VRAM_BLOCK_HEIGHT,
+                                LIBPS_GPU_VRAM_BLOCK_WIDTH,
+                                LIBPS_GPU_VRAM_BLOCK_HEIGHT);
+        }
+    }
+    libps_gpu_frameskip_discard(gpu);
+}
+
+// Throws away everything recorded for `gpu`.
+void libps_gpu_frameskip_discard(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    struct libps_gpu_frameskip* frameskip = gpu->frameskip;
+
+    if (!frameskip)
+    {
+        return;
+    }
+
+    frameskip->primitive_count = 0;
+    frameskip->vertex_count    = 0;
+
+    memset(frameskip->drawn,   0, sizeof(frameskip->drawn));
+    memset(frameskip->sampled, 0, sizeof(frameskip->sampled));
+}
@@ -0,0 +1,336 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <string.h>
+#include "gpu.h"
+#include "gpu_recorder.h"
+#include "utility/math.h"
+#include "utility/memory.h"
+
+// Number of GP0 or GP1 words buffered before a record is written. Runs of
+// words longer than this are split into several records.
+#define RUN_WORDS 4096
+
+struct libps_gpu_recorder
+{
+    struct libps_gpu* gpu;
+    FILE* file;
+
+    // Has the capture started?
+    bool capturing;
+
+    // Has writing any part of the dump failed?
+    bool failed;
+
+    // Words of the record being built, and its type
+    enum libps_gpu_dump_record run_type;
+    unsigned int run_count;
+    uint32_t run[RUN_WORDS];
+};
+
+// Writes `count` words `words` to the dump.
+static void write_words(struct libps_gpu_recorder* recorder,
+                        const uint32_t* words,
+                        const size_t count)
+{
+    assert(recorder != NULL);
+    assert(words != NULL);
+
+    if (fwrite(words, sizeof(uint32_t), count, recorder->file) != count)
+    {
+        recorder->failed = true;
+    }
+}
+
+// Writes the header of a record of type `type` holding `count`.
+static void write_header(struct libps_gpu_recorder* recorder,
+                         const enum libps_gpu_dump_record type,
+                         const unsigned int count)
+{
+    assert(recorder != NULL);
+    assert(count <= LIBPS_GPU_DUMP_MAX_COUNT);
+
+    const uint32_t header = ((uint32_t)type << 24) | count;
+    write_words(recorder, &header, 1);
+}
+
+// Writes the record being built, if any.
+static void flush_run(struct libps_gpu_recorder* recorder)
+{
+    assert(recorder != NULL);
+
+    if (recorder->run_count != 0)
+    {
+        write_header(recorder, recorder->run_type, recorder->run_count);
+        write_words(recorder, recorder->run, recorder->run_count);
+
+        recorder->run_count = 0;
+    }
+}
+
+// Adds `count` words `words` to a record of type `type`, which is either
+// `LIBPS_GPU_DUMP_GP0` or `LIBPS_GPU_DUMP_GP1`.
+static void append_words(struct libps_gpu_recorder* recorder,
+                         const enum libps_gpu_dump_record type,
+                         const uint32_t* words,
+                         unsigned int count)
+{
+    assert(recorder != NULL);
+    assert(words != NULL);
+
+    if (recorder->run_type != type)
+    {
+        flush_run(recorder);
+        recorder->run_type = type;
+    }
+
+    while (count != 0)
+    {
+        if (recorder->run_count == RUN_WORDS)
+        {
+            flush_run(recorder);
+        }
+
+        const unsigned int n = LIBPS_MIN(count,
+                                         RUN_WORDS - recorder->run_count);
+
+        memcpy(&recorder->run[recorder->run_count],
+               words,
+               n * sizeof(uint32_t));
+
+        recorder->run_count += n;
+        words               += n;
+        count               -= n;
+    }
+}
+
+// Adds GP0 word `packet` to the dump.
+static void append_gp0(struct libps_gpu_recorder* recorder,
+                       const uint32_t packet)
+{
+    append_words(recorder, LIBPS_GPU_DUMP_GP0, &packet, 1);
+}
+
+// Adds GP1 word `packet` to the dump.
+static void append_gp1(struct libps_gpu_recorder* recorder,
+                       const uint32_t packet)
+{
+    append_words(recorder, LIBPS_GPU_DUMP_GP1, &packet, 1);
+}
+
+// Writes the records which restore the GPU to its current state. The GPU
+// must be idle and between two GP0 commands.
+static void write_snapshot(struct libps_gpu_recorder* recorder)
+{
+    assert(recorder != NULL);
+
+    const struct libps_gpu* gpu = recorder->gpu;
+    const uint32_t gpustat      = gpu->gpustat;
+
+    // GP1(08h) - Display mode, from GPUSTAT bits 14 and 16-22
+    append_gp1(recorder, 0x08000000                    |
+                         ((gpustat >> 17) & 0x3F)      |
+                         (((gpustat >> 16) & 1) << 6)  |
+                         (((gpustat >> 14) & 1) << 7));
+
+    append_gp1(recorder, 0x03000000 | ((gpustat >> 23) & 1));
+    append_gp1(recorder, 0x04000000 | ((gpustat >> 29) & 3));
+
+    append_gp1(recorder, 0x05000000                   |
+                         gpu->display_area_x          |
+                         (gpu->display_area_y << 10));
+
+    append_gp1(recorder, 0x06000000                   |
+                         gpu->display_x1              |
+                         (gpu->display_x2 << 12));
+
+    append_gp1(recorder, 0x07000000                   |
+                         gpu->display_y1              |
+                         (gpu->display_y2 << 10));
+
+    // VRAM is uploaded as a whole with the mask bit settings cleared, so that
+    // it is stored exactly as it is.
+    append_gp0(recorder, 0xE6000000);
+    append_gp0(recorder, 0xA0000000);
+    append_gp0(recorder, 0x00000000);
+    append_gp0(recorder, (LIBPS_GPU_VRAM_HEIGHT << 16) | LIBPS_GPU_VRAM_WIDTH);
+
+    const unsigned int pixels = LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_VRAM_HEIGHT;
+
+    for (unsigned int i = 0; i < pixels; i += 2)
+    {
+        append_gp0(recorder,
+                   gpu->vram[i] | ((uint32_t)gpu->vram[i + 1] << 16));
+    }
+
+    append_gp0(recorder, 0xE1000000 | gpu->draw_mode);
+    append_gp0(recorder, 0xE2000000 | gpu->texture_window);
+
+    append_gp0(recorder, 0xE3000000                   |
+                         gpu->drawing_area.x1         |
+                         (gpu->drawing_area.y1 << 10));
+
+    append_gp0(recorder, 0xE4000000                   |
+                         gpu->drawing_area.x2         |
+                         (gpu->drawing_area.y2 << 10));
+
+    append_gp0(recorder, 0xE5000000                                  |
+                         (gpu->drawing_offset_x & 0x000007FF)        |
+                         ((gpu->drawing_offset_y & 0x000007FF) << 11));
+
+    append_gp0(recorder, 0xE6000000 | gpu->mask_settings);
+}
+
+// Creates a recorder writing a dump of what is written to `gpu` into `file`,
+// which must be open for writing in binary mode. The recorder owns `file`
+// from now on.
+struct libps_gpu_recorder* libps_gpu_recorder_create(struct libps_gpu* gpu,
+                                                     FILE* file)
+{
+    assert(gpu != NULL);
+    assert(file != NULL);
+
+    struct libps_gpu_recorder* recorder =
+    libps_safe_malloc(sizeof(struct libps_gpu_recorder));
+
+    recorder->gpu       = gpu;
+    recorder->file      = file;
+    recorder->capturing = false;
+    recorder->failed    = false;
+    recorder->run_type  = LIBPS_GPU_DUMP_GP0;
+    recorder->run_count = 0;
+
+    const uint32_t version = LIBPS_GPU_DUMP_VERSION;
+
+    if (fwrite(LIBPS_GPU_DUMP_MAGIC, 1, 8, file) != 8)
+    {
+        recorder->failed = true;
+    }
+    write_words(recorder, &version, 1);
+
+    return recorder;
+}
+
+// Writes everything still buffered, closes the file and destroys `recorder`.
+// Returns `false` if writing any part of the dump failed.
+bool libps_gpu_recorder_destroy(struct libps_gpu_recorder* recorder)
+{
+    assert(recorder != NULL);
+
+    flush_run(recorder);
+
+    bool ok = !recorder->failed;
+
+    if (fclose(recorder->file) != 0)
+    {
+        ok = false;
+    }
+
+    libps_safe_free(recorder);
+    return ok;
+}
+
+// Returns `true` once the capture has started.
+bool libps_gpu_recorder_capturing(const struct libps_gpu_recorder* recorder)
+{
+    assert(recorder != NULL);
+    return recorder->capturing;
+}
+
+// Makes the capture start over, with a new snapshot, at the next GP0 command.
+// Called when the state of the GPU changed other than through GP0 and GP1
+// words, such as when it is reset.
+void libps_gpu_recorder_restart(struct libps_gpu_recorder* recorder)
+{
+    assert(recorder != NULL);
+    recorder->capturing = false;
+}
+
+// Records `count` GP0 words `packets` about to be processed. If the capture
+// has not started yet and the GPU is between two commands, it starts here;
+// until then, words are passed one at a time.
+void libps_gpu_recorder_gp0(struct libps_gpu_recorder* recorder,
+                            const uint32_t* packets,
+                            const unsigned int count)
+{
+    assert(recorder != NULL);
+    assert(packets != NULL);
+
+    if (!recorder->capturing)
+    {
+        assert(count == 1);
+
+        // Whatever GP0(C0h) has not sent yet is cancelled by the next
+        // command, so that counts as being between two commands.
+        libps_gpu_sync(recorder->gpu);
+
+        if ((recorder->gpu->state != LIBPS_GPU_AWAITING_COMMAND) &&
+            (recorder->gpu->state != LIBPS_GPU_TRANSFERRING_DATA))
+        {
+            return;
+        }
+
+        write_snapshot(recorder);
+        recorder->capturing = true;
+    }
+    append_words(recorder, LIBPS_GPU_DUMP_GP0, packets, count);
+}
+
+// Records GP1 word `packet` about to be processed.
+void libps_gpu_recorder_gp1(struct libps_gpu_recorder* recorder,
+                            const uint32_t packet)
+{
+    assert(recorder != NULL);
+
+    // Until then, the effect of GP1 words is part of the snapshot.
+    if (recorder->capturing)
+    {
+        append_gp1(recorder, packet);
+    }
+}
+
+// Records that `count` words are about to be read from GPUREAD.
+void libps_gpu_recorder_gpuread(struct libps_gpu_recorder* recorder,
+                                const unsigned int count)
+{
+    assert(recorder != NULL);
+
+    if (!recorder->capturing)
+    {
+        return;
+    }
+
+    flush_run(recorder);
+
+    for (unsigned int left = count; left != 0;)
+    {
+        const unsigned int n = LIBPS_MIN(left, LIBPS_GPU_DUMP_MAX_COUNT);
+
+        write_header(recorder, LIBPS_GPU_DUMP_GPUREAD, n);
+        left -= n;
+    }
+}
+
+// Records the start of vertical blank.
+void libps_gpu_recorder_frame(struct libps_gpu_recorder* recorder)
+{
+    assert(recorder != NULL);
+
+    if (recorder->capturing)
+    {
+        flush_run(recorder);
+        write_header(recorder, LIBPS_GPU_DUMP_FRAME, 0);
+    }
+}
@@ -0,0 +1,197 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gpu.h"
+#include "gpu_thread.h"
+#include "utility/memory.h"
+#include "utility/ring.h"
+#include "utility/thread.h"
+
+// Number of GP0 words which can be queued, a little over one frame's worth
+// of a busy game's command lists.
+#define QUEUE_SIZE (1 << 16)
+
+struct libps_gpu_thread
+{
+    struct libps_gpu* gpu;
+
+    // GP0 words waiting to be executed
+    struct libps_ring queue;
+
+    libps_thread thread;
+    libps_mutex mutex;
+
+    // Signaled when words are queued while the GPU thread is sleeping
+    libps_cond wake;
+
+    // Signaled when the GPU thread runs out of words
+    libps_cond idle;
+
+    // Is the GPU thread about to sleep or sleeping? Only then does pushing a
+    // word have to take the mutex.
+    atomic_bool sleeping;
+
+    // Set by `libps_gpu_thread_destroy()`, protected by `mutex`
+    bool quit;
+
+    // GPUSTAT bits published by the GPU thread
+    atomic_uint status;
+};
+
+static void thread_main(void* arg)
+{
+    struct libps_gpu_thread* thread = arg;
+
+    for (;;)
+    {
+        uint32_t packet;
+
+        // A word is popped only after it has been executed, so that an empty
+        // queue means the GPU is idle.
+        while (libps_ring_peek(&thread->queue, &packet))
+        {
+            libps_gpu_execute_gp0(thread->gpu, packet);
+            libps_ring_pop(&thread->queue);
+        }
+
+        libps_mutex_lock(&thread->mutex);
+
+        atomic_store(&thread->sleeping, true);
+        libps_cond_broadcast(&thread->idle);
+
+        // `sleeping` is set before checking the queue, and the producer
+        // checks `sleeping` after pushing, so one of the two is guaranteed
+        // to see the other.
+        while (libps_ring_is_empty(&thread->queue) && !thread->quit)
+        {
+            libps_cond_wait(&thread->wake, &thread->mutex);
+        }
+
+        atomic_store(&thread->sleeping, false);
+
+        const bool quit = thread->quit &&
+                          libps_ring_is_empty(&thread->queue);
+
+        libps_mutex_unlock(&thread->mutex);
+
+        if (quit)
+        {
+            break;
+        }
+    }
+}
+
+// Starts a thread executing the GP0 words queued by
+// `libps_gpu_thread_push()` for `gpu`.
+struct libps_gpu_thread* libps_gpu_thread_create(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+
+    struct libps_gpu_thread* thread =
+    libps_safe_malloc(sizeof(struct libps_gpu_thread));
+
+    thread->gpu  = gpu;
+    thread->quit = false;
+
+    atomic_init(&thread->sleeping, false);
+    atomic_init(&thread->status, gpu->draw_status);
+
+    libps_ring_setup(&thread->queue, QUEUE_SIZE);
+    libps_mutex_init(&thread->mutex);
+    libps_cond_init(&thread->wake);
+    libps_cond_init(&thread->idle);
+
+    libps_thread_create(&thread->thread, thread_main, thread);
+    return thread;
+}
+
+// Executes every queued GP0 word and stops the thread.
+void libps_gpu_thread_destroy(struct libps_gpu_thread* thread)
+{
+    assert(thread != NULL);
+
+    libps_mutex_lock(&thread->mutex);
+    thread->quit = true;
+    libps_cond_signal(&thread->wake);
+    libps_mutex_unlock(&thread->mutex);
+
+    libps_thread_join(&thread->thread);
+
+    libps_cond_destroy(&thread->idle);
+    libps_cond_destroy(&thread->wake);
+    libps_mutex_destroy(&thread->mutex);
+    libps_ring_cleanup(&thread->queue);
+
+    libps_safe_free(thread);
+}
+
+// Queues GP0 word `packet`. If the queue is full, this waits for the GPU
+// thread to catch up.
+void libps_gpu_thread_push(struct libps_gpu_thread* thread,
+                           const uint32_t packet)
+{
+    assert(thread != NULL);
+
+    if (!libps_ring_push(&thread->queue, packet))
+    {
+        libps_gpu_thread_wait(thread);
+        libps_ring_push(&thread->queue, packet);
+    }
+
+    if (atomic_load(&thread->sleeping))
+    {
+        libps_mutex_lock(&thread->mutex);
+        libps_cond_signal(&thread->wake);
+        libps_mutex_unlock(&thread->mutex);
+    }
+}
+
+// Waits for the GPU thread to finish executing every queued GP0 word.
+void libps_gpu_thread_wait(struct libps_gpu_thread* thread)
+{
+    assert(thread != NULL);
+
+    if (libps_ring_is_empty(&thread->queue))
+    {
+        return;
+    }
+
+    libps_mutex_lock(&thread->mutex);
+
+    while (!libps_ring_is_empty(&thread->queue))
+    {
+        libps_cond_wait(&thread->idle, &thread->mutex);
+    }
+    libps_mutex_unlock(&thread->mutex);
+}
+
+// Makes `status`, the GPUSTAT bits which depend on the GP0 commands executed
+// so far, visible to other threads.
+void libps_gpu_thread_set_status(struct libps_gpu_thread* thread,
+                                 const uint32_t status)
+{
+    assert(thread != NULL);
+    atomic_store(&thread->status, status);
+}
+
+// Returns the GPUSTAT bits last passed to `libps_gpu_thread_set_status()`.
+uint32_t libps_gpu_thread_get_status(struct libps_gpu_thread* thread)
+{
+    assert(thread != NULL);
+    return atomic_load(&thread->status);
+}
@@ -24,6 +24,7 @@ extern "C"
 #include "cd.h"
 #include "gpu.h"
 #include "rcnt.h"
+#include "scheduler.h"
 
 #ifdef LIBPS_DEBUG
 #define LIBPS_DEBUG_WORD 0xFFFFFFFF
@@ -74,6 +75,9 @@ struct libps_bus
     // Root counter instance
     struct libps_rcnt rcnt;
 
+    // Owns the system clock and device events
+    struct libps_scheduler scheduler;
+
     // DMA channel 2 - GPU (lists + image data)
     struct libps_dma_channel dma_gpu_channel;
 
@@ -125,8 +129,9 @@ void libps_bus_cleanup(struct libps_bus* bus);
 // Resets the system bus, which resets the peripherals to their startup state.
 void libps_bus_reset(struct libps_bus* bus);
 
-// Handles DMA requests.
-void libps_bus_step(struct libps_bus* bus);
+// Handles DMA requests and advances the devices which are not driven by the
+// scheduler by `cycles` system clock cycles.
+void libps_bus_step(struct libps_bus* bus, const unsigned int cycles);
 
 // Stores word `data` into memory referenced by virtual address `vaddr`.
 void libps_bus_store_word(struct libps_bus* bus,
@@ -185,7 +185,7 @@ struct libps_cdrom
 void libps_cdrom_setup(struct libps_cdrom* cdrom);
 void libps_cdrom_cleanup(struct libps_cdrom* cdrom);
 void libps_cdrom_reset(struct libps_cdrom* cdrom);
-void libps_cdrom_step(struct libps_cdrom* cdrom);
+void libps_cdrom_step(struct libps_cdrom* cdrom, const unsigned int cycles);
 
 uint8_t libps_cdrom_register_load(struct libps_cdrom* cdrom,
                                   const unsigned int reg);
@@ -46,6 +46,11 @@ struct libps_cpu
 
     // System control co-processor (COP0) registers
     uint32_t cop0_cpr[32];
+
+    // Number of cycles until the result of the last multiplication or
+    // division is available in HI/LO. Reading either register before then
+    // stalls the CPU.
+    unsigned int hilo_cycles;
 };
 
 // Sets the pointer to the system bus to `b`. This cannot be `NULL`.
@@ -55,8 +60,9 @@ void libps_cpu_set_bus(struct libps_bus* b);
 // startup state.
 void libps_cpu_reset(struct libps_cpu* cpu);
 
-// Executes one instruction.
-void libps_cpu_step(struct libps_cpu* cpu);
+// Executes one instruction, returning the number of system clock cycles it
+// took.
+unsigned int libps_cpu_step(struct libps_cpu* cpu);
 
 #ifdef __cplusplus
 }
@@ -19,6 +19,7 @@ extern "C"
 {
 #endif // __cplusplus
 
+#include <stdbool.h>
 #include <stdint.h>
 
 // Drawing flags
@@ -34,9 +35,39 @@ extern "C"
 #define LIBPS_GPU_VRAM_WIDTH 1024
 #define LIBPS_GPU_VRAM_HEIGHT 512
 
+// VRAM writes are tracked in blocks of 64x16 pixels.
+#define LIBPS_GPU_VRAM_BLOCK_WIDTH 64
+#define LIBPS_GPU_VRAM_BLOCK_HEIGHT 16
+#define LIBPS_GPU_VRAM_BLOCKS_X (LIBPS_GPU_VRAM_WIDTH / LIBPS_GPU_VRAM_BLOCK_WIDTH)
+#define LIBPS_GPU_VRAM_BLOCKS_Y (LIBPS_GPU_VRAM_HEIGHT / LIBPS_GPU_VRAM_BLOCK_HEIGHT)
+
+// Number of 32-bit words in a VRAM dirty bitmap. Block N (counting along the
+// rows) is bit `N % 32` of word `N / 32`.
+#define LIBPS_GPU_VRAM_DIRTY_WORDS \
+((LIBPS_GPU_VRAM_BLOCKS_X * LIBPS_GPU_VRAM_BLOCKS_Y) / 32)
+
+// Largest internal resolution multiplier `libps_gpu_set_scale()` accepts
+#define LIBPS_GPU_MAX_SCALE 4
+
+// Maximum number of polyline vertices drawn at once. Longer polylines are
+// drawn in several batches.
+#define LIBPS_GPU_POLYLINE_VERTICES 64
+
 // Interrupts
 #define LIBPS_IRQ_VBLANK (1 << 0)
 
+// Video timing signals returned by `libps_gpu_process_event()`
+#define LIBPS_GPU_HBLANK_START (1 << 0)
+#define LIBPS_GPU_HBLANK_END (1 << 1)
+#define LIBPS_GPU_VBLANK_START (1 << 2)
+#define LIBPS_GPU_VBLANK_END (1 << 3)
+
+struct libps_gpu_frameskip;
+struct libps_gpu_recorder;
+struct libps_gpu_thread;
+struct libps_renderer_sw_texture_cache;
+struct libps_scheduler;
+
 enum libps_gpu_state
 {
     LIBPS_GPU_AWAITING_COMMAND,
@@ -45,6 +76,78 @@ enum libps_gpu_state
     LIBPS_GPU_TRANSFERRING_DATA,
 };
 
+// Pixel formats the display area can be converted to by `libps_gpu_scanout()`
+enum libps_gpu_scanout_format
+{
+    // 0xFFRRGGBB in host byte order
+    LIBPS_GPU_SCANOUT_XRGB8888,
+
+    // 0xFFBBGGRR in host byte order, i.e. the bytes R, G, B and A in that
+    // order on little endian hosts
+    LIBPS_GPU_SCANOUT_RGBA8888
+};
+
+// The part of VRAM shown on screen
+struct libps_gpu_display_area
+{
+    // Top left corner, in 16-bit units (0..1023, 0..511)
+    unsigned int x;
+    unsigned int y;
+
+    // Size in pixels (0..1024, 0..512). In 24-bit mode, every pixel takes up
+    // 1.5 16-bit units of VRAM.
+    unsigned int width;
+    unsigned int height;
+
+    // Every pixel is scanned out as `scale` x `scale` pixels, taken from the
+    // upscaled VRAM if this is greater than 1.
+    unsigned int scale;
+
+    // Is the display area in 24-bit color (GP1(08h) bit 4)?
+    bool color_24bit;
+
+    // Has the display been disabled by GP1(03h)?
+    bool disabled;
+};
+
+// How much work the GPU did during one frame, see `libps_gpu_get_stats()`
+struct libps_gpu_stats
+{
+    // GP0 words executed, image data included
+    uint64_t gp0_words;
+
+    // Primitives drawn, by type. Every segment of a polyline counts as a
+    // line.
+    uint64_t triangles;
+    uint64_t quads;
+    uint64_t rectangles;
+    uint64_t lines;
+
+    // GP0(02h) commands executed
+    uint64_t fills;
+
+    // Pixels primitives and fills wrote to. Pixels of fully transparent
+    // texels count as written.
+    uint64_t pixels_written;
+
+    // Pixels of primitives which were outside of the drawing area
+    uint64_t pixels_clipped;
+
+    // Pixels of primitives which were left alone because their mask bit was
+    // set (GP0(E6h) bit 1)
+    uint64_t pixels_masked;
+
+    // Texture page lookups of the software renderers which found decoded
+    // texels, and which had to decode them
+    uint64_t texture_cache_hits;
+    uint64_t texture_cache_misses;
+
+    // Bytes moved by GP0(A0h), GP0(C0h) and GP0(80h)
+    uint64_t vram_upload_bytes;
+    uint64_t vram_download_bytes;
+    uint64_t vram_copy_bytes;
+};
+
 struct libps_gpu_vertex
 {
     // (-1024..+1023)
@@ -60,6 +163,88 @@ struct libps_gpu_vertex
     uint32_t color;
 };
 
+struct libps_gpu;
+
+// Operations of a renderer. The GPU parses the commands and keeps `vram`; the
+// renderer does everything which changes or displays pixels. Every operation
+// but `scanout` is called on the thread executing GP0 commands.
+struct libps_gpu_renderer
+{
+    void (*draw_polygon)(struct libps_gpu* gpu,
+                         const struct libps_gpu_vertex* const v0,
+                         struct libps_gpu_vertex* const v1,
+                         struct libps_gpu_vertex* const v2);
+
+    // Draws the quad made of the triangles (`vertices[0]`, `vertices[1]`,
+    // `vertices[2]`) and (`vertices[1]`, `vertices[2]`, `vertices[3]`).
+    void (*draw_quad)(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertices);
+
+    // Draws the `width` x `height` rectangle whose top left corner is
+    // `vertex`.
+    void (*draw_rect)(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertex,
+                      const unsigned int width,
+                      const unsigned int height);
+
+    // Draws the `count` - 1 lines joining the `count` vertices `vertices`.
+    void (*draw_line)(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertices,
+                      const unsigned int count);
+
+    // Fills the `width` x `height` area of VRAM at (`x`, `y`) with the 15-bit
+    // `color` for GP0(02h). The area wraps around the edges of VRAM.
+    void (*fill_rect)(struct libps_gpu* gpu,
+                      const unsigned int x,
+                      const unsigned int y,
+                      const unsigned int width,
+                      const unsigned int height,
+                      const uint16_t color);
+
+    // Copies the `width` x `height` area of VRAM at (`src_x`, `src_y`) to
+    // (`dst_x`, `dst_y`) for GP0(80h), honouring the mask bit setting.
+    void (*copy_rect)(struct libps_gpu* gpu,
+                      const unsigned int src_x,
+                      const unsigned int src_y,
+                      const unsigned int dst_x,
+                      const unsigned int dst_y,
+                      const unsigned int width,
+                      const unsigned int height);
+
+    // Called once the `width` x `height` area of `vram` at (`x`, `y`) has
+    // been written by the GPU itself, such as by a GP0(A0h) transfer, for
+    // renderers which keep other copies of VRAM.
+    void (*store_rect)(struct libps_gpu* gpu,
+                       const unsigned int x,
+                       const unsigned int y,
+                       const unsigned int width,
+                       const unsigned int height);
+
+    // Called before the GPU accesses VRAM directly, for renderers which draw
+    // asynchronously. This can be `NULL`.
+    void (*sync)(struct libps_gpu* gpu);
+
+    // Does the work of `libps_gpu_scanout()`. The GPU has been synced.
+    void (*scanout)(struct libps_gpu* gpu,
+                    const struct libps_gpu_display_area* area,
+                    uint32_t* pixels,
+                    const unsigned int stride,
+                    const enum libps_gpu_scanout_format format);
+
+    // Releases `renderer_data` when the renderer stops being used. This can
+    // be `NULL`.
+    void (*cleanup)(struct libps_gpu* gpu);
+};
+
+// The single-threaded software renderer, which is the default
+extern const struct libps_gpu_renderer libps_renderer_sw;
+
+// Renderer which draws nothing. Fills, copies and transfers still go through
+// VRAM, so GPUREAD and the CPU see the same data as with any other renderer,
+// but the display only shows what those wrote. This is for runs where the
+// picture doesn't matter.
+extern const struct libps_gpu_renderer libps_renderer_null;
+
 struct libps_gpu
 {
     // 0x1F801810 - Read responses to GP0(C0h) and GP1(10h) commands
@@ -71,16 +256,58 @@ struct libps_gpu
     // The 1MByte VRAM is organized as 512 lines of 2048 bytes.
     uint16_t* vram;
 
+    // Internal resolution multiplier set by `libps_gpu_set_scale()`
+    unsigned int scale;
+
+    // If `scale` is greater than 1, a copy of VRAM `scale` times as wide and
+    // as tall, which everything is also drawn into at that resolution.
+    // Otherwise, `NULL`. `vram` stays authoritative for everything but
+    // display.
+    uint16_t* upscaled_vram;
+
     // State of the GP0 port.
     enum libps_gpu_state state;
 
-    void (*draw_polygon)(struct libps_gpu* gpu,
-                         const struct libps_gpu_vertex* const v0,
-                         struct libps_gpu_vertex* const v1,
-                         struct libps_gpu_vertex* const v2);
+    // Renderer drawing into VRAM, see `libps_gpu_set_renderer()`
+    const struct libps_gpu_renderer* renderer;
 
-    void (*draw_rect)(struct libps_gpu* gpu,
-                      const struct libps_gpu_vertex* const vertex);
+    // Private data of the renderer, if it needs any
+    void* renderer_data;
+
+    // Thread executing GP0 commands, or `NULL` if they are executed by the
+    // thread writing them
+    struct libps_gpu_thread* thread;
+
+    // Recorder started by `libps_gpu_start_recording()`, or `NULL`
+    struct libps_gpu_recorder* recorder;
+
+    // Are statistics being collected? See `libps_gpu_set_stats_enabled()`.
+    bool stats_enabled;
+
+    // Is the frame in progress being skipped? See
+    // `libps_gpu_set_frame_skipping()`. This belongs to the thread executing
+    // GP0 commands.
+    bool skipping_frame;
+
+    // Primitives of the skipped frame which haven't been drawn yet, or `NULL`
+    // if no frame has been skipped so far
+    struct libps_gpu_frameskip* frameskip;
+
+    // Statistics of the frame in progress, which belong to the thread
+    // executing GP0 commands, and of the last complete frame
+    struct libps_gpu_stats stats;
+    struct libps_gpu_stats frame_stats;
+
+    // Decoded texture pages used by the software renderers
+    struct libps_renderer_sw_texture_cache* texture_cache;
+
+    // Incremented every time VRAM is written
+    uint64_t vram_stamp;
+
+    // The value of `vram_stamp` when each block of VRAM was last written.
+    // Blocks are stored in rows.
+    uint64_t
+    vram_block_stamps[LIBPS_GPU_VRAM_BLOCKS_X * LIBPS_GPU_VRAM_BLOCKS_Y];
 
     struct
     {
@@ -90,6 +317,38 @@ struct libps_gpu
 		uint32_t raw;
     } cmd_packet;
 
+    // Polyline being received by GP0(48h..4Fh, 58h..5Fh)
+    struct
+    {
+        // Vertices not drawn yet. After a batch is drawn, its last vertex
+        // stays to start the next one.
+        struct libps_gpu_vertex vertices[LIBPS_GPU_POLYLINE_VERTICES];
+        unsigned int count;
+
+        // Color of the next vertex
+        uint32_t color;
+
+        // Has the color of the next vertex of a shaded polyline been
+        // received?
+        bool has_color;
+    } polyline;
+
+    // VRAM transfer started by GP0(A0h) or GP0(C0h)
+    struct
+    {
+        // Top left corner of the rectangle (0..1023, 0..511)
+        unsigned int x;
+        unsigned int y;
+
+        // Size of the rectangle (1..1024, 1..512)
+        unsigned int width;
+        unsigned int height;
+
+        // Position of the next pixel within the rectangle
+        unsigned int column;
+        unsigned int row;
+    } transfer;
+
     struct
     {
         // (0..1023)
@@ -107,11 +366,72 @@ struct libps_gpu
     // (-1024..+1023)
     int16_t drawing_offset_y;
 
+    // GP0(E1h) - Draw Mode setting, bits 0-13. Textured polygons replace
+    // bits 0-8 and 11 with their texture page.
+    uint16_t draw_mode;
+
+    // GP0(E2h) - Texture Window setting, bits 0-19
+    uint32_t texture_window;
+
+    // GP0(E6h) - Mask Bit Setting, bits 0-1
+    uint8_t mask_settings;
+
+    // The GPUSTAT bits which reflect `draw_mode` and `mask_settings`. Like
+    // them, this belongs to the thread executing GP0 commands.
+    uint32_t draw_status;
+
     uint32_t received_data;
+
+    // GP1(05h) - Start of Display area (in VRAM)
+    uint16_t display_area_x;
+    uint16_t display_area_y;
+
+    // GP1(06h) - Horizontal Display range (on Screen), in GPU clocks
+    uint16_t display_x1;
+    uint16_t display_x2;
+
+    // GP1(07h) - Vertical Display range (on Screen), in scanlines
+    uint16_t display_y1;
+    uint16_t display_y2;
+
+    // Video timing, derived from GP1(08h)
+    struct
+    {
+        // GPU clock the current scanline started on, counted from reset. The
+        // GPU clock runs at 11/7 times the system clock.
+        uint64_t line_start;
+
+        // The number of GPU clocks per scanline (3413 NTSC, 3406 PAL)
+        unsigned int scanline_clocks;
+
+        // The number of scanlines per frame (263 NTSC, 314 PAL)
+        unsigned int scanlines;
+
+        // The number of GPU clocks per dot, depending on the horizontal
+        // resolution
+        unsigned int dotclock_divider;
+
+        // Scanline currently being output
+        unsigned int scanline;
+
+        bool in_hblank;
+        bool in_vblank;
+
+        // Is the odd field being output (interlaced modes only)?
+        bool odd_field;
+    } video;
+
+    // Incremented every time vertical blanking starts. Frontends compare this
+    // against the previous value to find frame boundaries.
+    unsigned int frame_count;
+
+    // The scheduler which owns the system clock
+    struct libps_scheduler* scheduler;
 };
 
-// Initializes a GPU.
-void libps_gpu_setup(struct libps_gpu* gpu);
+// Initializes a GPU. `scheduler` drives the video timing and cannot be
+// `NULL`.
+void libps_gpu_setup(struct libps_gpu* gpu, struct libps_scheduler* scheduler);
 
 // Destroys the PlayStation GPU.
 void libps_gpu_cleanup(struct libps_gpu* gpu);
@@ -119,12 +439,117 @@ void libps_gpu_cleanup(struct libps_gpu* gpu);
 // Resets the GPU to the initial state.
 void libps_gpu_reset(struct libps_gpu* gpu);
 
-// Processes a GP0 packet.
+// Processes a GP0 packet. If the GPU thread is running, the packet is only
+// queued.
 void libps_gpu_process_gp0(struct libps_gpu* gpu, const uint32_t packet);
 
+// Executes a GP0 packet on the calling thread. While the GPU thread is
+// running, only the GPU thread may call this.
+void libps_gpu_execute_gp0(struct libps_gpu* gpu, const uint32_t packet);
+
+// Processes `count` GP0 packets from `packets`. Image data for GP0(A0h) is
+// stored a row at a time rather than a packet at a time.
+void libps_gpu_process_gp0_block(struct libps_gpu* gpu,
+                                 const uint32_t* packets,
+                                 const unsigned int count);
+
 // Processes a GP1 packet.
 void libps_gpu_process_gp1(struct libps_gpu* gpu, const uint32_t packet);
 
+// Waits for the GPU thread and the renderer to finish all work queued so
+// far. This must be called before accessing GPU state owned by the GPU
+// thread, such as `vram` and `gpuread`, from outside of the GPU.
+void libps_gpu_sync(struct libps_gpu* gpu);
+
+// Starts (`threaded` is `true`) or stops executing GP0 commands on a
+// dedicated thread.
+void libps_gpu_set_threaded(struct libps_gpu* gpu, const bool threaded);
+
+// Starts recording a dump of the GP0 and GP1 words written to the GPU, see
+// gpu_recorder.h, into the file `path`, stopping any recording in progress.
+// Returns `false` if the file could not be created.
+bool libps_gpu_start_recording(struct libps_gpu* gpu, const char* path);
+
+// Stops recording, if a recording is in progress. Returns `false` if writing
+// any part of the dump failed.
+bool libps_gpu_stop_recording(struct libps_gpu* gpu);
+
+// Starts (`enabled` is `true`) or stops collecting statistics of the work
+// done every frame. Collecting them slows drawing down slightly.
+void libps_gpu_set_stats_enabled(struct libps_gpu* gpu, const bool enabled);
+
+// Starts (`skipping` is `true`) or stops skipping the drawing of frames. While
+// a frame is skipped, polygons, rectangles and lines are only drawn if
+// something else reads VRAM they would have drawn to (see gpu_frameskip.h),
+// and the rest of them are thrown away at the start of vertical blanking.
+// This is meant to be called between frames, and skipped frames shouldn't be
+// presented. Anything recorded but not drawn yet is thrown away.
+void libps_gpu_set_frame_skipping(struct libps_gpu* gpu, const bool skipping);
+
+// Fills `stats` with the statistics of the last complete frame. Everything
+// is 0 if statistics aren't being collected.
+void libps_gpu_get_stats(const struct libps_gpu* gpu,
+                         struct libps_gpu_stats* stats);
+
+// Makes `gpu` draw with `renderer`, which takes ownership of `data` (its
+// `renderer_data`). The renderer in use so far finishes drawing and is
+// cleaned up.
+void libps_gpu_set_renderer(struct libps_gpu* gpu,
+                            const struct libps_gpu_renderer* renderer,
+                            void* data);
+
+// Sets the internal resolution multiplier to `scale` (1 to
+// `LIBPS_GPU_MAX_SCALE`). Polygons, rectangles and lines are drawn at `scale`
+// times the resolution of VRAM for display, while VRAM itself is drawn
+// exactly as before.
+void libps_gpu_set_scale(struct libps_gpu* gpu, const unsigned int scale);
+
+// Returns the value of GPUREAD, waiting for the GPU thread if needed. During
+// a GP0(C0h) transfer, this returns the next two pixels of the rectangle.
+uint32_t libps_gpu_read_gpuread(struct libps_gpu* gpu);
+
+// Reads `count` words of GPUREAD into `words` at once, waiting for the GPU
+// thread if needed.
+void libps_gpu_read_gpuread_block(struct libps_gpu* gpu,
+                                  uint32_t* words,
+                                  const unsigned int count);
+
+// Records that the `width` by `height` pixel area of VRAM starting at (`x`,
+// `y`) has been written. Areas crossing the edges of VRAM wrap around.
+void libps_gpu_mark_vram(struct libps_gpu* gpu,
+                         const unsigned int x,
+                         const unsigned int y,
+                         const unsigned int width,
+                         const unsigned int height);
+
+// Fills `dirty` with a bitmap of the VRAM blocks written since `*stamp` and
+// sets `*stamp` to the current write stamp, so that calling this again only
+// reports newer writes. A `*stamp` of 0 reports every block written since the
+// GPU was set up. Returns `true` if any block is dirty.
+bool libps_gpu_get_dirty_vram(struct libps_gpu* gpu,
+                              uint64_t* stamp,
+                              uint32_t dirty[LIBPS_GPU_VRAM_DIRTY_WORDS]);
+
+// Fills `area` with the part of VRAM currently shown on screen.
+void libps_gpu_get_display_area(const struct libps_gpu* gpu,
+                                struct libps_gpu_display_area* area);
+
+// Converts the display area `area` to `format` and stores it in `pixels`,
+// which must have room for `area->height * area->scale` rows of `stride`
+// pixels each. A disabled display is stored as black.
+void libps_gpu_scanout(struct libps_gpu* gpu,
+                       const struct libps_gpu_display_area* area,
+                       uint32_t* pixels,
+                       const unsigned int stride,
+                       const enum libps_gpu_scanout_format format);
+
+// Returns the value of GPUSTAT as seen by the CPU.
+uint32_t libps_gpu_read_gpustat(struct libps_gpu* gpu);
+
+// Called by the scheduler when the video timing event fires. Returns the
+// `LIBPS_GPU_*BLANK*` signals which occurred.
+unsigned int libps_gpu_process_event(struct libps_gpu* gpu);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,84 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Drawing of skipped frames, see `libps_gpu_set_frame_skipping()`. While a
+// frame is skipped, polygons, rectangles and lines are recorded instead of
+// drawn, along with the drawing state they depend on. The VRAM blocks they
+// draw to and take texels from are tracked, and everything recorded so far is
+// drawn, in order, as soon as anything else depends on those blocks:
+//
+// * a VRAM to CPU transfer or VRAM copy reads from blocks drawn to
+// * a fill, transfer or copy writes to blocks drawn to or taken texels from
+// * a primitive takes texels from blocks drawn to
+//
+// What is still recorded at the end of the frame is thrown away. Those
+// primitives would only have changed what is displayed.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdbool.h>
+
+struct libps_gpu;
+struct libps_gpu_frameskip;
+struct libps_gpu_vertex;
+
+// Creates an empty recording.
+struct libps_gpu_frameskip* libps_gpu_frameskip_create(void);
+
+// Destroys `frameskip` without drawing anything.
+void libps_gpu_frameskip_destroy(struct libps_gpu_frameskip* frameskip);
+
+// Records the polygon of `count` (3 or 4) `vertices` about to be drawn by
+// `gpu` with its current drawing state.
+void libps_gpu_frameskip_polygon(struct libps_gpu* gpu,
+                                 const struct libps_gpu_vertex* vertices,
+                                 const unsigned int count);
+
+// Records the `width` x `height` rectangle whose top left corner is `vertex`.
+void libps_gpu_frameskip_rect(struct libps_gpu* gpu,
+                              const struct libps_gpu_vertex* vertex,
+                              const unsigned int width,
+                              const unsigned int height);
+
+// Records the `count` - 1 lines joining the `count` vertices `vertices`.
+void libps_gpu_frameskip_line(struct libps_gpu* gpu,
+                              const struct libps_gpu_vertex* vertices,
+                              const unsigned int count);
+
+// Called before `gpu` accesses the `width` x `height` area of VRAM at (`x`,
+// `y`) directly, writing to it if `write` is `true` and reading from it
+// otherwise. Draws everything recorded if any of it depends on the area.
+void libps_gpu_frameskip_access(struct libps_gpu* gpu,
+                                const unsigned int x,
+                                const unsigned int y,
+                                const unsigned int width,
+                                const unsigned int height,
+                                const bool write);
+
+// Draws everything recorded for `gpu` with its renderer, in order and each
+// primitive with the drawing state it was recorded with, and empties the
+// recording.
+void libps_gpu_frameskip_draw(struct libps_gpu* gpu);
+
+// Throws away everything recorded for `gpu`.
+void libps_gpu_frameskip_discard(struct libps_gpu* gpu);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
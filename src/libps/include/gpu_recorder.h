@@ -0,0 +1,106 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Records the GP0 and GP1 words written to a GPU, the VRAM contents at the
+// start of the capture and the start of every frame into a file, which can
+// be fed back to a GPU without emulating the rest of the system.
+//
+// A dump starts with `LIBPS_GPU_DUMP_MAGIC` and `LIBPS_GPU_DUMP_VERSION`,
+// followed by records until the end of the file. Every record is a 32-bit
+// header word, whose top 8 bits are a `libps_gpu_dump_record` and whose low
+// 24 bits are a count, followed by the payload words, if any. All words are
+// little endian.
+//
+// The capture starts between two GP0 commands. The first records of a dump
+// restore the GPU to the state it was in at that point: GP1 words setting up
+// the display, a GP0(A0h) upload of all of VRAM and the GP0(E1h..E6h)
+// settings.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// The first 8 bytes of a dump
+#define LIBPS_GPU_DUMP_MAGIC "LIBPSGPU"
+
+// The 32-bit word following `LIBPS_GPU_DUMP_MAGIC`
+#define LIBPS_GPU_DUMP_VERSION 1
+
+// Largest count a record header can hold
+#define LIBPS_GPU_DUMP_MAX_COUNT 0x00FFFFFF
+
+enum libps_gpu_dump_record
+{
+    // `count` GP0 words follow.
+    LIBPS_GPU_DUMP_GP0,
+
+    // `count` GP1 words follow.
+    LIBPS_GPU_DUMP_GP1,
+
+    // `count` words were read from GPUREAD. Nothing follows.
+    LIBPS_GPU_DUMP_GPUREAD,
+
+    // Vertical blank started. `count` is 0 and nothing follows.
+    LIBPS_GPU_DUMP_FRAME
+};
+
+struct libps_gpu;
+struct libps_gpu_recorder;
+
+// Creates a recorder writing a dump of what is written to `gpu` into `file`,
+// which must be open for writing in binary mode. The recorder owns `file`
+// from now on.
+struct libps_gpu_recorder* libps_gpu_recorder_create(struct libps_gpu* gpu,
+                                                     FILE* file);
+
+// Writes everything still buffered, closes the file and destroys `recorder`.
+// Returns `false` if writing any part of the dump failed.
+bool libps_gpu_recorder_destroy(struct libps_gpu_recorder* recorder);
+
+// Returns `true` once the capture has started.
+bool libps_gpu_recorder_capturing(const struct libps_gpu_recorder* recorder);
+
+// Makes the capture start over, with a new snapshot, at the next GP0 command.
+// Called when the state of the GPU changed other than through GP0 and GP1
+// words, such as when it is reset.
+void libps_gpu_recorder_restart(struct libps_gpu_recorder* recorder);
+
+// Records `count` GP0 words `packets` about to be processed. If the capture
+// has not started yet and the GPU is between two commands, it starts here;
+// until then, words are passed one at a time.
+void libps_gpu_recorder_gp0(struct libps_gpu_recorder* recorder,
+                            const uint32_t* packets,
+                            const unsigned int count);
+
+// Records GP1 word `packet` about to be processed.
+void libps_gpu_recorder_gp1(struct libps_gpu_recorder* recorder,
+                            const uint32_t packet);
+
+// Records that `count` words are about to be read from GPUREAD.
+void libps_gpu_recorder_gpuread(struct libps_gpu_recorder* recorder,
+                                const unsigned int count);
+
+// Records the start of vertical blank.
+void libps_gpu_recorder_frame(struct libps_gpu_recorder* recorder);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
@@ -0,0 +1,57 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Runs GP0 commands on a dedicated thread. The emulation thread pushes GP0
+// words into a lock-free ring and only waits for the GPU thread where it
+// needs a result: reading GPUREAD, VRAM to CPU transfers and the start of
+// vertical blank.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdint.h>
+
+struct libps_gpu;
+struct libps_gpu_thread;
+
+// Starts a thread executing the GP0 words queued by
+// `libps_gpu_thread_push()` for `gpu`.
+struct libps_gpu_thread* libps_gpu_thread_create(struct libps_gpu* gpu);
+
+// Executes every queued GP0 word and stops the thread.
+void libps_gpu_thread_destroy(struct libps_gpu_thread* thread);
+
+// Queues GP0 word `packet`. If the queue is full, this waits for the GPU
+// thread to catch up.
+void libps_gpu_thread_push(struct libps_gpu_thread* thread,
+                           const uint32_t packet);
+
+// Waits for the GPU thread to finish executing every queued GP0 word.
+void libps_gpu_thread_wait(struct libps_gpu_thread* thread);
+
+// Makes `status`, the GPUSTAT bits which depend on the GP0 commands executed
+// so far, visible to other threads. Called by the GPU thread.
+void libps_gpu_thread_set_status(struct libps_gpu_thread* thread,
+                                 const uint32_t status);
+
+// Returns the GPUSTAT bits last passed to `libps_gpu_thread_set_status()`.
+uint32_t libps_gpu_thread_get_status(struct libps_gpu_thread* thread);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
@@ -57,6 +57,29 @@ void libps_system_step(struct libps_system* ps);
 // `false` otherwise.
 bool libps_system_set_cdrom(struct libps_system* ps,
                             struct libps_cdrom_info* cdrom_info);
+
+// Sets the number of threads the software renderer draws with. 1 draws on the
+// emulation thread only, and 0 uses every logical processor of the host.
+void libps_system_set_render_threads(struct libps_system* ps,
+                                     const unsigned int thread_count);
+
+// Sets whether or not the GPU draws anything. A PlayStation which doesn't
+// draw still runs exactly the same, and fills, copies and transfers still
+// reach VRAM, but polygons, rectangles and lines are skipped. This is meant
+// for runs checking the emulation rather than the picture; drawing again
+// uses the single-threaded software renderer.
+void libps_system_set_drawing_enabled(struct libps_system* ps,
+                                      const bool enabled);
+
+// Sets the internal resolution multiplier of the software renderer to `scale`
+// (1 to `LIBPS_GPU_MAX_SCALE`). 1 draws at the resolution of VRAM.
+void libps_system_set_render_scale(struct libps_system* ps,
+                                   const unsigned int scale);
+
+// Sets whether or not GP0 commands are executed on a dedicated thread,
+// overlapping drawing with the rest of the emulation.
+void libps_system_set_gpu_thread(struct libps_system* ps, const bool enabled);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
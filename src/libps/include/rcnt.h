@@ -14,14 +14,32 @@
 
 #pragma once
 
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
 #include <stdbool.h>
 #include <stdint.h>
 
+// Interrupts
+#define LIBPS_IRQ_TMR0 (1 << 4)
+#define LIBPS_IRQ_TMR1 (1 << 5)
+#define LIBPS_IRQ_TMR2 (1 << 6)
+
+struct libps_scheduler;
+
+// The root counters are never ticked. Each counter remembers its value at
+// the last point it was brought up to date, and the current value is derived
+// from the number of system clock cycles elapsed since then. Target and
+// overflow interrupts are scheduled for the exact cycle they will occur on.
 struct libps_rcnt
 {
     struct rcnt_spec
     {
         // 1F801100h+N*10h - Timer 0..2 Current Counter Value (R/W)
+        //
+        // This is only the value as of `timestamp`.
         uint32_t value;
 
         // 1F801104h + N * 10h - Timer 0..2 Counter Mode(R / W)
@@ -30,22 +48,83 @@ struct libps_rcnt
         // 1F801108h + N * 10h - Timer 0..2 Counter Target Value(R / W)
         uint32_t target;
 
-        // Current cycle count
-        unsigned int counter;
+        // The system clock cycle `value` was last brought up to date on
+        uint64_t timestamp;
+
+        // Fraction of a tick carried over from the last update, in units of
+        // 1/`rate_den` ticks
+        uint64_t remainder;
+
+        // The counter advances `rate_num / rate_den` ticks per system clock
+        // cycle. A `rate_num` of 0 means the counter is stopped.
+        uint32_t rate_num;
+        uint32_t rate_den;
+
+        // Has the interrupt fired since the mode was last written? Only
+        // meaningful in one-shot mode.
+        bool irq_fired;
+
+        // An interrupt condition occurred which has not been delivered yet.
+        bool irq_pending;
+
+        // Is the blanking period this timer can synchronize to (horizontal
+        // for timer 0, vertical for timer 1) active?
+        bool in_blank;
 
-        // The number of cycles we need to wait before incrementing the timer
-        unsigned int threshold;
+        // Has a blanking period started since the mode was last written?
+        bool blank_seen;
     } rcnts[3];
+
+    // Dotclock rate (timer 0) in ticks per system clock cycle
+    uint32_t dotclock_num;
+    uint32_t dotclock_den;
+
+    // Horizontal blank rate (timer 1) in ticks per system clock cycle
+    uint32_t hblank_num;
+    uint32_t hblank_den;
+
+    // The scheduler which owns the system clock
+    struct libps_scheduler* scheduler;
 };
 
+// Initializes the root counters. `scheduler` provides the system clock and
+// cannot be `NULL`.
+void libps_rcnt_setup(struct libps_rcnt* rcnt,
+                      struct libps_scheduler* scheduler);
+
 // Resets the timers to their initial state.
 void libps_rcnt_reset(struct libps_rcnt* rcnt);
 
-// Adjusts the clock source of the timer specified by `timer_id` and resets
-// the value for said timer.
-void libps_rcnt_set_mode(struct libps_rcnt* rcnt,
-                         const unsigned int rcnt_id,
-                         const uint32_t mode);
+// Loads root counter register `reg`, which is the offset from 0x1F801100.
+uint16_t libps_rcnt_register_load(struct libps_rcnt* rcnt,
+                                  const unsigned int reg);
+
+// Stores `data` into root counter register `reg`, which is the offset from
+// 0x1F801100.
+void libps_rcnt_register_store(struct libps_rcnt* rcnt,
+                               const unsigned int reg,
+                               const uint16_t data);
+
+// Called by the scheduler when the event of the timer specified by `rcnt_id`
+// fires. Returns `true` if the timer's interrupt should be raised.
+bool libps_rcnt_process_event(struct libps_rcnt* rcnt,
+                              const unsigned int rcnt_id);
+
+// Sets the dotclock and horizontal blank rates from the GPU's video timing.
+// `dotclock_divider` is the number of GPU clocks per dot and
+// `scanline_clocks` is the number of GPU clocks per scanline.
+void libps_rcnt_set_video_timing(struct libps_rcnt* rcnt,
+                                 const unsigned int dotclock_divider,
+                                 const unsigned int scanline_clocks);
+
+// Notifies the root counters that horizontal blanking has started (`active`
+// is `true`) or ended.
+void libps_rcnt_hblank(struct libps_rcnt* rcnt, const bool active);
+
+// Notifies the root counters that vertical blanking has started (`active` is
+// `true`) or ended.
+void libps_rcnt_vblank(struct libps_rcnt* rcnt, const bool active);
 
-// Steps the root counters.
-void libps_rcnt_step(struct libps_rcnt* rcnt);
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif // __cplusplus
@@ -0,0 +1,109 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// The scheduler keeps the system cycle counter and a small, fixed set of
+// device events. Devices compute *when* something will happen (a timer
+// reaching its target, the end of a scanline...) and schedule an event for
+// that cycle instead of being ticked one cycle at a time.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Every event the system knows about. There is at most one pending instance
+// of each.
+enum libps_event_id
+{
+    LIBPS_EVENT_RCNT0,
+    LIBPS_EVENT_RCNT1,
+    LIBPS_EVENT_RCNT2,
+    LIBPS_EVENT_GPU,
+
+    LIBPS_EVENT_MAX
+};
+
+struct libps_event
+{
+    // Is this event pending?
+    bool pending;
+
+    // The absolute cycle at which the event fires
+    uint64_t timestamp;
+
+    // Called when `timestamp` has been reached. `param` is the value passed
+    // to `libps_scheduler_set_callback()`.
+    void (*callback)(void* user_data, const unsigned int param);
+
+    void* user_data;
+    unsigned int param;
+};
+
+struct libps_scheduler
+{
+    // Total number of system clock cycles elapsed since reset
+    uint64_t cycles;
+
+    // Timestamp of the earliest pending event, or `UINT64_MAX` if there are
+    // no pending events.
+    uint64_t next_timestamp;
+
+    struct libps_event events[LIBPS_EVENT_MAX];
+};
+
+// Cancels all events and resets the cycle counter. Callbacks are preserved.
+void libps_scheduler_reset(struct libps_scheduler* scheduler);
+
+// Sets the function to call when event `id` fires.
+void libps_scheduler_set_callback(struct libps_scheduler* scheduler,
+                                  const enum libps_event_id id,
+                                  void (*callback)(void* user_data,
+                                                   const unsigned int param),
+                                  void* user_data,
+                                  const unsigned int param);
+
+// Schedules event `id` to fire at absolute cycle `timestamp`, replacing any
+// pending instance of it.
+void libps_scheduler_schedule(struct libps_scheduler* scheduler,
+                              const enum libps_event_id id,
+                              const uint64_t timestamp);
+
+// Cancels event `id` if it is pending.
+void libps_scheduler_cancel(struct libps_scheduler* scheduler,
+                            const enum libps_event_id id);
+
+// Fires every event whose timestamp has been reached, in timestamp order.
+void libps_scheduler_run_events(struct libps_scheduler* scheduler);
+
+// Advances the system cycle counter by `cycles`, firing any events that
+// became due. This is the only thing that has to happen per instruction.
+static inline void libps_scheduler_advance(struct libps_scheduler* scheduler,
+                                           const unsigned int cycles)
+{
+    scheduler->cycles += cycles;
+
+    if (scheduler->cycles >= scheduler->next_timestamp)
+    {
+        libps_scheduler_run_events(scheduler);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
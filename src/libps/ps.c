@@ -15,7 +15,9 @@
 #include <assert.h>
 #include <stdlib.h>
 #include "ps.h"
+#include "renderer/sw_mt.h"
 #include "utility/memory.h"
+#include "utility/thread.h"
 
 // Creates a PlayStation emulator. `bios_data` is a pointer to the BIOS data
 // supplied by the caller and cannot be `NULL`. If `bios_data` is `NULL`, this
@@ -58,11 +60,7 @@ void libps_system_step(struct libps_system* ps)
 {
     assert(ps != NULL);
 
-    // Step 1: Check for DMAs and tick the hardware.
-    libps_bus_step(&ps->bus);
-    libps_bus_step(&ps->bus);
-
-    // Step 2: Check to see if the interrupt line needs to be enabled.
+    // Step 1: Check to see if the interrupt line needs to be enabled.
     if ((ps->bus.i_mask & ps->bus.i_stat) != 0)
     {
         ps->cpu.cop0_cpr[LIBPS_CPU_COP0_REG_CAUSE] |= (1 << 10);
@@ -72,8 +70,16 @@ void libps_system_step(struct libps_system* ps)
         ps->cpu.cop0_cpr[LIBPS_CPU_COP0_REG_CAUSE] &= ~(1 << 10);
     }
 
-    // Step 3: Execute one instruction.
-    libps_cpu_step(&ps->cpu);
+    // Step 2: Execute one instruction.
+    const unsigned int cycles = libps_cpu_step(&ps->cpu);
+
+    // Step 3: Check for DMAs and tick the hardware for as long as the
+    // instruction took.
+    libps_bus_step(&ps->bus, cycles);
+
+    // Step 4: Advance the system clock, firing any device events that have
+    // become due.
+    libps_scheduler_advance(&ps->bus.scheduler, cycles);
 }
 
 // "Inserts" a CD-ROM `cdrom_info` into a PlayStation emulator `ps`. If
@@ -98,4 +104,56 @@ bool libps_system_set_cdrom(struct libps_system* ps,
 
     ps->bus.cdrom.cdrom_info.read_cb = NULL;
     return true;
-}
\ No newline at end of file
+}
+
+// Sets the number of threads the software renderer draws with. 1 draws on the
+// emulation thread only, and 0 uses every logical processor of the host.
+void libps_system_set_render_threads(struct libps_system* ps,
+                                     const unsigned int thread_count)
+{
+    assert(ps != NULL);
+
+    const unsigned int count =
+    (thread_count == 0) ? libps_thread_hardware_concurrency() : thread_count;
+
+    if (count > 1)
+    {
+        libps_renderer_sw_mt_setup(&ps->bus.gpu, count);
+    }
+    else
+    {
+        libps_gpu_set_renderer(&ps->bus.gpu, &libps_renderer_sw, NULL);
+    }
+}
+
+// Sets whether or not the GPU draws anything. A PlayStation which doesn't
+// draw still runs exactly the same, and fills, copies and transfers still
+// reach VRAM, but polygons, rectangles and lines are skipped. This is meant
+// for runs checking the emulation rather than the picture; drawing again
+// uses the single-threaded software renderer.
+void libps_system_set_drawing_enabled(struct libps_system* ps,
+                                      const bool enabled)
+{
+    assert(ps != NULL);
+
+    libps_gpu_set_renderer(&ps->bus.gpu,
+                           enabled ? &libps_renderer_sw : &libps_renderer_null,
+                           NULL);
+}
+
+// Sets the internal resolution multiplier of the software renderer to `scale`
+// (1 to `LIBPS_GPU_MAX_SCALE`). 1 draws at the resolution of VRAM.
+void libps_system_set_render_scale(struct libps_system* ps,
+                                   const unsigned int scale)
+{
+    assert(ps != NULL);
+    libps_gpu_set_scale(&ps->bus.gpu, scale);
+}
+
+// Sets whether or not GP0 commands are executed on a dedicated thread,
+// overlapping drawing with the rest of the emulation.
+void libps_system_set_gpu_thread(struct libps_system* ps, const bool enabled)
+{
+    assert(ps != NULL);
+    libps_gpu_set_threaded(&ps->bus.gpu, enabled);
+}
@@ -17,59 +17,546 @@
 #include <string.h>
 #include "cpu_defs.h"
 #include "rcnt.h"
+#include "scheduler.h"
 #include "utility/memory.h"
 
+// Counter mode bits
+#define MODE_SYNC_ENABLE (1 << 0)
+#define MODE_RESET_ON_TARGET (1 << 3)
+#define MODE_IRQ_ON_TARGET (1 << 4)
+#define MODE_IRQ_ON_OVERFLOW (1 << 5)
+#define MODE_IRQ_REPEAT (1 << 6)
+#define MODE_IRQ_TOGGLE (1 << 7)
+#define MODE_IRQ_NOT_REQUESTED (1 << 10)
+#define MODE_REACHED_TARGET (1 << 11)
+#define MODE_REACHED_OVERFLOW (1 << 12)
+
+// Returned by `ticks_until()` when a value can never be reached.
+#define NEVER UINT64_MAX
+
+// The GPU clock is the system clock * 11 / 7. With the default 320 pixel
+// wide NTSC display, one dot is 8 GPU clocks and one scanline is 3413 GPU
+// clocks; the GPU reports the real values through
+// `libps_rcnt_set_video_timing()`.
+#define GPU_CLOCK_NUM 11
+#define GPU_CLOCK_DEN 7
+
+#define DEFAULT_DOTCLOCK_DIVIDER 8
+#define DEFAULT_SCANLINE_CLOCKS 3413
+
+static const enum libps_event_id rcnt_events[3] =
+{
+    LIBPS_EVENT_RCNT0,
+    LIBPS_EVENT_RCNT1,
+    LIBPS_EVENT_RCNT2
+};
+
+// Returns `true` if the counter wraps to 0 after reaching its target from its
+// current value, or `false` if it has to count up to 0xFFFF first.
+static bool wraps_at_target(const struct rcnt_spec* rcnt)
+{
+    return (rcnt->mode & MODE_RESET_ON_TARGET) &&
+           (rcnt->value <= rcnt->target);
+}
+
+// Returns the number of ticks from now until the counter equals `x`, or
+// `NEVER` if it will never do so.
+static uint64_t ticks_until(const struct rcnt_spec* rcnt, const uint32_t x)
+{
+    const bool reset = rcnt->mode & MODE_RESET_ON_TARGET;
+
+    if (wraps_at_target(rcnt))
+    {
+        if (x > rcnt->target)
+        {
+            return NEVER;
+        }
+
+        const uint64_t period = rcnt->target + 1;
+        const uint64_t ticks  = (x + period - rcnt->value) % period;
+
+        return ticks ? ticks : period;
+    }
+
+    if (x > rcnt->value)
+    {
+        return x - rcnt->value;
+    }
+
+    // The counter has to pass 0xFFFF and wrap to 0 first.
+    if (reset && (x > rcnt->target))
+    {
+        return NEVER;
+    }
+    return (0x10000 - rcnt->value) + x;
+}
+
+// Advances the counter by `ticks`, latching the "reached" flags and recording
+// an interrupt if the corresponding condition occurred along the way.
+static void advance(struct rcnt_spec* rcnt, const uint64_t ticks)
+{
+    if (ticks == 0)
+    {
+        return;
+    }
+
+    const bool hit_target   = ticks_until(rcnt, rcnt->target) <= ticks;
+    const bool hit_overflow = ticks_until(rcnt, 0xFFFF)       <= ticks;
+
+    if (wraps_at_target(rcnt))
+    {
+        rcnt->value = (rcnt->value + ticks) % (rcnt->target + 1);
+    }
+    else if (rcnt->value + ticks <= 0xFFFF)
+    {
+        rcnt->value += (uint32_t)ticks;
+    }
+    else
+    {
+        // Number of ticks spent after wrapping to 0
+        const uint64_t after_wrap = ticks - (0x10000 - rcnt->value);
+
+        rcnt->value = (rcnt->mode & MODE_RESET_ON_TARGET) ?
+                      after_wrap % (rcnt->target + 1) :
+                      after_wrap & 0xFFFF;
+    }
+
+    if (hit_target)
+    {
+        rcnt->mode |= MODE_REACHED_TARGET;
+    }
+
+    if (hit_overflow)
+    {
+        rcnt->mode |= MODE_REACHED_OVERFLOW;
+    }
+
+    if ((hit_target   && (rcnt->mode & MODE_IRQ_ON_TARGET)) ||
+        (hit_overflow && (rcnt->mode & MODE_IRQ_ON_OVERFLOW)))
+    {
+        if ((rcnt->mode & MODE_IRQ_REPEAT) || !rcnt->irq_fired)
+        {
+            rcnt->irq_fired = true;
+
+            if (rcnt->mode & MODE_IRQ_TOGGLE)
+            {
+                // The request is only made on the 1->0 transition.
+                rcnt->mode ^= MODE_IRQ_NOT_REQUESTED;
+
+                if (!(rcnt->mode & MODE_IRQ_NOT_REQUESTED))
+                {
+                    rcnt->irq_pending = true;
+                }
+            }
+            else
+            {
+                // Pulse mode: bit 10 drops for a few cycles only, which is
+                // never observable here.
+                rcnt->irq_pending = true;
+            }
+        }
+    }
+}
+
+// Brings the counter specified by `rcnt_id` up to date with the system clock.
+static void sync(struct libps_rcnt* rcnt, const unsigned int rcnt_id)
+{
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+    const uint64_t now = rcnt->scheduler->cycles;
+
+    if (spec->rate_num != 0)
+    {
+        const uint64_t total =
+        ((now - spec->timestamp) * spec->rate_num) + spec->remainder;
+
+        spec->remainder = total % spec->rate_den;
+        advance(spec, total / spec->rate_den);
+    }
+    spec->timestamp = now;
+}
+
+// Returns `true` if the synchronization mode of the counter specified by
+// `rcnt_id` currently holds it paused.
+static bool sync_paused(const struct libps_rcnt* rcnt,
+                        const unsigned int rcnt_id)
+{
+    const struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+
+    if (!(spec->mode & MODE_SYNC_ENABLE))
+    {
+        return false;
+    }
+
+    const unsigned int sync_mode = (spec->mode >> 1) & 0x03;
+
+    if (rcnt_id == 2)
+    {
+        // Synchronization modes 0 and 3 stop the counter; 1 and 2 are free
+        // run.
+        return (sync_mode == 0) || (sync_mode == 3);
+    }
+
+    switch (sync_mode)
+    {
+        // Pause counter during blanking
+        case 0:
+            return spec->in_blank;
+
+        // Reset counter to 0 at blanking (never paused)
+        case 1:
+            return false;
+
+        // Reset counter to 0 at blanking and pause outside of blanking
+        case 2:
+            return !spec->in_blank;
+
+        // Pause until blanking occurs once, then switch to free run
+        default:
+            return !spec->blank_seen;
+    }
+}
+
+// Determines the rate of the counter specified by `rcnt_id` from its clock
+// source and synchronization mode.
+static void update_rate(struct libps_rcnt* rcnt, const unsigned int rcnt_id)
+{
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+    const unsigned int source = (spec->mode >> 8) & 0x03;
+
+    const uint32_t old_den = spec->rate_den;
+
+    // System clock unless stated otherwise
+    spec->rate_num = 1;
+    spec->rate_den = 1;
+
+    switch (rcnt_id)
+    {
+        case 0:
+            // 1 or 3 = Dotclock
+            if (source & 1)
+            {
+                spec->rate_num = rcnt->dotclock_num;
+                spec->rate_den = rcnt->dotclock_den;
+            }
+            break;
+
+        case 1:
+            // 1 or 3 = Hblank
+            if (source & 1)
+            {
+                spec->rate_num = rcnt->hblank_num;
+                spec->rate_den = rcnt->hblank_den;
+            }
+            break;
+
+        case 2:
+            // 2 or 3 = System Clock/8
+            if (source & 2)
+            {
+                spec->rate_den = 8;
+            }
+            break;
+    }
+
+    if (sync_paused(rcnt, rcnt_id))
+    {
+        spec->rate_num = 0;
+    }
+
+    // The fraction of a tick carried over is kept across pauses (such as
+    // every blanking period for some synchronization modes), but it is
+    // meaningless in units of another rate.
+    if (spec->rate_den != old_den)
+    {
+        spec->remainder = 0;
+    }
+}
+
+// (Re)schedules the interrupt event of the counter specified by `rcnt_id`.
+// This must be called whenever anything affecting the next interrupt changes,
+// after the counter has been brought up to date.
+static void schedule(struct libps_rcnt* rcnt, const unsigned int rcnt_id)
+{
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+    const enum libps_event_id event = rcnt_events[rcnt_id];
+
+    if (spec->irq_pending)
+    {
+        libps_scheduler_schedule(rcnt->scheduler,
+                                 event,
+                                 rcnt->scheduler->cycles);
+        return;
+    }
+
+    if ((spec->rate_num == 0) ||
+        (!(spec->mode & MODE_IRQ_REPEAT) && spec->irq_fired))
+    {
+        libps_scheduler_cancel(rcnt->scheduler, event);
+        return;
+    }
+
+    uint64_t ticks = NEVER;
+
+    if (spec->mode & MODE_IRQ_ON_TARGET)
+    {
+        ticks = ticks_until(spec, spec->target);
+    }
+
+    if (spec->mode & MODE_IRQ_ON_OVERFLOW)
+    {
+        const uint64_t overflow_ticks = ticks_until(spec, 0xFFFF);
+
+        if (overflow_ticks < ticks)
+        {
+            ticks = overflow_ticks;
+        }
+    }
+
+    if (ticks == NEVER)
+    {
+        libps_scheduler_cancel(rcnt->scheduler, event);
+        return;
+    }
+
+    // Smallest number of cycles after which at least `ticks` whole ticks
+    // have accumulated.
+    const uint64_t needed = (ticks * spec->rate_den) - spec->remainder;
+    const uint64_t cycles = (needed + spec->rate_num - 1) / spec->rate_num;
+
+    libps_scheduler_schedule(rcnt->scheduler,
+                             event,
+                             spec->timestamp + cycles);
+}
+
+// Initializes the root counters. `scheduler` provides the system clock and
+// cannot be `NULL`.
+void libps_rcnt_setup(struct libps_rcnt* rcnt,
+                      struct libps_scheduler* scheduler)
+{
+    assert(rcnt != NULL);
+    assert(scheduler != NULL);
+
+    rcnt->scheduler = scheduler;
+}
+
 // Resets the root counters to their initial state.
 void libps_rcnt_reset(struct libps_rcnt* rcnt)
 {
     assert(rcnt != NULL);
     memset(rcnt->rcnts, 0, sizeof(rcnt->rcnts));
+
+    rcnt->dotclock_num = GPU_CLOCK_NUM;
+    rcnt->dotclock_den = GPU_CLOCK_DEN * DEFAULT_DOTCLOCK_DIVIDER;
+    rcnt->hblank_num   = GPU_CLOCK_NUM;
+    rcnt->hblank_den   = GPU_CLOCK_DEN * DEFAULT_SCANLINE_CLOCKS;
+
+    for (unsigned int rcnt_id = 0; rcnt_id < 3; ++rcnt_id)
+    {
+        rcnt->rcnts[rcnt_id].timestamp = rcnt->scheduler->cycles;
+        update_rate(rcnt, rcnt_id);
+
+        libps_scheduler_cancel(rcnt->scheduler, rcnt_events[rcnt_id]);
+    }
 }
 
-// Adjusts the clock source of the timer specified by `rcnt_id` and resets
-// the value for said timer.
-void libps_rcnt_set_mode(struct libps_rcnt* rcnt,
-                         const unsigned int rcnt_id,
-                         const uint32_t mode)
+// Loads root counter register `reg`, which is the offset from 0x1F801100.
+uint16_t libps_rcnt_register_load(struct libps_rcnt* rcnt,
+                                  const unsigned int reg)
 {
     assert(rcnt != NULL);
-    assert(rcnt_id < 3);
 
-    rcnt->rcnts[rcnt_id].mode = mode;
+    const unsigned int rcnt_id = (reg >> 4) & 0x03;
 
-    switch (rcnt_id)
+    if (rcnt_id > 2)
     {
-        case 2:
-            switch (rcnt->rcnts[rcnt_id].mode & 0x300)
-            {
-                // 2 or 3 = System Clock/8
-                case 0x200:
-                    rcnt->rcnts[2].threshold = 8;
-                    break;
-
-                default:
-                    rcnt->rcnts[2].threshold = 1;
-                    break;
-            }
+        return 0x0000;
+    }
+
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+
+    switch (reg & 0x0C)
+    {
+        // 1F801100h+N*10h - Timer 0..2 Current Counter Value (R/W)
+        case 0x00:
+            sync(rcnt, rcnt_id);
+            return spec->value;
+
+        // 1F801104h+N*10h - Timer 0..2 Counter Mode (R/W)
+        case 0x04:
+        {
+            sync(rcnt, rcnt_id);
+
+            const uint16_t mode = spec->mode;
+
+            // Bits 11 and 12 are reset after reading.
+            spec->mode &= ~(MODE_REACHED_TARGET | MODE_REACHED_OVERFLOW);
+            return mode;
+        }
+
+        // 1F801108h+N*10h - Timer 0..2 Counter Target Value (R/W)
+        case 0x08:
+            return spec->target;
+
+        default:
+            return 0x0000;
+    }
+}
+
+// Stores `data` into root counter register `reg`, which is the offset from
+// 0x1F801100.
+void libps_rcnt_register_store(struct libps_rcnt* rcnt,
+                               const unsigned int reg,
+                               const uint16_t data)
+{
+    assert(rcnt != NULL);
+
+    const unsigned int rcnt_id = (reg >> 4) & 0x03;
+
+    if (rcnt_id > 2)
+    {
+        return;
+    }
+
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+
+    sync(rcnt, rcnt_id);
+
+    switch (reg & 0x0C)
+    {
+        // 1F801100h+N*10h - Timer 0..2 Current Counter Value (R/W)
+        case 0x00:
+            spec->value     = data;
+            spec->remainder = 0;
+
+            break;
+
+        // 1F801104h+N*10h - Timer 0..2 Counter Mode (R/W)
+        //
+        // Writing the mode resets the counter and sets bit 10.
+        case 0x04:
+            spec->mode = (spec->mode & (MODE_REACHED_TARGET |
+                                        MODE_REACHED_OVERFLOW)) |
+                         (data & 0x03FF) |
+                         MODE_IRQ_NOT_REQUESTED;
+
+            spec->value       = 0x0000;
+            spec->remainder   = 0;
+            spec->irq_fired   = false;
+            spec->irq_pending = false;
+            spec->blank_seen  = false;
+
+            update_rate(rcnt, rcnt_id);
             break;
+
+        // 1F801108h+N*10h - Timer 0..2 Counter Target Value (R/W)
+        case 0x08:
+            spec->target = data;
+            break;
+
+        default:
+            return;
     }
+    schedule(rcnt, rcnt_id);
+}
 
-    rcnt->rcnts[rcnt_id].counter = 0;
-    rcnt->rcnts[rcnt_id].value = 0x0000;
+// Called by the scheduler when the event of the timer specified by `rcnt_id`
+// fires. Returns `true` if the timer's interrupt should be raised.
+bool libps_rcnt_process_event(struct libps_rcnt* rcnt,
+                              const unsigned int rcnt_id)
+{
+    assert(rcnt != NULL);
+    assert(rcnt_id < 3);
+
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+
+    sync(rcnt, rcnt_id);
+
+    const bool raise = spec->irq_pending;
+    spec->irq_pending = false;
+
+    schedule(rcnt, rcnt_id);
+    return raise;
 }
 
-// Steps the root counters.
-void libps_rcnt_step(struct libps_rcnt* rcnt)
+// Handles the start or end of the blanking period timer `rcnt_id` can
+// synchronize to.
+static void blank(struct libps_rcnt* rcnt,
+                  const unsigned int rcnt_id,
+                  const bool active)
+{
+    struct rcnt_spec* spec = &rcnt->rcnts[rcnt_id];
+
+    if (!(spec->mode & MODE_SYNC_ENABLE))
+    {
+        spec->in_blank = active;
+        return;
+    }
+
+    sync(rcnt, rcnt_id);
+
+    spec->in_blank = active;
+
+    if (active)
+    {
+        const unsigned int sync_mode = (spec->mode >> 1) & 0x03;
+
+        // Modes 1 and 2 reset the counter at the start of blanking.
+        if (sync_mode == 1 || sync_mode == 2)
+        {
+            spec->value     = 0x0000;
+            spec->remainder = 0;
+        }
+        spec->blank_seen = true;
+    }
+
+    update_rate(rcnt, rcnt_id);
+    schedule(rcnt, rcnt_id);
+}
+
+// Sets the dotclock and horizontal blank rates from the GPU's video timing.
+// `dotclock_divider` is the number of GPU clocks per dot and
+// `scanline_clocks` is the number of GPU clocks per scanline.
+void libps_rcnt_set_video_timing(struct libps_rcnt* rcnt,
+                                 const unsigned int dotclock_divider,
+                                 const unsigned int scanline_clocks)
 {
     assert(rcnt != NULL);
 
-    if (rcnt->rcnts[2].counter == rcnt->rcnts[2].threshold)
+    const uint32_t dotclock_den = GPU_CLOCK_DEN * dotclock_divider;
+    const uint32_t hblank_den   = GPU_CLOCK_DEN * scanline_clocks;
+
+    if ((dotclock_den == rcnt->dotclock_den) &&
+        (hblank_den   == rcnt->hblank_den))
     {
-        rcnt->rcnts[2].value++;
-        rcnt->rcnts[2].counter = 0;
+        return;
     }
-    else
+
+    // Bring the counters clocked by the old rates up to date first.
+    sync(rcnt, 0);
+    sync(rcnt, 1);
+
+    rcnt->dotclock_den = dotclock_den;
+    rcnt->hblank_den   = hblank_den;
+
+    for (unsigned int rcnt_id = 0; rcnt_id < 2; ++rcnt_id)
     {
-        rcnt->rcnts[2].counter++;
+        update_rate(rcnt, rcnt_id);
+        schedule(rcnt, rcnt_id);
     }
-}
\ No newline at end of file
+}
+
+// Notifies the root counters that horizontal blanking has started (`active`
+// is `true`) or ended.
+void libps_rcnt_hblank(struct libps_rcnt* rcnt, const bool active)
+{
+    assert(rcnt != NULL);
+    blank(rcnt, 0, active);
+}
+
+// Notifies the root counters that vertical blanking has started (`active` is
+// `true`) or ended.
+void libps_rcnt_vblank(struct libps_rcnt* rcnt, const bool active)
+{
+    assert(rcnt != NULL);
+    blank(rcnt, 1, active);
+}
@@ -0,0 +1,92 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Renderer which draws nothing, for runs where only the emulated logic
+// matters. Drawing commands are still parsed, timed and counted by the GPU,
+// and everything which reaches VRAM without being rasterized (fills, copies
+// and transfers) is still done, since games read it back.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "gpu.h"
+#include "sw_vram.h"
+
+static void draw_polygon(struct libps_gpu* gpu,
+                         const struct libps_gpu_vertex* const v0,
+                         struct libps_gpu_vertex* const v1,
+                         struct libps_gpu_vertex* const v2)
+{
+    assert(gpu != NULL);
+    assert(v0 != NULL);
+    assert(v1 != NULL);
+    assert(v2 != NULL);
+
+    (void)gpu;
+    (void)v0;
+    (void)v1;
+    (void)v2;
+}
+
+static void draw_quad(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertices)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    (void)gpu;
+    (void)vertices;
+}
+
+static void draw_rect(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertex,
+                      const unsigned int width,
+                      const unsigned int height)
+{
+    assert(gpu != NULL);
+    assert(vertex != NULL);
+
+    (void)gpu;
+    (void)vertex;
+    (void)width;
+    (void)height;
+}
+
+static void draw_line(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertices,
+                      const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    (void)gpu;
+    (void)vertices;
+    (void)count;
+}
+
+// Renderer which draws nothing. Fills, copies and transfers still go through
+// VRAM, so GPUREAD and the CPU see the same data as with any other renderer,
+// but the display only shows what those wrote.
+const struct libps_gpu_renderer libps_renderer_null =
+{
+    .draw_polygon = &draw_polygon,
+    .draw_quad    = &draw_quad,
+    .draw_rect    = &draw_rect,
+    .draw_line    = &draw_line,
+    .fill_rect    = &libps_renderer_sw_vram_fill,
+    .copy_rect    = &libps_renderer_sw_vram_copy,
+    .store_rect   = &libps_renderer_sw_vram_store,
+    .sync         = NULL,
+    .scanout      = &libps_renderer_sw_vram_scanout,
+    .cleanup      = NULL
+};
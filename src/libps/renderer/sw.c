@@ -13,174 +13,1248 @@
 // CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 
 #include <assert.h>
+#include <stdlib.h>
 #include "gpu.h"
 #include "sw.h"
+#include "sw_span.h"
+#include "sw_texture.h"
+#include "sw_vram.h"
+#include "../utility/host_cpu.h"
+#include "../utility/math.h"
 
-// XXX: This should probably be a helper function.
-static uint16_t process_pixel_through_clut(struct libps_gpu* gpu,
-                                           const unsigned int x,
-                                           const uint16_t texel,
-                                           const unsigned int texpage_color_depth,
-                                           const uint16_t clut)
+// Rows of triangles at least this many pixels wide are only drawn where they
+// are covered, see `draw_triangle_row()`.
+#define NARROW_SPAN_PIXELS 64
+
+// Span and row function tables selected by `libps_renderer_sw_setup()`
+static const libps_renderer_sw_span_fn* spans;
+static const libps_renderer_sw_row_fn* rows;
+
+// Returns twice the signed area of the triangle (`a`, `b`, `p`). This is
+// positive if `p` lies to the right of the edge going from `a` to `b` (as seen
+// on screen, where Y points down).
+static int32_t edge_function(const int32_t ax, const int32_t ay,
+                             const int32_t bx, const int32_t by,
+                             const int32_t px, const int32_t py)
 {
-    assert(gpu != NULL);
+    return ((bx - ax) * (py - ay)) - ((by - ay) * (px - ax));
+}
 
-    const unsigned int clut_x = (clut & 0x3F) * 16;
-    const unsigned int clut_y = (clut >> 6) & 0x1FF;
+// Returns `true` if the edge going from `a` to `b` is a top or left edge of a
+// triangle with a positive area. Pixels exactly on any other edge belong to
+// the neighbouring triangle, which is how the GPU avoids drawing shared edges
+// twice.
+static bool is_top_left(const int32_t ax, const int32_t ay,
+                        const int32_t bx, const int32_t by)
+{
+    return ((ay == by) && (bx > ax)) || (by < ay);
+}
 
-    switch (texpage_color_depth)
+// Narrows the pixels `*first` to `*last` of a row to those where an edge
+// function, which is `w` at pixel 0 of the row and changes by `dx` per pixel,
+// is not negative. The range is empty afterwards if `*first` > `*last`.
+static void cover_edge(const int32_t w,
+                       const int32_t dx,
+                       int32_t* const first,
+                       int32_t* const last)
+{
+    if (dx > 0)
     {
-        case 4:
+        if (w < 0)
         {
-            const unsigned int offset = (texel >> (x & 3) * 4) & 0xF;
-            return gpu->vram[(clut_x + offset) + (LIBPS_GPU_VRAM_WIDTH * clut_y)];
+            *first = LIBPS_MAX(*first, ((dx - 1) - w) / dx);
         }
+    }
+    else if (w < 0)
+    {
+        *last = -1;
+    }
+    else if (dx < 0)
+    {
+        *last = LIBPS_MIN(*last, w / -dx);
+    }
+}
 
-        case 16:
-            return texel;
-
-        default:
-            return 0xFFFF;
+// Adds the number of the `count` pixels at `pixels` which have their mask bit
+// set to `*masked`.
+static void count_masked(const uint16_t* const pixels,
+                         const int32_t count,
+                         uint64_t* const masked)
+{
+    for (int32_t i = 0; i < count; ++i)
+    {
+        *masked += pixels[i] >> 15;
     }
 }
 
-static float edge_function(const struct libps_gpu_vertex* const v0,
+// A triangle relative to the drawing offset, wound so that its area is
+// positive
+struct triangle
+{
+    const struct libps_gpu_vertex* a;
+    const struct libps_gpu_vertex* b;
+    const struct libps_gpu_vertex* c;
+
+    int32_t ax, ay;
+    int32_t bx, by;
+    int32_t cx, cy;
+
+    // Twice the area
+    int32_t area;
+
+    // Bounding box, inclusive
+    int32_t min_x, min_y;
+    int32_t max_x, max_y;
+
+    // Added to the edge functions so that pixels exactly on the edges which
+    // aren't top or left edges are outside, see `is_top_left()`.
+    int32_t bias0, bias1, bias2;
+};
+
+// Fills `triangle` with the triangle (`v0`, `v1`, `v2`) drawn with drawing
+// state `state`. Returns `false` if the GPU draws no pixels of it at all.
+static bool setup_triangle(const struct libps_renderer_sw_state* const state,
+                           const struct libps_gpu_vertex* const v0,
                            const struct libps_gpu_vertex* const v1,
-                           const struct libps_gpu_vertex* const v2)
+                           const struct libps_gpu_vertex* const v2,
+                           struct triangle* const triangle)
 {
-    return ((v1->x - v0->x) * (v2->y - v0->y)) -
-           ((v1->y - v0->y) * (v2->x - v0->x));
+    // https://fgiesen.wordpress.com/2013/02/08/triangle-rasterization-in-practice/
+    struct triangle t =
+    {
+        .a  = v0,
+        .b  = v1,
+        .c  = v2,
+
+        // Vertices are relative to the drawing offset.
+        .ax = v0->x + state->offset_x,
+        .ay = v0->y + state->offset_y,
+        .bx = v1->x + state->offset_x,
+        .by = v1->y + state->offset_y,
+        .cx = v2->x + state->offset_x,
+        .cy = v2->y + state->offset_y
+    };
+
+    t.area = edge_function(t.ax, t.ay, t.bx, t.by, t.cx, t.cy);
+
+    // Degenerate triangles cover no pixels.
+    if (t.area == 0)
+    {
+        return false;
+    }
+
+    // Wind the triangle so that its area is positive.
+    if (t.area < 0)
+    {
+        const struct libps_gpu_vertex* const tmp = t.b;
+        t.b = t.c;
+        t.c = tmp;
+
+        int32_t swap;
+
+        swap = t.bx; t.bx = t.cx; t.cx = swap;
+        swap = t.by; t.by = t.cy; t.cy = swap;
+
+        t.area = -t.area;
+    }
+
+    // The GPU skips polygons spanning more than 1023x511 pixels.
+    t.min_x = LIBPS_MIN(t.ax, LIBPS_MIN(t.bx, t.cx));
+    t.max_x = LIBPS_MAX(t.ax, LIBPS_MAX(t.bx, t.cx));
+    t.min_y = LIBPS_MIN(t.ay, LIBPS_MIN(t.by, t.cy));
+    t.max_y = LIBPS_MAX(t.ay, LIBPS_MAX(t.by, t.cy));
+
+    if (((t.max_x - t.min_x) >= LIBPS_GPU_VRAM_WIDTH) ||
+        ((t.max_y - t.min_y) >= LIBPS_GPU_VRAM_HEIGHT))
+    {
+        return false;
+    }
+
+    t.bias0 = is_top_left(t.bx, t.by, t.cx, t.cy) ? 0 : -1;
+    t.bias1 = is_top_left(t.cx, t.cy, t.ax, t.ay) ? 0 : -1;
+    t.bias2 = is_top_left(t.ax, t.ay, t.bx, t.by) ? 0 : -1;
+
+    *triangle = t;
+    return true;
 }
 
-void libps_renderer_sw_draw_polygon(struct libps_gpu* gpu,
-                                    const struct libps_gpu_vertex* const v0,
-                                    struct libps_gpu_vertex* const v1,
-                                    struct libps_gpu_vertex* const v2)
+// Returns the 16.16 fixed-point gradient of an attribute which is `a`, `b`
+// and `c` at the respective vertices, along the axis whose edge function
+// steps are `d0`, `d1` and `d2`.
+static uint32_t gradient(const int32_t a,
+                         const int32_t b,
+                         const int32_t c,
+                         const int32_t d0,
+                         const int32_t d1,
+                         const int32_t d2,
+                         const int32_t area)
+{
+    const int64_t sum = ((int64_t)d0 * a) + ((int64_t)d1 * b) +
+                        ((int64_t)d2 * c);
+
+    return (uint32_t)((sum * 65536) / area);
+}
+
+// Returns the value of an attribute which is `a`, `b` and `c` at the
+// respective vertices, at the point whose unbiased edge functions are `l0`,
+// `l1` and `l2`. The result is in 16.16 fixed point and rounded.
+static uint32_t interpolate(const int32_t a,
+                            const int32_t b,
+                            const int32_t c,
+                            const int32_t l0,
+                            const int32_t l1,
+                            const int32_t l2,
+                            const int32_t area)
+{
+    const int64_t sum = ((int64_t)l0 * a) + ((int64_t)l1 * b) +
+                        ((int64_t)l2 * c);
+
+    return (uint32_t)((sum * 65536) / area) + 0x8000;
+}
+
+// Selects the fastest span and row functions the host CPU supports. This must
+// be called before anything is drawn.
+void libps_renderer_sw_setup(void)
+{
+    spans = libps_renderer_sw_spans_scalar;
+    rows  = libps_renderer_sw_rows_scalar;
+
+#ifdef LIBPS_HOST_X86_64
+    if (libps_host_cpu_has_sse2())
+    {
+        rows = libps_renderer_sw_rows_sse2;
+    }
+
+    if (libps_host_cpu_has_avx2())
+    {
+        spans = libps_renderer_sw_spans_avx2;
+    }
+    else if (libps_host_cpu_has_sse2())
+    {
+        spans = libps_renderer_sw_spans_sse2;
+    }
+#endif // LIBPS_HOST_X86_64
+}
+
+// Fills `state` with the current drawing state of `gpu`. The clip rectangle
+// is the drawing area.
+void libps_renderer_sw_get_state(const struct libps_gpu* gpu,
+                                 struct libps_renderer_sw_state* state)
 {
     assert(gpu != NULL);
+    assert(state != NULL);
+
+    state->vram     = gpu->vram;
+    state->scale    = 1;
+    state->clip_x1  = gpu->drawing_area.x1;
+    state->clip_y1  = gpu->drawing_area.y1;
+    state->clip_x2  = gpu->drawing_area.x2;
+    state->clip_y2  = gpu->drawing_area.y2;
+    state->offset_x = gpu->drawing_offset_x;
+    state->offset_y = gpu->drawing_offset_y;
+    state->flags    = gpu->cmd_packet.flags;
+    state->texture  = NULL;
+
+    state->masked_pixels = NULL;
+
+    state->blend_mode = (gpu->draw_mode >> 5) & 0x03;
+    state->mask_set   = (gpu->mask_settings & 0x01) ? 0x8000 : 0x0000;
+    state->mask_check = (gpu->mask_settings & 0x02) ? 0x8000 : 0x0000;
+
+    // The texture window mask and offset are in 8 texel steps.
+    const unsigned int mask_u   = gpu->texture_window & 0x1F;
+    const unsigned int mask_v   = (gpu->texture_window >> 5) & 0x1F;
+    const unsigned int offset_u = (gpu->texture_window >> 10) & 0x1F;
+    const unsigned int offset_v = (gpu->texture_window >> 15) & 0x1F;
+
+    state->window_u_and = (uint8_t)~(mask_u * 8);
+    state->window_u_or  = (uint8_t)((offset_u & mask_u) * 8);
+    state->window_v_and = (uint8_t)~(mask_v * 8);
+    state->window_v_or  = (uint8_t)((offset_v & mask_v) * 8);
+
+    state->flip_x = gpu->draw_mode & 0x1000;
+    state->flip_y = gpu->draw_mode & 0x2000;
+}
+
+// Fills `upscaled` with `state` changed to draw into the upscaled VRAM of
+// `gpu`. `state` must draw into VRAM itself. Returns `false` if `gpu` isn't
+// upscaling.
+bool
+libps_renderer_sw_upscale_state(const struct libps_gpu* gpu,
+                                const struct libps_renderer_sw_state* state,
+                                struct libps_renderer_sw_state* upscaled)
+{
+    assert(gpu != NULL);
+    assert(state != NULL);
+    assert(upscaled != NULL);
+    assert(state->scale == 1);
+
+    if (gpu->scale == 1)
+    {
+        return false;
+    }
+
+    const int32_t scale = (int32_t)gpu->scale;
+
+    *upscaled = *state;
+
+    upscaled->vram  = gpu->upscaled_vram;
+    upscaled->scale = gpu->scale;
+
+    // Pixels are only counted once, at the native resolution.
+    upscaled->masked_pixels = NULL;
+
+    // Each pixel of the clip rectangle becomes a block of pixels.
+    upscaled->clip_x1 = state->clip_x1 * scale;
+    upscaled->clip_y1 = state->clip_y1 * scale;
+    upscaled->clip_x2 = (state->clip_x2 * scale) + (scale - 1);
+    upscaled->clip_y2 = (state->clip_y2 * scale) + (scale - 1);
+
+    return true;
+}
+
+// A triangle being drawn a row at a time, see `setup_triangle_rows()`
+struct triangle_rows
+{
+    // Span of the row `y`, across the whole visited part of the bounding box
+    struct libps_renderer_sw_span span;
+
+    // The visited part of the bounding box, which is inside of the clip
+    // rectangle, and the row about to be drawn
+    int32_t x_start;
+    int32_t y_start;
+    int32_t y_end;
+    int32_t y;
+
+    // How much the edge functions and attributes change by per row
+    int32_t w0_dy, w1_dy, w2_dy;
+    uint32_t r_dy, g_dy, b_dy;
+    uint32_t u_dy, v_dy;
+};
+
+// Sets up `rows` to draw the triangle (`v0`, `v1`, `v2`) with drawing state
+// `state`, starting from the top row. Returns `false` if no pixels of it are
+// drawn.
+static bool setup_triangle_rows(const struct libps_renderer_sw_state* state,
+                                const struct libps_gpu_vertex* const v0,
+                                const struct libps_gpu_vertex* const v1,
+                                const struct libps_gpu_vertex* const v2,
+                                struct triangle_rows* const rows)
+{
+    struct triangle t;
+
+    if (!setup_triangle(state, v0, v1, v2, &t))
+    {
+        return false;
+    }
+
+    const struct libps_gpu_vertex* const a = t.a;
+    const struct libps_gpu_vertex* const b = t.b;
+    const struct libps_gpu_vertex* const c = t.c;
+
+    // Upscaled triangles are rasterized at the higher resolution, so that
+    // every pixel gets its own colour and texture coordinate.
+    const int32_t scale = (int32_t)state->scale;
+
+    const int32_t ax = t.ax * scale;
+    const int32_t ay = t.ay * scale;
+    const int32_t bx = t.bx * scale;
+    const int32_t by = t.by * scale;
+    const int32_t cx = t.cx * scale;
+    const int32_t cy = t.cy * scale;
+
+    const int32_t area = t.area * scale * scale;
+
+    const int32_t box_x1 = t.min_x * scale;
+    const int32_t box_y1 = t.min_y * scale;
+
+    // Only the part of the bounding box inside the clip rectangle is visited.
+    const int32_t x_start = LIBPS_MAX(box_x1, state->clip_x1);
+    const int32_t x_end   = LIBPS_MIN(t.max_x * scale, state->clip_x2);
+    const int32_t y_start = LIBPS_MAX(box_y1, state->clip_y1);
+    const int32_t y_end   = LIBPS_MIN(t.max_y * scale, state->clip_y2);
+
+    if ((x_start > x_end) || (y_start > y_end))
+    {
+        return false;
+    }
+
+    // How much each edge function changes by per pixel stepped in X and Y.
+    const int32_t w0_dx = by - cy;
+    const int32_t w0_dy = cx - bx;
+    const int32_t w1_dx = cy - ay;
+    const int32_t w1_dy = ax - cx;
+    const int32_t w2_dx = ay - by;
+    const int32_t w2_dy = bx - ax;
+
+    const int32_t l0 = edge_function(bx, by, cx, cy, x_start, y_start);
+    const int32_t l1 = edge_function(cx, cy, ax, ay, x_start, y_start);
+    const int32_t l2 = edge_function(ax, ay, bx, by, x_start, y_start);
+
+    // Every attribute is a plane across the triangle, so it can be stepped
+    // just like the edge functions. Attributes are evaluated at the corner of
+    // the unclipped bounding box and stepped to the first pixel from there,
+    // so that the value of a pixel doesn't depend on the clip rectangle.
+    const int32_t o0 = edge_function(bx, by, cx, cy, box_x1, box_y1);
+    const int32_t o1 = edge_function(cx, cy, ax, ay, box_x1, box_y1);
+    const int32_t o2 = edge_function(ax, ay, bx, by, box_x1, box_y1);
+
+    const uint32_t skip_x = (uint32_t)(x_start - box_x1);
+    const uint32_t skip_y = (uint32_t)(y_start - box_y1);
+
+    struct libps_renderer_sw_span* const span = &rows->span;
+
+#define SETUP_ATTRIBUTE(name, va, vb, vc)                                    \
+    span->name##_dx = gradient(va, vb, vc, w0_dx, w1_dx, w2_dx, area);       \
+    rows->name##_dy = gradient(va, vb, vc, w0_dy, w1_dy, w2_dy, area);       \
+    span->name      = interpolate(va, vb, vc, o0, o1, o2, area) +            \
+                      (span->name##_dx * skip_x) + (rows->name##_dy * skip_y);
+
+    span->count = (unsigned int)(x_end - x_start) + 1;
+    span->w0    = l0 + t.bias0;
+    span->w1    = l1 + t.bias1;
+    span->w2    = l2 + t.bias2;
+    span->w0_dx = w0_dx;
+    span->w1_dx = w1_dx;
+    span->w2_dx = w2_dx;
+
+    SETUP_ATTRIBUTE(r, a->color & 0xFF,
+                       b->color & 0xFF,
+                       c->color & 0xFF)
+
+    SETUP_ATTRIBUTE(g, (a->color >> 8) & 0xFF,
+                       (b->color >> 8) & 0xFF,
+                       (c->color >> 8) & 0xFF)
+
+    SETUP_ATTRIBUTE(b, (a->color >> 16) & 0xFF,
+                       (b->color >> 16) & 0xFF,
+                       (c->color >> 16) & 0xFF)
+
+    SETUP_ATTRIBUTE(u, a->texcoord & 0xFF,
+                       b->texcoord & 0xFF,
+                       c->texcoord & 0xFF)
+
+    SETUP_ATTRIBUTE(v, a->texcoord >> 8,
+                       b->texcoord >> 8,
+                       c->texcoord >> 8)
+
+#undef SETUP_ATTRIBUTE
+
+    span->texture  = state->texture;
+    span->mask_set = state->mask_set;
+
+    span->window_u_and = state->window_u_and;
+    span->window_v_and = state->window_v_and;
+    span->window_or    = state->window_u_or | (state->window_v_or << 8);
+
+    rows->x_start = x_start;
+    rows->y_start = y_start;
+    rows->y_end   = y_end;
+    rows->y       = y_start;
+    rows->w0_dy   = w0_dy;
+    rows->w1_dy   = w1_dy;
+    rows->w2_dy   = w2_dy;
+
+    return true;
+}
+
+// Draws the covered pixels of row `rows->y` of a triangle with drawing state
+// `state` and span function `draw_span`, then steps to the next row. This is
+// inlined into the row loops, which it is most of.
+LIBPS_RENDERER_SW_SPECIALIZE void
+draw_triangle_row(const struct libps_renderer_sw_state* state,
+                  const libps_renderer_sw_span_fn draw_span,
+                  struct triangle_rows* const rows)
+{
+    struct libps_renderer_sw_span* const span = &rows->span;
+
+    const unsigned int stride = LIBPS_GPU_VRAM_WIDTH * state->scale;
+
+    span->pixels = &state->vram[rows->x_start + (stride * rows->y)];
+
+    // The spans of wide rows are narrowed down to their covered pixels,
+    // which saves testing most of the ones outside of the triangle. For
+    // narrow rows, that costs more than it saves.
+    const bool count_masked_pixels = state->masked_pixels && state->mask_check;
+
+    if ((span->count >= NARROW_SPAN_PIXELS) || count_masked_pixels)
+    {
+        int32_t first = 0;
+        int32_t last  = (int32_t)span->count - 1;
+
+        cover_edge(span->w0, span->w0_dx, &first, &last);
+        cover_edge(span->w1, span->w1_dx, &first, &last);
+        cover_edge(span->w2, span->w2_dx, &first, &last);
+
+        if (first <= last)
+        {
+            struct libps_renderer_sw_span covered =
+            libps_renderer_sw_span_advance(span, (unsigned int)first);
+
+            covered.count = (unsigned int)(last - first) + 1;
+
+            // Pixels the mask bit protects are counted before they could be
+            // drawn.
+            if (count_masked_pixels)
+            {
+                count_masked(covered.pixels,
+                             (int32_t)covered.count,
+                             state->masked_pixels);
+            }
+            draw_span(&covered);
+        }
+    }
+    else
+    {
+        draw_span(span);
+    }
+
+    span->w0 += rows->w0_dy;
+    span->w1 += rows->w1_dy;
+    span->w2 += rows->w2_dy;
+
+    span->r += rows->r_dy;
+    span->g += rows->g_dy;
+    span->b += rows->b_dy;
+    span->u += rows->u_dy;
+    span->v += rows->v_dy;
+
+    rows->y++;
+}
+
+// Returns the span function drawing triangles with drawing state `state`.
+// Nothing about how the pixels are drawn changes within a primitive.
+static libps_renderer_sw_span_fn
+get_span_fn(const struct libps_renderer_sw_state* const state)
+{
+    return spans[LIBPS_RENDERER_SW_SPAN_INDEX(state->flags &
+                                              DRAW_FLAG_TEXTURED,
+                                              !(state->flags &
+                                                DRAW_FLAG_OPAQUE),
+                                              state->blend_mode,
+                                              state->mask_check)];
+}
+
+// Draws the triangle (`v0`, `v1`, `v2`) with drawing state `state`.
+void libps_renderer_sw_triangle(const struct libps_renderer_sw_state* state,
+                                const struct libps_gpu_vertex* const v0,
+                                const struct libps_gpu_vertex* const v1,
+                                const struct libps_gpu_vertex* const v2)
+{
+    assert(state != NULL);
     assert(v0 != NULL);
     assert(v1 != NULL);
     assert(v2 != NULL);
+    assert(spans != NULL);
 
-    // https://fgiesen.wordpress.com/2013/02/08/triangle-rasterization-in-practice/
-    struct libps_gpu_vertex p;
-    const struct libps_gpu_vertex* v1_real;
-    const struct libps_gpu_vertex* v2_real;
+    struct triangle_rows rows;
 
-    if (edge_function(v0, v1, v2) < 0)
+    if (!setup_triangle_rows(state, v0, v1, v2, &rows))
     {
-        v1_real = v2;
-        v2_real = v1;
+        return;
     }
-    else
+
+    const libps_renderer_sw_span_fn draw_span = get_span_fn(state);
+
+    while (rows.y <= rows.y_end)
     {
-        v1_real = v1;
-        v2_real = v2;
+        draw_triangle_row(state, draw_span, &rows);
     }
+}
+
+// Draws the quad made of the triangles (`vertices[0]`, `vertices[1]`,
+// `vertices[2]`) and (`vertices[1]`, `vertices[2]`, `vertices[3]`) with drawing
+// state `state`. Like on the GPU, every triangle has attributes of its own, but
+// the drawing state and texture are only set up once for both.
+void libps_renderer_sw_quad(const struct libps_renderer_sw_state* state,
+                            const struct libps_gpu_vertex* const vertices)
+{
+    assert(state != NULL);
+    assert(vertices != NULL);
+    assert(spans != NULL);
+
+    struct triangle_rows halves[2];
+
+    const bool drawn[2] =
+    {
+        setup_triangle_rows(state,
+                            &vertices[0],
+                            &vertices[1],
+                            &vertices[2],
+                            &halves[0]),
+
+        setup_triangle_rows(state,
+                            &vertices[1],
+                            &vertices[2],
+                            &vertices[3],
+                            &halves[1])
+    };
 
-    const float area = edge_function(v0, v1_real, v2_real);
+    const libps_renderer_sw_span_fn draw_span = get_span_fn(state);
 
-    for (p.y = gpu->drawing_area.y1; p.y <= gpu->drawing_area.y2; p.y++)
+    // The halves are drawn one after the other. Drawing them a row at a time
+    // each is slower: the vector span functions store whole groups of pixels,
+    // and the groups of both halves overlap along the shared edge, so every
+    // row of the second half would load pixels the first half just stored.
+    for (unsigned int i = 0; i < 2; ++i)
     {
-        for (p.x = gpu->drawing_area.x1; p.x <= gpu->drawing_area.x2; p.x++)
+        if (!drawn[i])
         {
-            float w0 = edge_function(v1_real, v2_real, &p);
-            float w1 = edge_function(v2_real, v0, &p);
-            float w2 = edge_function(v0, v1_real, &p);
+            continue;
+        }
 
-            if (w0 >= 0 && w1 >= 0 && w2 >= 0)
-            {
-                unsigned int pixel_r;
-                unsigned int pixel_g;
-                unsigned int pixel_b;
+        while (halves[i].y <= halves[i].y_end)
+        {
+            draw_triangle_row(state, draw_span, &halves[i]);
+        }
+    }
+}
 
-                if (gpu->cmd_packet.flags & DRAW_FLAG_TEXTURED)
-                {
-                    const uint16_t texcoord_x = ((w0 * (v0->texcoord & 0x00FF)) +
-                                                 (w1 * (v1_real->texcoord & 0x00FF)) +
-                                                 (w2 * (v2_real->texcoord & 0x00FF))) / area;
-  
-                    const uint16_t texcoord_y = ((w0 * (v0->texcoord >> 8)) +
-                                                 (w1 * (v1_real->texcoord >> 8)) +
-                                                 (w2 * (v2_real->texcoord >> 8))) / area;
+// Draws the `width` x `height` rectangle whose top left corner is `vertex`
+// with drawing state `state`. Textured rectangles are drawn with `texture`,
+// starting from the texture coordinate of `vertex`.
+void libps_renderer_sw_sprite(const struct libps_renderer_sw_state* state,
+                              const struct libps_gpu_vertex* const vertex,
+                              const unsigned int width,
+                              const unsigned int height)
+{
+    assert(state != NULL);
+    assert(vertex != NULL);
+    assert(rows != NULL);
+
+    // Vertices are relative to the drawing offset. Upscaled rectangles are
+    // `scale` times as large, with every texel covering a block of pixels.
+    const int32_t scale = (int32_t)state->scale;
 
-                    const unsigned int texpage_x_base = v1->texpage & 0x0F;
-                    const unsigned int texpage_y_base = (v1->texpage & (1 << 4)) ? 256 : 0;
+    const int32_t x = (vertex->x + state->offset_x) * scale;
+    const int32_t y = (vertex->y + state->offset_y) * scale;
 
-                    unsigned int texpage_color_depth;
+    const int32_t x_end =
+    LIBPS_MIN(x + ((int32_t)width * scale) - 1, state->clip_x2);
 
-                    uint16_t final_texcoord_x;
+    const int32_t y_end =
+    LIBPS_MIN(y + ((int32_t)height * scale) - 1, state->clip_y2);
 
-                    switch ((v1->texpage >> 7) & 0x03)
-                    {
-                        case 0:
-                            texpage_color_depth = 4;
-                            final_texcoord_x = (texpage_x_base * 64) + (texcoord_x / 4);
+    const int32_t x_start = LIBPS_MAX(x, state->clip_x1);
+    const int32_t y_start = LIBPS_MAX(y, state->clip_y1);
 
-                            break;
+    if ((x_start > x_end) || (y_start > y_end))
+    {
+        return;
+    }
 
-                        case 1:
-                            texpage_color_depth = 8;
-                            final_texcoord_x = (texpage_x_base * 64) + (texcoord_x / 8);
+    const unsigned int count = (unsigned int)(x_end - x_start) + 1;
+    const bool textured      = state->flags & DRAW_FLAG_TEXTURED;
 
-                            break;
+    const libps_renderer_sw_row_fn draw_row =
+    rows[LIBPS_RENDERER_SW_SPAN_INDEX(textured,
+                                      !(state->flags & DRAW_FLAG_OPAQUE),
+                                      state->blend_mode,
+                                      state->mask_check)];
 
-                        case 2:
-                            texpage_color_depth = 16;
-                                
-                            final_texcoord_x = (texpage_x_base * 64) + texcoord_x;
-                            break;
-                    }
+    const unsigned int stride = LIBPS_GPU_VRAM_WIDTH * state->scale;
 
-                    const uint16_t final_texcoord_y = texpage_y_base + texcoord_y;
+    // Pixels the mask bit protects are counted before they could be drawn.
+    if (state->masked_pixels && state->mask_check)
+    {
+        for (int32_t row = y_start; row <= y_end; ++row)
+        {
+            count_masked(&state->vram[x_start + (stride * row)],
+                         (int32_t)count,
+                         state->masked_pixels);
+        }
+    }
 
-                    const uint16_t texel = gpu->vram[final_texcoord_x +
-                    (LIBPS_GPU_VRAM_WIDTH * final_texcoord_y)];
+    uint16_t front[LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_MAX_SCALE];
 
-                    const uint16_t color =
-                    process_pixel_through_clut(gpu, texcoord_x, texel, texpage_color_depth, v0->palette);
+    if (!textured)
+    {
+        const unsigned int r = (vertex->color & 0xFF) / 8;
+        const unsigned int g = ((vertex->color >> 8) & 0xFF) / 8;
+        const unsigned int b = ((vertex->color >> 16) & 0xFF) / 8;
 
-                    if (color == 0x0000)
-                    {
-                        continue;
-                    }
+        // G5B5R5A1
+        const uint16_t color = (uint16_t)((g << 5) | (b << 10) | r);
 
-                    // G5B5R5A1
-                    gpu->vram[p.x + (LIBPS_GPU_VRAM_WIDTH * p.y)] = color;
-                }
-                else
-                {
-                    pixel_r = ((w0 * (v0->color & 0x000000FF)) +
-                               (w1 * (v1_real->color & 0x000000FF)) +
-                               (w2 * (v2_real->color & 0x000000FF))) / area / 8;
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            front[i] = color;
+        }
+
+        for (int32_t row = y_start; row <= y_end; ++row)
+        {
+            draw_row(&state->vram[x_start + (stride * row)],
+                     front,
+                     count,
+                     state->mask_set);
+        }
+        return;
+    }
+
+    assert(state->texture != NULL);
+
+    // U only depends on the column and V on the row, and both wrap around
+    // within the texture page. The U of every column, flipped and through
+    // the texture window, is worked out once for the whole rectangle.
+    const unsigned int u = vertex->texcoord & 0xFF;
+    const unsigned int v = vertex->texcoord >> 8;
+
+    uint8_t columns[LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_MAX_SCALE];
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned int dx = ((unsigned int)(x_start - x) + i) / scale;
+        const uint8_t column  = (uint8_t)(state->flip_x ? (u - dx) : (u + dx));
 
-                    pixel_g = ((w0 * ((v0->color >> 8) & 0xFF)) +
-                               (w1 * ((v1_real->color >> 8) & 0xFF)) +
-                               (w2 * ((v2_real->color >> 8) & 0xFF))) / area / 8;
+        columns[i] = (column & state->window_u_and) | state->window_u_or;
+    }
+
+    for (int32_t row = y_start; row <= y_end; ++row)
+    {
+        const unsigned int dy = (unsigned int)(row - y) / scale;
+        const uint8_t line    = (uint8_t)(state->flip_y ? (v - dy) : (v + dy));
+
+        const uint16_t* texels =
+        &state->texture[((line & state->window_v_and) | state->window_v_or) *
+                        LIBPS_RENDERER_SW_TEXTURE_SIZE];
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            front[i] = texels[columns[i]];
+        }
+
+        draw_row(&state->vram[x_start + (stride * row)],
+                 front,
+                 count,
+                 state->mask_set);
+    }
+}
+
+// Returns `delta` / `k` in 32.32 fixed point, rounded away from zero.
+static int64_t line_divide(const int32_t delta, const int32_t k)
+{
+    int64_t quotient = (int64_t)((uint64_t)(int64_t)delta << 32);
+
+    if (quotient < 0)
+    {
+        quotient -= k - 1;
+    }
+    else if (quotient > 0)
+    {
+        quotient += k - 1;
+    }
+    return quotient / k;
+}
+
+// Returns `delta` / `k` in 8.12 fixed point.
+static int32_t line_color_divide(const int32_t delta, const int32_t k)
+{
+    return (int32_t)((uint32_t)delta << 12) / k;
+}
+
+// Where a line starts and how it steps, one pixel per step
+struct line
+{
+    // The ends the line is drawn from and to
+    const struct libps_gpu_vertex* start;
+    const struct libps_gpu_vertex* end;
+
+    // Number of steps; `k + 1` pixels are drawn.
+    int32_t k;
 
-                    pixel_b = ((w0 * ((v0->color >> 16) & 0xFF)) +
-                               (w1 * ((v1_real->color >> 16) & 0xFF)) +
-                               (w2 * ((v2_real->color >> 16) & 0xFF))) / area / 8;
+    // Position of the first pixel and step, in 32.32 fixed point
+    int64_t x, y;
+    int64_t x_dk, y_dk;
+};
 
-                    // G5B5R5A1
-                    gpu->vram[p.x + (LIBPS_GPU_VRAM_WIDTH * p.y)] =
-                    (pixel_g << 5) | (pixel_b << 10) | pixel_r;
+// Fills `line` with the line from `v0` to `v1` drawn with drawing state
+// `state`. Returns `false` if the GPU draws no pixels of it at all.
+static bool setup_line(const struct libps_renderer_sw_state* const state,
+                       const struct libps_gpu_vertex* const v0,
+                       const struct libps_gpu_vertex* const v1,
+                       struct line* const line)
+{
+    const struct libps_gpu_vertex* start = v0;
+    const struct libps_gpu_vertex* end   = v1;
+
+    // The GPU skips lines spanning 1024 or more pixels horizontally, or 512
+    // or more vertically.
+    const int32_t dx = abs(end->x - start->x);
+    const int32_t dy = abs(end->y - start->y);
+
+    if ((dx >= LIBPS_GPU_VRAM_WIDTH) || (dy >= LIBPS_GPU_VRAM_HEIGHT))
+    {
+        return false;
+    }
+
+    // One pixel is drawn per step along the major axis.
+    const int32_t k = LIBPS_MAX(dx, dy);
+
+    // Lines are always drawn from left to right.
+    if ((start->x >= end->x) && (k != 0))
+    {
+        const struct libps_gpu_vertex* const tmp = start;
+        start = end;
+        end   = tmp;
+    }
+
+    line->start = start;
+    line->end   = end;
+    line->k     = k;
+    line->x_dk  = 0;
+    line->y_dk  = 0;
+
+    if (k != 0)
+    {
+        line->x_dk = line_divide(end->x - start->x, k);
+        line->y_dk = line_divide(end->y - start->y, k);
+    }
+
+    // Vertices are relative to the drawing offset. Stepping starts from the
+    // middle of the first pixel.
+    line->x = ((start->x + state->offset_x) * (INT64_C(1) << 32)) +
+              (INT64_C(1) << 31);
+
+    line->y = ((start->y + state->offset_y) * (INT64_C(1) << 32)) +
+              (INT64_C(1) << 31);
+
+    // Moving the start point back a tiny bit decides which pixel is drawn
+    // where a line passes exactly halfway between two, the same way the GPU
+    // does.
+    line->x -= 1024;
+
+    if (line->y_dk < 0)
+    {
+        line->y -= 1024;
+    }
+    return true;
+}
+
+// Draws the line from `v0` to `v1`, both ends included, with drawing state
+// `state`.
+void libps_renderer_sw_line(const struct libps_renderer_sw_state* state,
+                            const struct libps_gpu_vertex* const v0,
+                            const struct libps_gpu_vertex* const v1)
+{
+    assert(state != NULL);
+    assert(v0 != NULL);
+    assert(v1 != NULL);
+
+    struct line line;
+
+    if (!setup_line(state, v0, v1, &line))
+    {
+        return;
+    }
+
+    const int32_t r0 = line.start->color & 0xFF;
+    const int32_t g0 = (line.start->color >> 8) & 0xFF;
+    const int32_t b0 = (line.start->color >> 16) & 0xFF;
+
+    const int32_t r1 = line.end->color & 0xFF;
+    const int32_t g1 = (line.end->color >> 8) & 0xFF;
+    const int32_t b1 = (line.end->color >> 16) & 0xFF;
+
+    // Colors are stepped in 8.12 fixed point, starting from the middle of the
+    // first pixel.
+    int32_t red_dk   = 0;
+    int32_t green_dk = 0;
+    int32_t blue_dk  = 0;
+
+    if (line.k != 0)
+    {
+        red_dk   = line_color_divide(r1 - r0, line.k);
+        green_dk = line_color_divide(g1 - g0, line.k);
+        blue_dk  = line_color_divide(b1 - b0, line.k);
+    }
+
+    int64_t x = line.x;
+    int64_t y = line.y;
+
+    int32_t red   = (r0 << 12) | (1 << 11);
+    int32_t green = (g0 << 12) | (1 << 11);
+    int32_t blue  = (b0 << 12) | (1 << 11);
+
+    const struct libps_renderer_sw_blend blend =
+    {
+        .semi_transparent = !(state->flags & DRAW_FLAG_OPAQUE),
+        .mode             = state->blend_mode,
+        .textured         = false,
+        .mask_set         = state->mask_set,
+        .mask_check       = state->mask_check
+    };
+
+    // Upscaled lines step the same way, with every pixel becoming a block of
+    // pixels.
+    const int32_t scale = (int32_t)state->scale;
+    const int32_t stride = LIBPS_GPU_VRAM_WIDTH * scale;
+
+    for (int32_t i = 0; i <= line.k; ++i)
+    {
+        const int32_t px = (int32_t)(x >> 32) * scale;
+        const int32_t py = (int32_t)(y >> 32) * scale;
+
+        // G5B5R5A1
+        const uint16_t color = (uint16_t)(((red   >> 15) & 0x1F)        |
+                                          (((green >> 15) & 0x1F) << 5) |
+                                          (((blue  >> 15) & 0x1F) << 10));
+
+        const int32_t x1 = LIBPS_MAX(px, state->clip_x1);
+        const int32_t y1 = LIBPS_MAX(py, state->clip_y1);
+        const int32_t x2 = LIBPS_MIN(px + scale - 1, state->clip_x2);
+        const int32_t y2 = LIBPS_MIN(py + scale - 1, state->clip_y2);
+
+        for (int32_t block_y = y1; block_y <= y2; ++block_y)
+        {
+            for (int32_t block_x = x1; block_x <= x2; ++block_x)
+            {
+                uint16_t* const pixel =
+                &state->vram[block_x + (stride * block_y)];
+
+                if (state->masked_pixels && (*pixel & state->mask_check))
+                {
+                    ++*state->masked_pixels;
                 }
+                *pixel = libps_renderer_sw_output_pixel(*pixel, color, &blend);
             }
         }
+
+        x     += line.x_dk;
+        y     += line.y_dk;
+        red   += red_dk;
+        green += green_dk;
+        blue  += blue_dk;
+    }
+}
+
+// Adds the number of pixels of the rectangle from (`x1`, `y1`) to (`x2`,
+// `y2`), both included, inside of the clip rectangle of `state` to `*inside`,
+// and the rest to `*outside`.
+static void count_clipped(const struct libps_renderer_sw_state* const state,
+                          const int32_t x1,
+                          const int32_t y1,
+                          const int32_t x2,
+                          const int32_t y2,
+                          uint64_t* const inside,
+                          uint64_t* const outside)
+{
+    const int64_t total = (int64_t)((x2 - x1) + 1) * ((y2 - y1) + 1);
+
+    const int32_t width  = LIBPS_MIN(x2, state->clip_x2) -
+                           LIBPS_MAX(x1, state->clip_x1) + 1;
+
+    const int32_t height = LIBPS_MIN(y2, state->clip_y2) -
+                           LIBPS_MAX(y1, state->clip_y1) + 1;
+
+    const int64_t in = ((width > 0) && (height > 0)) ?
+                       ((int64_t)width * height) : 0;
+
+    *inside  += (uint64_t)in;
+    *outside += (uint64_t)(total - in);
+}
+
+// Adds the number of pixels the triangle (`v0`, `v1`, `v2`) covers inside of
+// the clip rectangle of `state` to `*inside`, and the number outside of it to
+// `*outside`. `state` must draw into VRAM itself.
+void
+libps_renderer_sw_count_triangle(const struct libps_renderer_sw_state* state,
+                                 const struct libps_gpu_vertex* const v0,
+                                 const struct libps_gpu_vertex* const v1,
+                                 const struct libps_gpu_vertex* const v2,
+                                 uint64_t* const inside,
+                                 uint64_t* const outside)
+{
+    assert(state != NULL);
+    assert(state->scale == 1);
+    assert(v0 != NULL);
+    assert(v1 != NULL);
+    assert(v2 != NULL);
+    assert(inside != NULL);
+    assert(outside != NULL);
+
+    struct triangle t;
+
+    if (!setup_triangle(state, v0, v1, v2, &t))
+    {
+        return;
+    }
+
+    const int32_t w0_dx = t.by - t.cy;
+    const int32_t w0_dy = t.cx - t.bx;
+    const int32_t w1_dx = t.cy - t.ay;
+    const int32_t w1_dy = t.ax - t.cx;
+    const int32_t w2_dx = t.ay - t.by;
+    const int32_t w2_dy = t.bx - t.ax;
+
+    int32_t w0 = edge_function(t.bx, t.by, t.cx, t.cy, t.min_x, t.min_y) +
+                 t.bias0;
+
+    int32_t w1 = edge_function(t.cx, t.cy, t.ax, t.ay, t.min_x, t.min_y) +
+                 t.bias1;
+
+    int32_t w2 = edge_function(t.ax, t.ay, t.bx, t.by, t.min_x, t.min_y) +
+                 t.bias2;
+
+    // The covered pixels of each row are worked out from the edge functions
+    // at its first pixel, the same ones the rasterizer would draw.
+    for (int32_t y = t.min_y; y <= t.max_y; ++y)
+    {
+        int32_t first = 0;
+        int32_t last  = t.max_x - t.min_x;
+
+        cover_edge(w0, w0_dx, &first, &last);
+        cover_edge(w1, w1_dx, &first, &last);
+        cover_edge(w2, w2_dx, &first, &last);
+
+        if (first <= last)
+        {
+            count_clipped(state,
+                          t.min_x + first,
+                          y,
+                          t.min_x + last,
+                          y,
+                          inside,
+                          outside);
+        }
+
+        w0 += w0_dy;
+        w1 += w1_dy;
+        w2 += w2_dy;
+    }
+}
+
+// Adds the number of pixels of the `width` x `height` rectangle whose top left
+// corner is `vertex` inside of the clip rectangle of `state` to `*inside`, and
+// the number outside of it to `*outside`. `state` must draw into VRAM itself.
+void
+libps_renderer_sw_count_sprite(const struct libps_renderer_sw_state* state,
+                               const struct libps_gpu_vertex* const vertex,
+                               const unsigned int width,
+                               const unsigned int height,
+                               uint64_t* const inside,
+                               uint64_t* const outside)
+{
+    assert(state != NULL);
+    assert(state->scale == 1);
+    assert(vertex != NULL);
+    assert(inside != NULL);
+    assert(outside != NULL);
+
+    if ((width == 0) || (height == 0))
+    {
+        return;
+    }
+
+    // Vertices are relative to the drawing offset.
+    const int32_t x = vertex->x + state->offset_x;
+    const int32_t y = vertex->y + state->offset_y;
+
+    count_clipped(state,
+                  x,
+                  y,
+                  x + (int32_t)width - 1,
+                  y + (int32_t)height - 1,
+                  inside,
+                  outside);
+}
+
+// Adds the number of pixels of the line from `v0` to `v1` inside of the clip
+// rectangle of `state` to `*inside`, and the number outside of it to
+// `*outside`. `state` must draw into VRAM itself.
+void libps_renderer_sw_count_line(const struct libps_renderer_sw_state* state,
+                                  const struct libps_gpu_vertex* const v0,
+                                  const struct libps_gpu_vertex* const v1,
+                                  uint64_t* const inside,
+                                  uint64_t* const outside)
+{
+    assert(state != NULL);
+    assert(state->scale == 1);
+    assert(v0 != NULL);
+    assert(v1 != NULL);
+    assert(inside != NULL);
+    assert(outside != NULL);
+
+    struct line line;
+
+    if (!setup_line(state, v0, v1, &line))
+    {
+        return;
+    }
+
+    for (int32_t i = 0; i <= line.k; ++i)
+    {
+        const int32_t px = (int32_t)(line.x >> 32);
+        const int32_t py = (int32_t)(line.y >> 32);
+
+        count_clipped(state, px, py, px, py, inside, outside);
+
+        line.x += line.x_dk;
+        line.y += line.y_dk;
+    }
+}
+
+// Fills `state` with the current drawing state of `gpu`, counting the pixels
+// the mask bit protects if `gpu` is collecting statistics.
+static void get_drawing_state(struct libps_gpu* const gpu,
+                              struct libps_renderer_sw_state* const state)
+{
+    libps_renderer_sw_get_state(gpu, state);
+
+    if (gpu->stats_enabled)
+    {
+        state->masked_pixels = &gpu->stats.pixels_masked;
+    }
+}
+
+void libps_renderer_sw_draw_polygon(struct libps_gpu* gpu,
+                                    const struct libps_gpu_vertex* const v0,
+                                    struct libps_gpu_vertex* const v1,
+                                    struct libps_gpu_vertex* const v2)
+{
+    assert(gpu != NULL);
+
+    struct libps_renderer_sw_state state;
+    get_drawing_state(gpu, &state);
+
+    if (state.flags & DRAW_FLAG_TEXTURED)
+    {
+        state.texture =
+        libps_renderer_sw_texture_cache_find(gpu->texture_cache,
+                                             gpu,
+                                             v1->texpage,
+                                             v0->palette);
+        if (!state.texture)
+        {
+            state.texture =
+            libps_renderer_sw_texture_cache_load(gpu->texture_cache,
+                                                 gpu,
+                                                 v1->texpage,
+                                                 v0->palette);
+        }
+    }
+
+    libps_renderer_sw_triangle(&state, v0, v1, v2);
+
+    struct libps_renderer_sw_state upscaled;
+
+    if (libps_renderer_sw_upscale_state(gpu, &state, &upscaled))
+    {
+        libps_renderer_sw_triangle(&upscaled, v0, v1, v2);
+    }
+}
+
+void libps_renderer_sw_draw_quad(struct libps_gpu* gpu,
+                                 const struct libps_gpu_vertex* const vertices)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    struct libps_renderer_sw_state state;
+    get_drawing_state(gpu, &state);
+
+    if (state.flags & DRAW_FLAG_TEXTURED)
+    {
+        state.texture =
+        libps_renderer_sw_texture_cache_find(gpu->texture_cache,
+                                             gpu,
+                                             vertices[0].texpage,
+                                             vertices[0].palette);
+        if (!state.texture)
+        {
+            state.texture =
+            libps_renderer_sw_texture_cache_load(gpu->texture_cache,
+                                                 gpu,
+                                                 vertices[0].texpage,
+                                                 vertices[0].palette);
+        }
+    }
+
+    libps_renderer_sw_quad(&state, vertices);
+
+    struct libps_renderer_sw_state upscaled;
+
+    if (libps_renderer_sw_upscale_state(gpu, &state, &upscaled))
+    {
+        libps_renderer_sw_quad(&upscaled, vertices);
     }
 }
 
 void libps_renderer_sw_draw_rect(struct libps_gpu* gpu,
-                                 const struct libps_gpu_vertex* const vertex)
+                                 const struct libps_gpu_vertex* const vertex,
+                                 const unsigned int width,
+                                 const unsigned int height)
 {
     assert(gpu != NULL);
     assert(vertex != NULL);
 
-    const unsigned int pixel_r = (vertex->color & 0x000000FF) / 8;
-    const unsigned int pixel_g = ((vertex->color >> 8) & 0xFF) / 8;
-    const unsigned int pixel_b = ((vertex->color >> 16) & 0xFF) / 8;
+    struct libps_renderer_sw_state state;
+    get_drawing_state(gpu, &state);
 
-    gpu->vram[vertex->x + (LIBPS_GPU_VRAM_WIDTH * vertex->y)] =
-    (pixel_g << 5) | (pixel_b << 10) | pixel_r;
-}
\ No newline at end of file
+    if (state.flags & DRAW_FLAG_TEXTURED)
+    {
+        state.texture =
+        libps_renderer_sw_texture_cache_find(gpu->texture_cache,
+                                             gpu,
+                                             vertex->texpage,
+                                             vertex->palette);
+        if (!state.texture)
+        {
+            state.texture =
+            libps_renderer_sw_texture_cache_load(gpu->texture_cache,
+                                                 gpu,
+                                                 vertex->texpage,
+                                                 vertex->palette);
+        }
+    }
+
+    libps_renderer_sw_sprite(&state, vertex, width, height);
+
+    struct libps_renderer_sw_state upscaled;
+
+    if (libps_renderer_sw_upscale_state(gpu, &state, &upscaled))
+    {
+        libps_renderer_sw_sprite(&upscaled, vertex, width, height);
+    }
+}
+
+void libps_renderer_sw_draw_line(struct libps_gpu* gpu,
+                                 const struct libps_gpu_vertex* const vertices,
+                                 const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    // The drawing state can't change within a polyline.
+    struct libps_renderer_sw_state state;
+    get_drawing_state(gpu, &state);
+
+    struct libps_renderer_sw_state upscaled;
+    const bool upscaling = libps_renderer_sw_upscale_state(gpu,
+                                                            &state,
+                                                            &upscaled);
+
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        libps_renderer_sw_line(&state, &vertices[i - 1], &vertices[i]);
+
+        if (upscaling)
+        {
+            libps_renderer_sw_line(&upscaled, &vertices[i - 1], &vertices[i]);
+        }
+    }
+}
+
+// The single-threaded software renderer, which is the default
+const struct libps_gpu_renderer libps_renderer_sw =
+{
+    .draw_polygon = &libps_renderer_sw_draw_polygon,
+    .draw_quad    = &libps_renderer_sw_draw_quad,
+    .draw_rect    = &libps_renderer_sw_draw_rect,
+    .draw_line    = &libps_renderer_sw_draw_line,
+    .fill_rect    = &libps_renderer_sw_vram_fill,
+    .copy_rect    = &libps_renderer_sw_vram_copy,
+    .store_rect   = &libps_renderer_sw_vram_store,
+    .sync         = NULL,
+    .scanout      = &libps_renderer_sw_vram_scanout,
+    .cleanup      = NULL
+};
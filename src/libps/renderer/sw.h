@@ -19,16 +19,156 @@ extern "C"
 {
 #endif // __cplusplus
 
+#include <stdbool.h>
+#include <stdint.h>
+
 struct libps_gpu;
 struct libps_gpu_vertex;
 
+// The parts of the GPU's drawing state a primitive depends on. Primitives are
+// drawn into `vram`; pixels outside of the (inclusive) clip rectangle are left
+// untouched.
+struct libps_renderer_sw_state
+{
+    uint16_t* vram;
+
+    // Every pixel of VRAM is `scale` x `scale` pixels of `vram`, which is
+    // `LIBPS_GPU_VRAM_WIDTH * scale` pixels wide. The clip rectangle is in
+    // pixels of `vram`, the drawing offset and the vertices are not.
+    unsigned int scale;
+
+    int32_t clip_x1;
+    int32_t clip_y1;
+    int32_t clip_x2;
+    int32_t clip_y2;
+
+    int32_t offset_x;
+    int32_t offset_y;
+
+    // `DRAW_FLAG_*` of the primitive
+    unsigned int flags;
+
+    // Semi-transparency mode (GP0(E1h) bits 5-6)
+    unsigned int blend_mode;
+
+    // 0x8000 if drawn pixels get their mask bit set, 0 otherwise
+    uint16_t mask_set;
+
+    // 0x8000 if pixels with their mask bit set are not drawn over, 0
+    // otherwise
+    uint16_t mask_check;
+
+    // Decoded texture page of textured primitives, see `sw_texture.h`
+    const uint16_t* texture;
+
+    // Texture window (GP0(E2h)): texture coordinates are ANDed with the
+    // `*_and` value, then ORed with the `*_or` value.
+    uint8_t window_u_and;
+    uint8_t window_u_or;
+    uint8_t window_v_and;
+    uint8_t window_v_or;
+
+    // Are textured rectangles flipped horizontally and vertically (GP0(E1h)
+    // bits 12-13)?
+    bool flip_x;
+    bool flip_y;
+
+    // If not `NULL`, incremented for every pixel which is left alone because
+    // its mask bit is set, see `struct libps_gpu_stats`
+    uint64_t* masked_pixels;
+};
+
+// Selects the fastest span and row functions the host CPU supports. This must
+// be called before anything is drawn.
+void libps_renderer_sw_setup(void);
+
+// Fills `state` with the current drawing state of `gpu`. The clip rectangle
+// is the drawing area. `texture` and `masked_pixels` are left `NULL`.
+void libps_renderer_sw_get_state(const struct libps_gpu* gpu,
+                                 struct libps_renderer_sw_state* state);
+
+// Fills `upscaled` with `state` changed to draw into the upscaled VRAM of
+// `gpu`. `state` must draw into VRAM itself. Returns `false` if `gpu` isn't
+// upscaling.
+bool
+libps_renderer_sw_upscale_state(const struct libps_gpu* gpu,
+                                const struct libps_renderer_sw_state* state,
+                                struct libps_renderer_sw_state* upscaled);
+
+// Draws the triangle (`v0`, `v1`, `v2`) with drawing state `state`.
+void libps_renderer_sw_triangle(const struct libps_renderer_sw_state* state,
+                                const struct libps_gpu_vertex* const v0,
+                                const struct libps_gpu_vertex* const v1,
+                                const struct libps_gpu_vertex* const v2);
+
+// Draws the quad made of the triangles (`vertices[0]`, `vertices[1]`,
+// `vertices[2]`) and (`vertices[1]`, `vertices[2]`, `vertices[3]`) with drawing
+// state `state`. Like on the GPU, every triangle has attributes of its own, but
+// the drawing state and texture are only set up once for both.
+void libps_renderer_sw_quad(const struct libps_renderer_sw_state* state,
+                            const struct libps_gpu_vertex* const vertices);
+
+// Draws the `width` x `height` rectangle whose top left corner is `vertex`
+// with drawing state `state`. Textured rectangles are drawn with `texture`,
+// starting from the texture coordinate of `vertex`.
+void libps_renderer_sw_sprite(const struct libps_renderer_sw_state* state,
+                              const struct libps_gpu_vertex* const vertex,
+                              const unsigned int width,
+                              const unsigned int height);
+
+// Draws the line from `v0` to `v1`, both ends included, with drawing state
+// `state`.
+void libps_renderer_sw_line(const struct libps_renderer_sw_state* state,
+                            const struct libps_gpu_vertex* const v0,
+                            const struct libps_gpu_vertex* const v1);
+
+// Adds the number of pixels the triangle (`v0`, `v1`, `v2`) covers inside of
+// the clip rectangle of `state` to `*inside`, and the number outside of it to
+// `*outside`. `state` must draw into VRAM itself.
+void
+libps_renderer_sw_count_triangle(const struct libps_renderer_sw_state* state,
+                                 const struct libps_gpu_vertex* const v0,
+                                 const struct libps_gpu_vertex* const v1,
+                                 const struct libps_gpu_vertex* const v2,
+                                 uint64_t* const inside,
+                                 uint64_t* const outside);
+
+// Adds the number of pixels of the `width` x `height` rectangle whose top left
+// corner is `vertex` inside of the clip rectangle of `state` to `*inside`, and
+// the number outside of it to `*outside`. `state` must draw into VRAM itself.
+void
+libps_renderer_sw_count_sprite(const struct libps_renderer_sw_state* state,
+                               const struct libps_gpu_vertex* const vertex,
+                               const unsigned int width,
+                               const unsigned int height,
+                               uint64_t* const inside,
+                               uint64_t* const outside);
+
+// Adds the number of pixels of the line from `v0` to `v1` inside of the clip
+// rectangle of `state` to `*inside`, and the number outside of it to
+// `*outside`. `state` must draw into VRAM itself.
+void libps_renderer_sw_count_line(const struct libps_renderer_sw_state* state,
+                                  const struct libps_gpu_vertex* const v0,
+                                  const struct libps_gpu_vertex* const v1,
+                                  uint64_t* const inside,
+                                  uint64_t* const outside);
+
 void libps_renderer_sw_draw_polygon(struct libps_gpu* gpu,
                                     const struct libps_gpu_vertex* const v0,
                                     struct libps_gpu_vertex* const v1,
                                     struct libps_gpu_vertex* const v2);
 
+void libps_renderer_sw_draw_quad(struct libps_gpu* gpu,
+                                 const struct libps_gpu_vertex* const vertices);
+
 void libps_renderer_sw_draw_rect(struct libps_gpu* gpu,
-                                 const struct libps_gpu_vertex* const vertex);
+                                 const struct libps_gpu_vertex* const vertex,
+                                 const unsigned int width,
+                                 const unsigned int height);
+
+void libps_renderer_sw_draw_line(struct libps_gpu* gpu,
+                                 const struct libps_gpu_vertex* const vertices,
+                                 const unsigned int count);
 
 #ifdef __cplusplus
 }
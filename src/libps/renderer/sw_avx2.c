@@ -0,0 +1,229 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// This file is compiled with AVX2 code generation enabled. Nothing in here
+// may be called unless `libps_host_cpu_has_avx2()` returned `true`.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "sw_blend_sse2.h"
+#include "sw_span.h"
+#include "sw_texture.h"
+
+#ifdef LIBPS_HOST_X86_64
+#include <immintrin.h>
+
+// Returns the eight values `x`, `x + dx`, ..., `x + 7dx`.
+LIBPS_RENDERER_SW_SPECIALIZE __m256i ramp(const uint32_t x, const uint32_t dx)
+{
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    return _mm256_add_epi32(_mm256_set1_epi32((int)x),
+                            _mm256_mullo_epi32(lanes,
+                                               _mm256_set1_epi32((int)dx)));
+}
+
+// Returns all ones in each lane where any of the edge functions is negative,
+// i.e. where the pixel is *not* covered.
+LIBPS_RENDERER_SW_SPECIALIZE __m256i
+uncovered(const __m256i w0, const __m256i w1, const __m256i w2)
+{
+    return _mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(w0, w1), w2), 31);
+}
+
+// Narrows eight 32-bit lanes holding values in 0..0x7FFF (or all ones) to
+// eight 16-bit values.
+LIBPS_RENDERER_SW_SPECIALIZE __m128i narrow(const __m256i x)
+{
+    return _mm_packs_epi32(_mm256_castsi256_si128(x),
+                           _mm256_extracti128_si256(x, 1));
+}
+
+// Draws every covered pixel of `span`, eight pixels at a time.
+LIBPS_RENDERER_SW_SPECIALIZE void
+draw_span(const struct libps_renderer_sw_span* span,
+          const bool textured,
+          const bool semi_transparent,
+          const unsigned int mode,
+          const bool mask_check)
+{
+    assert(span != NULL);
+    assert(!textured || (span->texture != NULL));
+
+    const struct libps_renderer_sw_blend blend =
+    {
+        .semi_transparent = semi_transparent,
+        .mode             = mode,
+        .textured         = textured,
+        .mask_set         = span->mask_set,
+        .mask_check       = mask_check ? 0x8000 : 0x0000
+    };
+
+    __m256i w0 = ramp(span->w0, span->w0_dx);
+    __m256i w1 = ramp(span->w1, span->w1_dx);
+    __m256i w2 = ramp(span->w2, span->w2_dx);
+
+    const __m256i w0_step = _mm256_set1_epi32(span->w0_dx * 8);
+    const __m256i w1_step = _mm256_set1_epi32(span->w1_dx * 8);
+    const __m256i w2_step = _mm256_set1_epi32(span->w2_dx * 8);
+
+    // Texture coordinates of textured spans, colour of the others
+    __m256i a0, a1, a2;
+    __m256i a0_step, a1_step, a2_step;
+
+    if (textured)
+    {
+        a0 = ramp(span->u, span->u_dx);
+        a1 = ramp(span->v, span->v_dx);
+        a2 = _mm256_setzero_si256();
+
+        a0_step = _mm256_set1_epi32((int)(span->u_dx * 8));
+        a1_step = _mm256_set1_epi32((int)(span->v_dx * 8));
+        a2_step = _mm256_setzero_si256();
+    }
+    else
+    {
+        a0 = ramp(span->r, span->r_dx);
+        a1 = ramp(span->g, span->g_dx);
+        a2 = ramp(span->b, span->b_dx);
+
+        a0_step = _mm256_set1_epi32((int)(span->r_dx * 8));
+        a1_step = _mm256_set1_epi32((int)(span->g_dx * 8));
+        a2_step = _mm256_set1_epi32((int)(span->b_dx * 8));
+    }
+
+    // Texture window, see `struct libps_renderer_sw_span`
+    const __m256i window_u_and = _mm256_set1_epi32((int)span->window_u_and);
+    const __m256i window_v_and = _mm256_set1_epi32((int)span->window_v_and);
+    const __m256i window_or    = _mm256_set1_epi32((int)span->window_or);
+
+    unsigned int i = 0;
+
+    for (; (i + 8) <= span->count; i += 8)
+    {
+        const __m128i skip = narrow(uncovered(w0, w1, w2));
+
+        if (_mm_movemask_epi8(skip) != 0xFFFF)
+        {
+            __m128i front;
+
+            if (textured)
+            {
+                const __m256i u8 =
+                _mm256_and_si256(_mm256_srli_epi32(a0, 16), window_u_and);
+
+                const __m256i v8 =
+                _mm256_and_si256(_mm256_srli_epi32(a1, 16), window_v_and);
+
+                // The pages are separate allocations of 16-bit texels, so a
+                // 32-bit gather could read past the end of one; the texels
+                // are fetched one at a time instead. The offsets of
+                // uncovered pixels are still within the page.
+                // LIBPS_RENDERER_SW_TEXTURE_SIZE is 256.
+                uint32_t offsets[8];
+                uint16_t texels[8];
+
+                const __m256i uv =
+                _mm256_or_si256(u8, _mm256_slli_epi32(v8, 8));
+
+                _mm256_storeu_si256((__m256i*)offsets,
+                                    _mm256_or_si256(uv, window_or));
+
+                for (unsigned int lane = 0; lane < 8; ++lane)
+                {
+                    texels[lane] = span->texture[offsets[lane]];
+                }
+                front = _mm_loadu_si128((const __m128i*)texels);
+            }
+            else
+            {
+                const __m256i mask5 = _mm256_set1_epi32(0x1F);
+
+                const __m256i r5 =
+                _mm256_and_si256(_mm256_srli_epi32(a0, 19), mask5);
+
+                const __m256i g5 =
+                _mm256_and_si256(_mm256_srli_epi32(a1, 19), mask5);
+
+                const __m256i b5 =
+                _mm256_and_si256(_mm256_srli_epi32(a2, 19), mask5);
+
+                // G5B5R5A1
+                front =
+                narrow(_mm256_or_si256(_mm256_or_si256(r5,
+                                                       _mm256_slli_epi32(g5,
+                                                                         5)),
+                                       _mm256_slli_epi32(b5, 10)));
+            }
+
+            __m128i* dst = (__m128i*)(span->pixels + i);
+
+            const __m128i old  = _mm_loadu_si128(dst);
+            const __m128i draw = _mm_xor_si128(skip, _mm_set1_epi32(-1));
+
+            _mm_storeu_si128(dst,
+                             libps_renderer_sw_output_pixels_sse2(old,
+                                                                  front,
+                                                                  draw,
+                                                                  &blend));
+        }
+
+        w0 = _mm256_add_epi32(w0, w0_step);
+        w1 = _mm256_add_epi32(w1, w1_step);
+        w2 = _mm256_add_epi32(w2, w2_step);
+
+        a0 = _mm256_add_epi32(a0, a0_step);
+        a1 = _mm256_add_epi32(a1, a1_step);
+        a2 = _mm256_add_epi32(a2, a2_step);
+    }
+
+    // Every pixel of a group is stored back, so pixels past the end of the
+    // span (which may belong to another thread) are drawn one at a time.
+    if (i < span->count)
+    {
+        const struct libps_renderer_sw_span tail =
+        libps_renderer_sw_span_advance(span, i);
+
+        libps_renderer_sw_spans_scalar
+        [LIBPS_RENDERER_SW_SPAN_INDEX(textured,
+                                      semi_transparent,
+                                      mode,
+                                      mask_check)](&tail);
+    }
+}
+
+#define SPAN_NAME(textured, semi_transparent, mode, mask_check)              \
+span_##textured##_##semi_transparent##_##mode##_##mask_check
+
+#define DEFINE_SPAN(textured, semi_transparent, mode, mask_check)            \
+static void SPAN_NAME(textured, semi_transparent, mode, mask_check)          \
+(const struct libps_renderer_sw_span* span)                                  \
+{                                                                            \
+    draw_span(span, textured, semi_transparent, mode, mask_check);           \
+}
+
+#define SPAN_ENTRY(textured, semi_transparent, mode, mask_check)             \
+[LIBPS_RENDERER_SW_SPAN_INDEX(textured, semi_transparent, mode,              \
+                              mask_check)] =                                 \
+&SPAN_NAME(textured, semi_transparent, mode, mask_check),
+
+LIBPS_RENDERER_SW_SPANS(DEFINE_SPAN)
+
+// AVX2 span functions
+const libps_renderer_sw_span_fn
+libps_renderer_sw_spans_avx2[LIBPS_RENDERER_SW_SPAN_VARIANTS] =
+{
+    LIBPS_RENDERER_SW_SPANS(SPAN_ENTRY)
+};
+#endif // LIBPS_HOST_X86_64
@@ -0,0 +1,142 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Semi-transparency and mask bit handling for eight 16-bit pixels in an SSE2
+// register. These are shared by the SSE2 and AVX2 span kernels; included in
+// the AVX2 kernels, they compile to the VEX encoded forms.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include "sw_span.h"
+
+#ifdef LIBPS_HOST_X86_64
+#include <emmintrin.h>
+
+// Combines the components of `back` (already in VRAM) and `front` (being
+// drawn) which are in the top 5 bits of each lane with semi-transparency mode
+// `mode`. The unsigned saturating instructions clamp them to 0..31 for free.
+static inline __m128i
+libps_renderer_sw_blend_components_sse2(const __m128i back,
+                                        const __m128i front,
+                                        const unsigned int mode)
+{
+    const __m128i top = _mm_set1_epi16((short)0xF800);
+
+    switch (mode)
+    {
+        case 0:
+            return _mm_and_si128(_mm_avg_epu16(back, front), top);
+
+        case 1:
+            return _mm_and_si128(_mm_adds_epu16(back, front), top);
+
+        case 2:
+            return _mm_subs_epu16(back, front);
+
+        default:
+        {
+            const __m128i quarter = _mm_and_si128(_mm_srli_epi16(front, 2),
+                                                  top);
+
+            return _mm_and_si128(_mm_adds_epu16(back, quarter), top);
+        }
+    }
+}
+
+// Combines the pixels `back` (already in VRAM) and `front` (being drawn) with
+// semi-transparency mode `mode`. Bit 15 of the result is clear.
+static inline __m128i libps_renderer_sw_blend_sse2(const __m128i back,
+                                                   const __m128i front,
+                                                   const unsigned int mode)
+{
+    const __m128i top = _mm_set1_epi16((short)0xF800);
+
+    // Red is bits 0-4, green 5-9 and blue 10-14.
+    const __m128i back_r  = _mm_slli_epi16(back,  11);
+    const __m128i front_r = _mm_slli_epi16(front, 11);
+    const __m128i back_g  = _mm_and_si128(_mm_slli_epi16(back,  6), top);
+    const __m128i front_g = _mm_and_si128(_mm_slli_epi16(front, 6), top);
+    const __m128i back_b  = _mm_and_si128(_mm_slli_epi16(back,  1), top);
+    const __m128i front_b = _mm_and_si128(_mm_slli_epi16(front, 1), top);
+
+    const __m128i r =
+    libps_renderer_sw_blend_components_sse2(back_r, front_r, mode);
+
+    const __m128i g =
+    libps_renderer_sw_blend_components_sse2(back_g, front_g, mode);
+
+    const __m128i b =
+    libps_renderer_sw_blend_components_sse2(back_b, front_b, mode);
+
+    return _mm_or_si128(_mm_or_si128(_mm_srli_epi16(r, 11),
+                                     _mm_srli_epi16(g, 6)),
+                        _mm_srli_epi16(b, 1));
+}
+
+// Returns what the pixels `back` become when `front` is drawn over those
+// lanes of them which are all ones in `draw`, as described by `blend`.
+static inline __m128i
+libps_renderer_sw_output_pixels_sse2(const __m128i back,
+                                     __m128i front,
+                                     __m128i draw,
+                                     const struct libps_renderer_sw_blend*
+                                     blend)
+{
+    if (blend->mask_check)
+    {
+        draw = _mm_andnot_si128(_mm_srai_epi16(back, 15), draw);
+    }
+
+    if (blend->textured)
+    {
+        draw = _mm_andnot_si128(_mm_cmpeq_epi16(front, _mm_setzero_si128()),
+                                draw);
+    }
+
+    if (blend->semi_transparent)
+    {
+        const __m128i blended =
+        libps_renderer_sw_blend_sse2(back, front, blend->mode);
+
+        if (blend->textured)
+        {
+            // Only texels with bit 15 set are semi-transparent, and they
+            // keep it.
+            const __m128i semi = _mm_srai_epi16(front, 15);
+
+            front = _mm_or_si128(_mm_and_si128(semi, blended),
+                                 _mm_andnot_si128(_mm_srli_epi16(semi, 1),
+                                                  front));
+        }
+        else
+        {
+            front = blended;
+        }
+    }
+
+    front = _mm_or_si128(front, _mm_set1_epi16((short)blend->mask_set));
+
+    return _mm_or_si128(_mm_and_si128(draw, front),
+                        _mm_andnot_si128(draw, back));
+}
+#endif // LIBPS_HOST_X86_64
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
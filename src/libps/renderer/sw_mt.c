@@ -0,0 +1,617 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "gpu.h"
+#include "sw.h"
+#include "sw_mt.h"
+#include "sw_texture.h"
+#include "sw_vram.h"
+#include "../utility/math.h"
+#include "../utility/memory.h"
+#include "../utility/thread.h"
+
+#define TILE_SIZE 64
+#define TILES_X (LIBPS_GPU_VRAM_WIDTH / TILE_SIZE)
+#define TILES_Y (LIBPS_GPU_VRAM_HEIGHT / TILE_SIZE)
+#define TILE_COUNT (TILES_X * TILES_Y)
+
+// Maximum number of primitives queued before a flush is forced. Command
+// indices in the tile bins are 16-bit.
+#define MAX_COMMANDS 4096
+
+enum command_type
+{
+    COMMAND_TRIANGLE,
+    COMMAND_QUAD,
+    COMMAND_SPRITE,
+    COMMAND_LINE
+};
+
+// A queued primitive along with the drawing state it was submitted with
+struct command
+{
+    enum command_type type;
+    struct libps_renderer_sw_state state;
+    struct libps_gpu_vertex vertices[4];
+
+    // Size of sprites
+    unsigned int width;
+    unsigned int height;
+};
+
+// Inclusive rectangle of tiles
+struct tile_rect
+{
+    unsigned int x1;
+    unsigned int y1;
+    unsigned int x2;
+    unsigned int y2;
+};
+
+struct renderer
+{
+    // GPU drawn for, needed to find its upscaled VRAM and statistics
+    struct libps_gpu* gpu;
+
+    struct command* commands;
+    unsigned int command_count;
+
+    // Indices into `commands` of the primitives touching each tile, in
+    // submission order
+    uint16_t* bins;
+    unsigned int bin_count[TILE_COUNT];
+
+    // Pixels left alone because their mask bit is set, counted per tile so
+    // that threads never share a counter
+    uint64_t masked_pixels[TILE_COUNT];
+
+    libps_thread* threads;
+    unsigned int worker_count;
+
+    libps_mutex mutex;
+
+    // Signaled when a new batch of tiles is ready to be drawn
+    libps_cond work_ready;
+
+    // Signaled when every tile of the current batch has been drawn
+    libps_cond work_done;
+
+    // Incremented every batch, so that workers can tell a new batch from a
+    // spurious wakeup.
+    unsigned int batch;
+
+    // Next tile of the current batch to be picked up, and the number of tiles
+    // which have been drawn
+    unsigned int next_tile;
+    unsigned int tiles_done;
+
+    bool quit;
+};
+
+// Draws `command` with drawing state `state`.
+static void draw_command(const struct command* command,
+                         const struct libps_renderer_sw_state* state)
+{
+    switch (command->type)
+    {
+        case COMMAND_TRIANGLE:
+            libps_renderer_sw_triangle(state,
+                                       &command->vertices[0],
+                                       &command->vertices[1],
+                                       &command->vertices[2]);
+            break;
+
+        case COMMAND_QUAD:
+            libps_renderer_sw_quad(state, command->vertices);
+            break;
+
+        case COMMAND_SPRITE:
+            libps_renderer_sw_sprite(state,
+                                     &command->vertices[0],
+                                     command->width,
+                                     command->height);
+            break;
+
+        case COMMAND_LINE:
+            libps_renderer_sw_line(state,
+                                   &command->vertices[0],
+                                   &command->vertices[1]);
+            break;
+    }
+}
+
+// Draws every primitive queued in tile `tile`, in submission order.
+static void draw_tile(struct renderer* renderer, const unsigned int tile)
+{
+    const int32_t tile_x1 = (tile % TILES_X) * TILE_SIZE;
+    const int32_t tile_y1 = (tile / TILES_X) * TILE_SIZE;
+    const int32_t tile_x2 = tile_x1 + (TILE_SIZE - 1);
+    const int32_t tile_y2 = tile_y1 + (TILE_SIZE - 1);
+
+    const uint16_t* bin = &renderer->bins[tile * MAX_COMMANDS];
+
+    for (unsigned int i = 0; i < renderer->bin_count[tile]; ++i)
+    {
+        const struct command* command = &renderer->commands[bin[i]];
+
+        // Restricting the clip rectangle to the tile keeps threads from ever
+        // writing the same pixel.
+        struct libps_renderer_sw_state state = command->state;
+
+        state.clip_x1 = LIBPS_MAX(state.clip_x1, tile_x1);
+        state.clip_y1 = LIBPS_MAX(state.clip_y1, tile_y1);
+        state.clip_x2 = LIBPS_MIN(state.clip_x2, tile_x2);
+        state.clip_y2 = LIBPS_MIN(state.clip_y2, tile_y2);
+
+        if (state.masked_pixels)
+        {
+            state.masked_pixels = &renderer->masked_pixels[tile];
+        }
+
+        draw_command(command, &state);
+
+        // The same tile of the upscaled VRAM belongs to this thread as well.
+        struct libps_renderer_sw_state upscaled;
+
+        if (libps_renderer_sw_upscale_state(renderer->gpu, &state, &upscaled))
+        {
+            draw_command(command, &upscaled);
+        }
+    }
+}
+
+// Draws tiles of the current batch until there are none left.
+static void draw_tiles(struct renderer* renderer)
+{
+    for (;;)
+    {
+        libps_mutex_lock(&renderer->mutex);
+        const unsigned int tile = renderer->next_tile;
+
+        if (tile >= TILE_COUNT)
+        {
+            libps_mutex_unlock(&renderer->mutex);
+            return;
+        }
+
+        renderer->next_tile++;
+        libps_mutex_unlock(&renderer->mutex);
+
+        draw_tile(renderer, tile);
+
+        libps_mutex_lock(&renderer->mutex);
+
+        if (++renderer->tiles_done == TILE_COUNT)
+        {
+            libps_cond_signal(&renderer->work_done);
+        }
+        libps_mutex_unlock(&renderer->mutex);
+    }
+}
+
+static void worker_main(void* arg)
+{
+    struct renderer* renderer = arg;
+
+    libps_mutex_lock(&renderer->mutex);
+    unsigned int batch = renderer->batch;
+
+    for (;;)
+    {
+        while (!renderer->quit && (renderer->batch == batch))
+        {
+            libps_cond_wait(&renderer->work_ready, &renderer->mutex);
+        }
+
+        if (renderer->quit)
+        {
+            break;
+        }
+
+        batch = renderer->batch;
+        libps_mutex_unlock(&renderer->mutex);
+
+        draw_tiles(renderer);
+
+        libps_mutex_lock(&renderer->mutex);
+    }
+    libps_mutex_unlock(&renderer->mutex);
+}
+
+// Draws every queued primitive and waits for the drawing to finish.
+static void flush(struct renderer* renderer)
+{
+    if (renderer->command_count == 0)
+    {
+        return;
+    }
+
+    libps_mutex_lock(&renderer->mutex);
+
+    renderer->next_tile  = 0;
+    renderer->tiles_done = 0;
+    renderer->batch++;
+
+    libps_cond_broadcast(&renderer->work_ready);
+    libps_mutex_unlock(&renderer->mutex);
+
+    // The submitting thread would otherwise sit idle, so it draws too.
+    draw_tiles(renderer);
+
+    libps_mutex_lock(&renderer->mutex);
+
+    while (renderer->tiles_done != TILE_COUNT)
+    {
+        libps_cond_wait(&renderer->work_done, &renderer->mutex);
+    }
+    libps_mutex_unlock(&renderer->mutex);
+
+    renderer->command_count = 0;
+
+    for (unsigned int tile = 0; tile < TILE_COUNT; ++tile)
+    {
+        renderer->gpu->stats.pixels_masked += renderer->masked_pixels[tile];
+
+        renderer->bin_count[tile]     = 0;
+        renderer->masked_pixels[tile] = 0;
+    }
+}
+
+// Computes the tiles covered by the inclusive VRAM rectangle (`x1`, `y1`) -
+// (`x2`, `y2`). Returns `false` if the rectangle is empty.
+static bool get_tiles(int32_t x1,
+                      int32_t y1,
+                      int32_t x2,
+                      int32_t y2,
+                      struct tile_rect* tiles)
+{
+    x1 = LIBPS_MAX(x1, 0);
+    y1 = LIBPS_MAX(y1, 0);
+    x2 = LIBPS_MIN(x2, LIBPS_GPU_VRAM_WIDTH - 1);
+    y2 = LIBPS_MIN(y2, LIBPS_GPU_VRAM_HEIGHT - 1);
+
+    if ((x1 > x2) || (y1 > y2))
+    {
+        return false;
+    }
+
+    tiles->x1 = x1 / TILE_SIZE;
+    tiles->y1 = y1 / TILE_SIZE;
+    tiles->x2 = x2 / TILE_SIZE;
+    tiles->y2 = y2 / TILE_SIZE;
+
+    return true;
+}
+
+// Queues a primitive covering the VRAM rectangle (`x1`, `y1`) - (`x2`, `y2`)
+// (before clipping). Textured primitives are drawn with texture page
+// `texpage` and palette `palette`. Returns the queued command, or `NULL` if
+// the primitive is entirely clipped.
+static struct command* submit(struct libps_gpu* gpu,
+                              const enum command_type type,
+                              const struct libps_gpu_vertex* const vertices,
+                              const unsigned int vertex_count,
+                              const uint16_t texpage,
+                              const uint16_t palette,
+                              const int32_t x1,
+                              const int32_t y1,
+                              const int32_t x2,
+                              const int32_t y2)
+{
+    struct renderer* renderer = gpu->renderer_data;
+
+    struct libps_renderer_sw_state state;
+    libps_renderer_sw_get_state(gpu, &state);
+
+    // The pointer only tells the tiles to count, see `draw_tile()`.
+    if (gpu->stats_enabled)
+    {
+        state.masked_pixels = &gpu->stats.pixels_masked;
+    }
+
+    struct tile_rect tiles;
+
+    if (!get_tiles(LIBPS_MAX(x1, state.clip_x1),
+                   LIBPS_MAX(y1, state.clip_y1),
+                   LIBPS_MIN(x2, state.clip_x2),
+                   LIBPS_MIN(y2, state.clip_y2),
+                   &tiles))
+    {
+        return NULL;
+    }
+
+    if (renderer->command_count == MAX_COMMANDS)
+    {
+        flush(renderer);
+    }
+
+    // Textures are sampled from decoded copies, so queued primitives never
+    // read VRAM. Decoding can however overwrite a copy queued primitives
+    // still use, or read VRAM queued primitives are yet to draw to, so that
+    // has to wait for them.
+    if (state.flags & DRAW_FLAG_TEXTURED)
+    {
+        state.texture =
+        libps_renderer_sw_texture_cache_find(gpu->texture_cache,
+                                             gpu,
+                                             texpage,
+                                             palette);
+        if (!state.texture)
+        {
+            flush(renderer);
+
+            state.texture =
+            libps_renderer_sw_texture_cache_load(gpu->texture_cache,
+                                                 gpu,
+                                                 texpage,
+                                                 palette);
+        }
+    }
+
+    const unsigned int index = renderer->command_count++;
+    struct command* command  = &renderer->commands[index];
+
+    command->type  = type;
+    command->state = state;
+
+    for (unsigned int i = 0; i < vertex_count; ++i)
+    {
+        command->vertices[i] = vertices[i];
+    }
+
+    for (unsigned int y = tiles.y1; y <= tiles.y2; ++y)
+    {
+        for (unsigned int x = tiles.x1; x <= tiles.x2; ++x)
+        {
+            const unsigned int tile = x + (y * TILES_X);
+
+            renderer->bins[(tile * MAX_COMMANDS) + renderer->bin_count[tile]++] =
+            index;
+        }
+    }
+    return command;
+}
+
+static void draw_polygon(struct libps_gpu* gpu,
+                         const struct libps_gpu_vertex* const v0,
+                         struct libps_gpu_vertex* const v1,
+                         struct libps_gpu_vertex* const v2)
+{
+    assert(gpu != NULL);
+    assert(v0 != NULL);
+    assert(v1 != NULL);
+    assert(v2 != NULL);
+
+    const struct libps_gpu_vertex vertices[3] = { *v0, *v1, *v2 };
+
+    const int32_t x1 = LIBPS_MIN(v0->x, LIBPS_MIN(v1->x, v2->x));
+    const int32_t y1 = LIBPS_MIN(v0->y, LIBPS_MIN(v1->y, v2->y));
+    const int32_t x2 = LIBPS_MAX(v0->x, LIBPS_MAX(v1->x, v2->x));
+    const int32_t y2 = LIBPS_MAX(v0->y, LIBPS_MAX(v1->y, v2->y));
+
+    submit(gpu,
+           COMMAND_TRIANGLE,
+           vertices,
+           3,
+           v1->texpage,
+           v0->palette,
+           x1 + gpu->drawing_offset_x,
+           y1 + gpu->drawing_offset_y,
+           x2 + gpu->drawing_offset_x,
+           y2 + gpu->drawing_offset_y);
+}
+
+static void draw_quad(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertices)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    int32_t x1 = vertices[0].x;
+    int32_t y1 = vertices[0].y;
+    int32_t x2 = vertices[0].x;
+    int32_t y2 = vertices[0].y;
+
+    for (unsigned int i = 1; i < 4; ++i)
+    {
+        x1 = LIBPS_MIN(x1, vertices[i].x);
+        y1 = LIBPS_MIN(y1, vertices[i].y);
+        x2 = LIBPS_MAX(x2, vertices[i].x);
+        y2 = LIBPS_MAX(y2, vertices[i].y);
+    }
+
+    submit(gpu,
+           COMMAND_QUAD,
+           vertices,
+           4,
+           vertices[0].texpage,
+           vertices[0].palette,
+           x1 + gpu->drawing_offset_x,
+           y1 + gpu->drawing_offset_y,
+           x2 + gpu->drawing_offset_x,
+           y2 + gpu->drawing_offset_y);
+}
+
+static void draw_rect(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertex,
+                      const unsigned int width,
+                      const unsigned int height)
+{
+    assert(gpu != NULL);
+    assert(vertex != NULL);
+
+    const int32_t x = vertex->x + gpu->drawing_offset_x;
+    const int32_t y = vertex->y + gpu->drawing_offset_y;
+
+    struct command* command = submit(gpu,
+                                     COMMAND_SPRITE,
+                                     vertex,
+                                     1,
+                                     vertex->texpage,
+                                     vertex->palette,
+                                     x,
+                                     y,
+                                     x + (int32_t)width - 1,
+                                     y + (int32_t)height - 1);
+    if (command)
+    {
+        command->width  = width;
+        command->height = height;
+    }
+}
+
+// Each line of a polyline is queued on its own, so that it is only binned
+// to the tiles it actually touches.
+static void draw_line(struct libps_gpu* gpu,
+                      const struct libps_gpu_vertex* const vertices,
+                      const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(vertices != NULL);
+
+    for (unsigned int i = 1; i < count; ++i)
+    {
+        const struct libps_gpu_vertex* const v0 = &vertices[i - 1];
+        const struct libps_gpu_vertex* const v1 = &vertices[i];
+
+        const int32_t x1 = LIBPS_MIN(v0->x, v1->x);
+        const int32_t y1 = LIBPS_MIN(v0->y, v1->y);
+        const int32_t x2 = LIBPS_MAX(v0->x, v1->x);
+        const int32_t y2 = LIBPS_MAX(v0->y, v1->y);
+
+        submit(gpu,
+               COMMAND_LINE,
+               &vertices[i - 1],
+               2,
+               0,
+               0,
+               x1 + gpu->drawing_offset_x,
+               y1 + gpu->drawing_offset_y,
+               x2 + gpu->drawing_offset_x,
+               y2 + gpu->drawing_offset_y);
+    }
+}
+
+static void sync(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+    flush(gpu->renderer_data);
+}
+
+// Finishes all queued drawing and stops the worker threads.
+static void cleanup(struct libps_gpu* gpu)
+{
+    assert(gpu != NULL);
+    assert(gpu->renderer_data != NULL);
+
+    struct renderer* renderer = gpu->renderer_data;
+
+    flush(renderer);
+
+    libps_mutex_lock(&renderer->mutex);
+    renderer->quit = true;
+    libps_cond_broadcast(&renderer->work_ready);
+    libps_mutex_unlock(&renderer->mutex);
+
+    for (unsigned int i = 0; i < renderer->worker_count; ++i)
+    {
+        libps_thread_join(&renderer->threads[i]);
+    }
+
+    libps_cond_destroy(&renderer->work_done);
+    libps_cond_destroy(&renderer->work_ready);
+    libps_mutex_destroy(&renderer->mutex);
+
+    if (renderer->threads)
+    {
+        libps_safe_free(renderer->threads);
+    }
+
+    libps_safe_free(renderer->bins);
+    libps_safe_free(renderer->commands);
+    libps_safe_free(renderer);
+
+    gpu->renderer_data = NULL;
+}
+
+static const struct libps_gpu_renderer mt_renderer =
+{
+    .draw_polygon = &draw_polygon,
+    .draw_quad    = &draw_quad,
+    .draw_rect    = &draw_rect,
+    .draw_line    = &draw_line,
+    .fill_rect    = &libps_renderer_sw_vram_fill,
+    .copy_rect    = &libps_renderer_sw_vram_copy,
+    .store_rect   = &libps_renderer_sw_vram_store,
+    .sync         = &sync,
+    .scanout      = &libps_renderer_sw_vram_scanout,
+    .cleanup      = &cleanup
+};
+
+// Makes `gpu` draw with the multi-threaded renderer using `thread_count`
+// threads in total, including the thread drawing is submitted from. The
+// renderer in use so far is cleaned up. The worker threads are stopped once
+// another renderer is set with `libps_gpu_set_renderer()`.
+void libps_renderer_sw_mt_setup(struct libps_gpu* gpu,
+                                const unsigned int thread_count)
+{
+    assert(gpu != NULL);
+    assert(thread_count != 0);
+
+    struct renderer* renderer = libps_safe_malloc(sizeof(struct renderer));
+
+    renderer->commands =
+    libps_safe_malloc(sizeof(struct command) * MAX_COMMANDS);
+
+    renderer->bins =
+    libps_safe_malloc(sizeof(uint16_t) * MAX_COMMANDS * TILE_COUNT);
+
+    renderer->gpu           = gpu;
+    renderer->command_count = 0;
+
+    for (unsigned int tile = 0; tile < TILE_COUNT; ++tile)
+    {
+        renderer->bin_count[tile]     = 0;
+        renderer->masked_pixels[tile] = 0;
+    }
+
+    libps_mutex_init(&renderer->mutex);
+    libps_cond_init(&renderer->work_ready);
+    libps_cond_init(&renderer->work_done);
+
+    renderer->batch      = 0;
+    renderer->next_tile  = TILE_COUNT;
+    renderer->tiles_done = TILE_COUNT;
+    renderer->quit       = false;
+
+    renderer->worker_count = thread_count - 1;
+    renderer->threads      = NULL;
+
+    if (renderer->worker_count != 0)
+    {
+        renderer->threads =
+        libps_safe_malloc(sizeof(libps_thread) * renderer->worker_count);
+
+        for (unsigned int i = 0; i < renderer->worker_count; ++i)
+        {
+            libps_thread_create(&renderer->threads[i], worker_main, renderer);
+        }
+    }
+
+    libps_gpu_set_renderer(gpu, &mt_renderer, renderer);
+}
@@ -0,0 +1,42 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Multi-threaded software renderer. Primitives are not drawn when they are
+// submitted; they are binned into 64x64 tiles of VRAM, and the tiles are
+// later drawn in parallel by a pool of worker threads. Each tile draws its
+// primitives in submission order, so the result is identical to drawing
+// everything on one thread.
+//
+// Queued primitives are flushed when a texture page has to be decoded, when
+// the queue is full, and when the GPU syncs before accessing VRAM directly.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+struct libps_gpu;
+
+// Makes `gpu` draw with the multi-threaded renderer using `thread_count`
+// threads in total, including the thread drawing is submitted from. The
+// renderer in use so far is cleaned up. The worker threads are stopped once
+// another renderer is set with `libps_gpu_set_renderer()`.
+void libps_renderer_sw_mt_setup(struct libps_gpu* gpu,
+                                const unsigned int thread_count);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
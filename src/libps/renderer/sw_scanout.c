@@ -0,0 +1,196 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "sw_scanout.h"
+#include "../utility/host_cpu.h"
+#include "../utility/math.h"
+
+#ifdef LIBPS_HOST_X86_64
+#include <emmintrin.h>
+#endif // LIBPS_HOST_X86_64
+
+// Black in both of the scanout formats
+#define BLACK 0xFF000000
+
+typedef void (*convert_fn)(uint32_t* dst,
+                           const uint16_t* src,
+                           const unsigned int count,
+                           const bool rgba);
+
+// Expands the 5-bit color component `c` to 8 bits.
+static inline uint32_t expand5(const uint32_t c)
+{
+    return (c << 3) | (c >> 2);
+}
+
+// Returns the 8-bit color components `r`, `g` and `b` as an XRGB8888 pixel,
+// or as an RGBA8888 pixel if `rgba` is `true`.
+static inline uint32_t pack(const uint32_t r,
+                            const uint32_t g,
+                            const uint32_t b,
+                            const bool rgba)
+{
+    return rgba ? (BLACK | (b << 16) | (g << 8) | r) :
+                  (BLACK | (r << 16) | (g << 8) | b);
+}
+
+// Converts `count` 15-bit pixels from `src` and stores them in `dst`.
+static void convert_15bit(uint32_t* dst,
+                          const uint16_t* src,
+                          const unsigned int count,
+                          const bool rgba)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        dst[i] = pack(expand5(src[i] & 0x1F),
+                      expand5((src[i] >> 5) & 0x1F),
+                      expand5((src[i] >> 10) & 0x1F),
+                      rgba);
+    }
+}
+
+#ifdef LIBPS_HOST_X86_64
+// Expands the 5-bit color components in each lane of `c` to 8 bits.
+static inline __m128i expand5_sse2(const __m128i c)
+{
+    return _mm_or_si128(_mm_slli_epi16(c, 3), _mm_srli_epi16(c, 2));
+}
+
+// Converts `count` 15-bit pixels from `src` and stores them in `dst`, eight
+// pixels at a time.
+static void convert_15bit_sse2(uint32_t* dst,
+                               const uint16_t* src,
+                               const unsigned int count,
+                               const bool rgba)
+{
+    const __m128i mask5 = _mm_set1_epi16(0x1F);
+    const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+
+    unsigned int i = 0;
+
+    for (; (i + 8) <= count; i += 8)
+    {
+        const __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+
+        const __m128i r = expand5_sse2(_mm_and_si128(pixels, mask5));
+
+        const __m128i g =
+        expand5_sse2(_mm_and_si128(_mm_srli_epi16(pixels, 5), mask5));
+
+        const __m128i b =
+        expand5_sse2(_mm_and_si128(_mm_srli_epi16(pixels, 10), mask5));
+
+        // The low and high 16 bits of each output pixel
+        const __m128i low  = _mm_or_si128(_mm_slli_epi16(g, 8), rgba ? r : b);
+        const __m128i high = _mm_or_si128(alpha, rgba ? b : r);
+
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(low, high));
+
+        _mm_storeu_si128((__m128i*)(dst + i + 4),
+                         _mm_unpackhi_epi16(low, high));
+    }
+    convert_15bit(dst + i, src + i, count - i, rgba);
+}
+#endif // LIBPS_HOST_X86_64
+
+// Converts `count` 24-bit pixels starting at 16-bit unit `x` of the VRAM row
+// `row` and stores them in `dst`. The pixels wrap around the right edge of
+// VRAM.
+static void convert_24bit(uint32_t* dst,
+                          const uint16_t* row,
+                          const unsigned int x,
+                          const unsigned int count,
+                          const bool rgba)
+{
+    // Returns byte `n` of `row`.
+#define BYTE(n)                                                              \
+((row[((n) / 2) % LIBPS_GPU_VRAM_WIDTH] >> (((n) % 2) * 8)) & 0xFF)
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const unsigned int n = (x * 2) + (i * 3);
+
+        dst[i] = pack(BYTE(n), BYTE(n + 1), BYTE(n + 2), rgba);
+    }
+#undef BYTE
+}
+
+// Converts the display area `area` of `vram` to `format` and stores it in
+// `pixels`, which must have room for `area->height * area->scale` rows of
+// `stride` pixels each. `vram` is upscaled by `area->scale`.
+void libps_renderer_sw_scanout(const uint16_t* vram,
+                               const struct libps_gpu_display_area* area,
+                               uint32_t* pixels,
+                               const unsigned int stride,
+                               const enum libps_gpu_scanout_format format)
+{
+    assert(vram != NULL);
+    assert(area != NULL);
+    assert(pixels != NULL);
+    assert(area->scale >= 1);
+    assert(!area->color_24bit || (area->scale == 1));
+    assert(stride >= (area->width * area->scale));
+
+    const bool rgba = (format == LIBPS_GPU_SCANOUT_RGBA8888);
+
+    convert_fn convert = &convert_15bit;
+
+#ifdef LIBPS_HOST_X86_64
+    if (libps_host_cpu_has_sse2())
+    {
+        convert = &convert_15bit_sse2;
+    }
+#endif // LIBPS_HOST_X86_64
+
+    const unsigned int vram_width  = LIBPS_GPU_VRAM_WIDTH * area->scale;
+    const unsigned int vram_height = LIBPS_GPU_VRAM_HEIGHT * area->scale;
+
+    const unsigned int x      = area->x * area->scale;
+    const unsigned int width  = area->width * area->scale;
+    const unsigned int height = area->height * area->scale;
+
+    // A row of 15-bit pixels wraps around the right edge of VRAM at most
+    // once.
+    const unsigned int first = LIBPS_MIN(width, vram_width - x);
+
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        uint32_t* dst = &pixels[y * stride];
+
+        if (area->disabled)
+        {
+            for (unsigned int i = 0; i < width; ++i)
+            {
+                dst[i] = BLACK;
+            }
+            continue;
+        }
+
+        const uint16_t* row =
+        &vram[vram_width * (((area->y * area->scale) + y) % vram_height)];
+
+        if (area->color_24bit)
+        {
+            convert_24bit(dst, row, x, width, rgba);
+        }
+        else
+        {
+            convert(dst, &row[x], first, rgba);
+            convert(dst + first, row, width - first, rgba);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Conversion of the display area of VRAM into 32-bit pixels for the host to
+// present.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdint.h>
+#include "gpu.h"
+
+// Converts the display area `area` of `vram` to `format` and stores it in
+// `pixels`, which must have room for `area->height * area->scale` rows of
+// `stride` pixels each. `vram` is upscaled by `area->scale`.
+void libps_renderer_sw_scanout(const uint16_t* vram,
+                               const struct libps_gpu_display_area* area,
+                               uint32_t* pixels,
+                               const unsigned int stride,
+                               const enum libps_gpu_scanout_format format);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
@@ -0,0 +1,238 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "sw_span.h"
+#include "sw_texture.h"
+#include "../utility/math.h"
+
+// Combines the 5-bit colour components `back` (already in VRAM) and `front`
+// (being drawn) with semi-transparency mode `mode`.
+LIBPS_RENDERER_SW_SPECIALIZE unsigned int
+blend_component(const int back, const int front, const unsigned int mode)
+{
+    switch (mode)
+    {
+        case 0:
+            return (back + front) / 2;
+
+        case 1:
+            return LIBPS_MIN(back + front, 31);
+
+        case 2:
+            return LIBPS_MAX(back - front, 0);
+
+        default:
+            return LIBPS_MIN(back + (front / 4), 31);
+    }
+}
+
+// Combines the pixels `back` (already in VRAM) and `front` (being drawn) with
+// semi-transparency mode `mode`. Bit 15 of the result is clear.
+LIBPS_RENDERER_SW_SPECIALIZE uint16_t
+blend_pixel(const uint16_t back, const uint16_t front, const unsigned int mode)
+{
+    const unsigned int r =
+    blend_component(back & 0x1F, front & 0x1F, mode);
+
+    const unsigned int g =
+    blend_component((back >> 5) & 0x1F, (front >> 5) & 0x1F, mode);
+
+    const unsigned int b =
+    blend_component((back >> 10) & 0x1F, (front >> 10) & 0x1F, mode);
+
+    return (uint16_t)(r | (g << 5) | (b << 10));
+}
+
+// Returns what pixel `back` becomes when `front` is drawn over it as
+// described by `blend`.
+LIBPS_RENDERER_SW_SPECIALIZE uint16_t
+output_pixel(const uint16_t back,
+             uint16_t front,
+             const struct libps_renderer_sw_blend* blend)
+{
+    if (back & blend->mask_check)
+    {
+        return back;
+    }
+
+    if (blend->textured)
+    {
+        if (front == 0x0000)
+        {
+            return back;
+        }
+
+        if (blend->semi_transparent && (front & 0x8000))
+        {
+            front = blend_pixel(back, front, blend->mode) | 0x8000;
+        }
+    }
+    else if (blend->semi_transparent)
+    {
+        front = blend_pixel(back, front, blend->mode);
+    }
+    return front | blend->mask_set;
+}
+
+// Returns what pixel `back` becomes when `front` is drawn over it as
+// described by `blend`.
+uint16_t libps_renderer_sw_output_pixel(const uint16_t back,
+                                        const uint16_t front,
+                                        const struct libps_renderer_sw_blend*
+                                        blend)
+{
+    assert(blend != NULL);
+    return output_pixel(back, front, blend);
+}
+
+// Draws every covered pixel of `span`, one pixel at a time.
+LIBPS_RENDERER_SW_SPECIALIZE void
+draw_span(const struct libps_renderer_sw_span* span,
+          const bool textured,
+          const bool semi_transparent,
+          const unsigned int mode,
+          const bool mask_check)
+{
+    assert(span != NULL);
+    assert(!textured || (span->texture != NULL));
+
+    const struct libps_renderer_sw_blend blend =
+    {
+        .semi_transparent = semi_transparent,
+        .mode             = mode,
+        .textured         = textured,
+        .mask_set         = span->mask_set,
+        .mask_check       = mask_check ? 0x8000 : 0x0000
+    };
+
+    int32_t w0 = span->w0;
+    int32_t w1 = span->w1;
+    int32_t w2 = span->w2;
+
+    uint32_t r = span->r;
+    uint32_t g = span->g;
+    uint32_t b = span->b;
+    uint32_t u = span->u;
+    uint32_t v = span->v;
+
+    for (unsigned int i = 0; i < span->count; ++i)
+    {
+        if ((w0 | w1 | w2) >= 0)
+        {
+            const uint16_t front = textured ?
+            span->texture[libps_renderer_sw_texel_offset(span, u, v)] :
+            libps_renderer_sw_pack_color(r, g, b);
+
+            span->pixels[i] = output_pixel(span->pixels[i], front, &blend);
+        }
+
+        w0 += span->w0_dx;
+        w1 += span->w1_dx;
+        w2 += span->w2_dx;
+
+        if (textured)
+        {
+            u += span->u_dx;
+            v += span->v_dx;
+        }
+        else
+        {
+            r += span->r_dx;
+            g += span->g_dx;
+            b += span->b_dx;
+        }
+    }
+}
+
+// Draws the `count` pixels `front` over `pixels`, one pixel at a time.
+LIBPS_RENDERER_SW_SPECIALIZE void
+draw_row(uint16_t* pixels,
+         const uint16_t* front,
+         const unsigned int count,
+         const uint16_t mask_set,
+         const bool textured,
+         const bool semi_transparent,
+         const unsigned int mode,
+         const bool mask_check)
+{
+    assert(pixels != NULL);
+    assert(front != NULL);
+
+    const struct libps_renderer_sw_blend blend =
+    {
+        .semi_transparent = semi_transparent,
+        .mode             = mode,
+        .textured         = textured,
+        .mask_set         = mask_set,
+        .mask_check       = mask_check ? 0x8000 : 0x0000
+    };
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        pixels[i] = output_pixel(pixels[i], front[i], &blend);
+    }
+}
+
+#define SPAN_NAME(textured, semi_transparent, mode, mask_check)              \
+span_##textured##_##semi_transparent##_##mode##_##mask_check
+
+#define DEFINE_SPAN(textured, semi_transparent, mode, mask_check)            \
+static void SPAN_NAME(textured, semi_transparent, mode, mask_check)          \
+(const struct libps_renderer_sw_span* span)                                  \
+{                                                                            \
+    draw_span(span, textured, semi_transparent, mode, mask_check);           \
+}
+
+#define SPAN_ENTRY(textured, semi_transparent, mode, mask_check)             \
+[LIBPS_RENDERER_SW_SPAN_INDEX(textured, semi_transparent, mode,              \
+                              mask_check)] =                                 \
+&SPAN_NAME(textured, semi_transparent, mode, mask_check),
+
+#define ROW_NAME(textured, semi_transparent, mode, mask_check)               \
+row_##textured##_##semi_transparent##_##mode##_##mask_check
+
+#define DEFINE_ROW(textured, semi_transparent, mode, mask_check)             \
+static void ROW_NAME(textured, semi_transparent, mode, mask_check)           \
+(uint16_t* pixels,                                                           \
+ const uint16_t* front,                                                      \
+ const unsigned int count,                                                   \
+ const uint16_t mask_set)                                                    \
+{                                                                            \
+    draw_row(pixels, front, count, mask_set,                                 \
+             textured, semi_transparent, mode, mask_check);                  \
+}
+
+#define ROW_ENTRY(textured, semi_transparent, mode, mask_check)              \
+[LIBPS_RENDERER_SW_SPAN_INDEX(textured, semi_transparent, mode,              \
+                              mask_check)] =                                 \
+&ROW_NAME(textured, semi_transparent, mode, mask_check),
+
+LIBPS_RENDERER_SW_SPANS(DEFINE_SPAN)
+LIBPS_RENDERER_SW_SPANS(DEFINE_ROW)
+
+// Portable span functions
+const libps_renderer_sw_span_fn
+libps_renderer_sw_spans_scalar[LIBPS_RENDERER_SW_SPAN_VARIANTS] =
+{
+    LIBPS_RENDERER_SW_SPANS(SPAN_ENTRY)
+};
+
+// Portable row functions
+const libps_renderer_sw_row_fn
+libps_renderer_sw_rows_scalar[LIBPS_RENDERER_SW_SPAN_VARIANTS] =
+{
+    LIBPS_RENDERER_SW_SPANS(ROW_ENTRY)
+};
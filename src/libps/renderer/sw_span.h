@@ -0,0 +1,226 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Span functions draw one row of a triangle at a time. The triangle setup in
+// sw.c computes the edge functions and the 16.16 fixed-point interpolants at
+// the first pixel of the row and how much they change per pixel; a span
+// function only has to step them, test coverage and write pixels.
+//
+// Nothing about how the pixels are drawn changes within a primitive, so
+// rather than testing the drawing state for every pixel, each span function
+// is written once as an inline function taking that state as constants, and
+// instantiated for every combination of it. The triangle setup picks one per
+// primitive from a table. There is a portable scalar table, and SIMD tables
+// which are selected at runtime depending on what the host CPU supports.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "../utility/host_cpu.h"
+
+struct libps_renderer_sw_span
+{
+    // First pixel of the row
+    uint16_t* pixels;
+
+    // Number of pixels in the row
+    unsigned int count;
+
+    // Edge functions at the first pixel, biased by the fill rule so that a
+    // pixel is covered if all of them are >= 0, and their per pixel steps.
+    int32_t w0, w1, w2;
+    int32_t w0_dx, w1_dx, w2_dx;
+
+    // Colour (0..255) and texture coordinates (0..255) at the first pixel in
+    // 16.16 fixed point, and their per pixel steps. These use wrapping
+    // arithmetic; they are only meaningful where the pixel is covered.
+    uint32_t r, g, b;
+    uint32_t r_dx, g_dx, b_dx;
+
+    uint32_t u, v;
+    uint32_t u_dx, v_dx;
+
+    // Decoded texture page of textured primitives, see `sw_texture.h`
+    const uint16_t* texture;
+
+    // Texture window (GP0(E2h)). The texel at the texture coordinate (u, v)
+    // is the one at offset `(u & window_u_and) | ((v & window_v_and) << 8) |
+    // window_or` of `texture`, so the window costs nothing beyond the masking
+    // of the coordinates to 8 bits which is needed anyway.
+    uint32_t window_u_and;
+    uint32_t window_v_and;
+    uint32_t window_or;
+
+    // 0x8000 to set the mask bit of every pixel drawn, 0 otherwise
+    uint16_t mask_set;
+};
+
+// How the pixels of a primitive are combined with the pixels already in VRAM
+struct libps_renderer_sw_blend
+{
+    // Is the primitive semi-transparent?
+    bool semi_transparent;
+
+    // Semi-transparency mode (GP0(E1h) bits 5-6): 0 is B/2+F/2, 1 is B+F, 2
+    // is B-F and 3 is B+F/4.
+    unsigned int mode;
+
+    // Are the pixels texels? Texels of 0x0000 are not drawn, and only texels
+    // with bit 15 set are semi-transparent. The mask bit of the other pixels
+    // comes from `mask_set` alone.
+    bool textured;
+
+    // 0x8000 to set the mask bit of every pixel drawn, 0 otherwise
+    uint16_t mask_set;
+
+    // 0x8000 to leave pixels whose mask bit is set alone, 0 otherwise
+    uint16_t mask_check;
+};
+
+// Draws every covered pixel of `span`.
+typedef void (*libps_renderer_sw_span_fn)
+(const struct libps_renderer_sw_span* span);
+
+// Draws the `count` pixels `front` over `pixels`. `mask_set` is 0x8000 to set
+// the mask bit of every pixel drawn, 0 otherwise. Row functions draw
+// rectangles, which need no coverage test; they are specialized and indexed
+// exactly like span functions.
+typedef void (*libps_renderer_sw_row_fn)(uint16_t* pixels,
+                                         const uint16_t* front,
+                                         const unsigned int count,
+                                         const uint16_t mask_set);
+
+// Number of span (or row) functions in a table
+#define LIBPS_RENDERER_SW_SPAN_VARIANTS 20
+
+// Returns the index in a span (or row) function table of the function
+// drawing textured (or Gouraud shaded) pixels, semi-transparent with mode
+// `mode` (or opaque) and checking the mask bit (or not). This is a constant
+// expression if the arguments are.
+#define LIBPS_RENDERER_SW_SPAN_INDEX(textured, semi_transparent, mode,       \
+                                     mask_check)                             \
+(((textured) ? 1 : 0) + (2 * ((semi_transparent) ? (1 + (mode)) : 0)) +      \
+ ((mask_check) ? 10 : 0))
+
+// Invokes `X(textured, semi_transparent, mode, mask_check)` once for every
+// span function in a table. The arguments are 0 or 1 (or the mode) rather
+// than `false` and `true`, so that they can be pasted into function names.
+#define LIBPS_RENDERER_SW_SPANS_TEXTURED(X, semi_transparent, mode,          \
+                                         mask_check)                         \
+X(0, semi_transparent, mode, mask_check)                                     \
+X(1, semi_transparent, mode, mask_check)
+
+#define LIBPS_RENDERER_SW_SPANS_BLENDED(X, mask_check)                       \
+LIBPS_RENDERER_SW_SPANS_TEXTURED(X, 0, 0, mask_check)                        \
+LIBPS_RENDERER_SW_SPANS_TEXTURED(X, 1, 0, mask_check)                        \
+LIBPS_RENDERER_SW_SPANS_TEXTURED(X, 1, 1, mask_check)                        \
+LIBPS_RENDERER_SW_SPANS_TEXTURED(X, 1, 2, mask_check)                        \
+LIBPS_RENDERER_SW_SPANS_TEXTURED(X, 1, 3, mask_check)
+
+#define LIBPS_RENDERER_SW_SPANS(X)                                           \
+LIBPS_RENDERER_SW_SPANS_BLENDED(X, 0)                                        \
+LIBPS_RENDERER_SW_SPANS_BLENDED(X, 1)
+
+// Span functions are written as inline functions which are instantiated by
+// `LIBPS_RENDERER_SW_SPANS`, and which must really be inlined for the drawing
+// state they are instantiated with to be constant.
+#define LIBPS_RENDERER_SW_SPECIALIZE                                         \
+static inline __attribute__((always_inline))
+
+// Returns the offset into `span->texture` of the texel at the 16.16
+// fixed-point texture coordinate (`u`, `v`), within the texture window.
+static inline uint32_t
+libps_renderer_sw_texel_offset(const struct libps_renderer_sw_span* span,
+                               const uint32_t u,
+                               const uint32_t v)
+{
+    // LIBPS_RENDERER_SW_TEXTURE_SIZE is 256.
+    return ((u >> 16) & span->window_u_and)        |
+           (((v >> 16) & span->window_v_and) << 8) |
+           span->window_or;
+}
+
+// Returns the span beginning `n` pixels into `span`.
+static inline struct libps_renderer_sw_span
+libps_renderer_sw_span_advance(const struct libps_renderer_sw_span* span,
+                               const unsigned int n)
+{
+    struct libps_renderer_sw_span result = *span;
+
+    result.pixels += n;
+    result.count  -= n;
+
+    result.w0 += span->w0_dx * (int32_t)n;
+    result.w1 += span->w1_dx * (int32_t)n;
+    result.w2 += span->w2_dx * (int32_t)n;
+
+    result.r += span->r_dx * n;
+    result.g += span->g_dx * n;
+    result.b += span->b_dx * n;
+
+    result.u += span->u_dx * n;
+    result.v += span->v_dx * n;
+
+    return result;
+}
+
+// Converts 16.16 fixed-point colour components to a 15-bit pixel.
+static inline uint16_t libps_renderer_sw_pack_color(const uint32_t r,
+                                                    const uint32_t g,
+                                                    const uint32_t b)
+{
+    // G5B5R5A1
+    return (((g >> 19) & 0x1F) << 5)  |
+           (((b >> 19) & 0x1F) << 10) |
+            ((r >> 19) & 0x1F);
+}
+
+// Returns what pixel `back` becomes when `front` is drawn over it as
+// described by `blend`.
+uint16_t libps_renderer_sw_output_pixel(const uint16_t back,
+                                        const uint16_t front,
+                                        const struct libps_renderer_sw_blend*
+                                        blend);
+
+// Portable span and row functions (renderer/sw_span.c)
+extern const libps_renderer_sw_span_fn
+libps_renderer_sw_spans_scalar[LIBPS_RENDERER_SW_SPAN_VARIANTS];
+
+extern const libps_renderer_sw_row_fn
+libps_renderer_sw_rows_scalar[LIBPS_RENDERER_SW_SPAN_VARIANTS];
+
+#ifdef LIBPS_HOST_X86_64
+// SSE2 span and row functions (renderer/sw_sse2.c). Rows work on eight
+// 16-bit pixels, which is exactly one SSE2 register, so there are no AVX2
+// row functions.
+extern const libps_renderer_sw_span_fn
+libps_renderer_sw_spans_sse2[LIBPS_RENDERER_SW_SPAN_VARIANTS];
+
+extern const libps_renderer_sw_row_fn
+libps_renderer_sw_rows_sse2[LIBPS_RENDERER_SW_SPAN_VARIANTS];
+
+// AVX2 span functions (renderer/sw_avx2.c)
+extern const libps_renderer_sw_span_fn
+libps_renderer_sw_spans_avx2[LIBPS_RENDERER_SW_SPAN_VARIANTS];
+#endif // LIBPS_HOST_X86_64
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
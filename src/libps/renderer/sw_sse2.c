@@ -0,0 +1,325 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "sw_blend_sse2.h"
+#include "sw_span.h"
+#include "sw_texture.h"
+
+#ifdef LIBPS_HOST_X86_64
+#include <emmintrin.h>
+
+// Returns the four values `x`, `x + dx`, `x + 2dx` and `x + 3dx`.
+LIBPS_RENDERER_SW_SPECIALIZE __m128i ramp(const uint32_t x, const uint32_t dx)
+{
+    return _mm_setr_epi32((int)x,
+                          (int)(x + dx),
+                          (int)(x + (dx * 2)),
+                          (int)(x + (dx * 3)));
+}
+
+// Returns all ones in each lane where any of the edge functions is negative,
+// i.e. where the pixel is *not* covered.
+LIBPS_RENDERER_SW_SPECIALIZE __m128i
+uncovered(const __m128i w0, const __m128i w1, const __m128i w2)
+{
+    return _mm_srai_epi32(_mm_or_si128(_mm_or_si128(w0, w1), w2), 31);
+}
+
+// Converts four 16.16 fixed-point colours to 15-bit pixels in 32-bit lanes.
+LIBPS_RENDERER_SW_SPECIALIZE __m128i
+pack_color(const __m128i r, const __m128i g, const __m128i b)
+{
+    const __m128i mask = _mm_set1_epi32(0x1F);
+
+    const __m128i r5 = _mm_and_si128(_mm_srli_epi32(r, 19), mask);
+    const __m128i g5 = _mm_and_si128(_mm_srli_epi32(g, 19), mask);
+    const __m128i b5 = _mm_and_si128(_mm_srli_epi32(b, 19), mask);
+
+    // G5B5R5A1
+    return _mm_or_si128(_mm_or_si128(r5, _mm_slli_epi32(g5, 5)),
+                        _mm_slli_epi32(b5, 10));
+}
+
+// Texture window of a span in every lane, see `struct libps_renderer_sw_span`
+struct window
+{
+    __m128i u_and;
+    __m128i v_and;
+    __m128i bits;
+};
+
+// Returns the offsets into a decoded texture page of four 16.16 fixed-point
+// texture coordinates within texture window `window`, in 32-bit lanes.
+LIBPS_RENDERER_SW_SPECIALIZE __m128i texel_offset(const __m128i u,
+                                                  const __m128i v,
+                                                  const struct window* window)
+{
+    const __m128i u8 = _mm_and_si128(_mm_srli_epi32(u, 16), window->u_and);
+    const __m128i v8 = _mm_and_si128(_mm_srli_epi32(v, 16), window->v_and);
+
+    // LIBPS_RENDERER_SW_TEXTURE_SIZE is 256.
+    return _mm_or_si128(_mm_or_si128(u8, _mm_slli_epi32(v8, 8)),
+                        window->bits);
+}
+
+// Draws every covered pixel of `span`, eight pixels at a time.
+LIBPS_RENDERER_SW_SPECIALIZE void
+draw_span(const struct libps_renderer_sw_span* span,
+          const bool textured,
+          const bool semi_transparent,
+          const unsigned int mode,
+          const bool mask_check)
+{
+    assert(span != NULL);
+    assert(!textured || (span->texture != NULL));
+
+    const struct libps_renderer_sw_blend blend =
+    {
+        .semi_transparent = semi_transparent,
+        .mode             = mode,
+        .textured         = textured,
+        .mask_set         = span->mask_set,
+        .mask_check       = mask_check ? 0x8000 : 0x0000
+    };
+
+    // Pixels 0-3 and 4-7 of the current group of eight. `a0` to `a2` are
+    // the texture coordinates of textured spans and the colour of the others.
+    __m128i w0[2], w1[2], w2[2], a0[2], a1[2], a2[2];
+
+    for (unsigned int half = 0; half < 2; ++half)
+    {
+        const unsigned int n = half * 4;
+
+        w0[half] = ramp(span->w0 + (span->w0_dx * n), span->w0_dx);
+        w1[half] = ramp(span->w1 + (span->w1_dx * n), span->w1_dx);
+        w2[half] = ramp(span->w2 + (span->w2_dx * n), span->w2_dx);
+
+        if (textured)
+        {
+            a0[half] = ramp(span->u + (span->u_dx * n), span->u_dx);
+            a1[half] = ramp(span->v + (span->v_dx * n), span->v_dx);
+            a2[half] = _mm_setzero_si128();
+        }
+        else
+        {
+            a0[half] = ramp(span->r + (span->r_dx * n), span->r_dx);
+            a1[half] = ramp(span->g + (span->g_dx * n), span->g_dx);
+            a2[half] = ramp(span->b + (span->b_dx * n), span->b_dx);
+        }
+    }
+
+    const __m128i w0_step = _mm_set1_epi32(span->w0_dx * 8);
+    const __m128i w1_step = _mm_set1_epi32(span->w1_dx * 8);
+    const __m128i w2_step = _mm_set1_epi32(span->w2_dx * 8);
+
+    const __m128i a0_step =
+    _mm_set1_epi32((int)((textured ? span->u_dx : span->r_dx) * 8));
+
+    const __m128i a1_step =
+    _mm_set1_epi32((int)((textured ? span->v_dx : span->g_dx) * 8));
+
+    const __m128i a2_step =
+    _mm_set1_epi32(textured ? 0 : (int)(span->b_dx * 8));
+
+    const struct window window =
+    {
+        .u_and = _mm_set1_epi32((int)span->window_u_and),
+        .v_and = _mm_set1_epi32((int)span->window_v_and),
+        .bits  = _mm_set1_epi32((int)span->window_or)
+    };
+
+    unsigned int i = 0;
+
+    for (; (i + 8) <= span->count; i += 8)
+    {
+        const __m128i skip =
+        _mm_packs_epi32(uncovered(w0[0], w1[0], w2[0]),
+                        uncovered(w0[1], w1[1], w2[1]));
+
+        if (_mm_movemask_epi8(skip) != 0xFFFF)
+        {
+            __m128i front;
+
+            if (textured)
+            {
+                // SSE2 has no gather, so the texels are fetched one at a
+                // time. The offsets of uncovered pixels are still within
+                // the page.
+                uint32_t offsets[8];
+                uint16_t texels[8];
+
+                _mm_storeu_si128((__m128i*)&offsets[0],
+                                 texel_offset(a0[0], a1[0], &window));
+
+                _mm_storeu_si128((__m128i*)&offsets[4],
+                                 texel_offset(a0[1], a1[1], &window));
+
+                for (unsigned int lane = 0; lane < 8; ++lane)
+                {
+                    texels[lane] = span->texture[offsets[lane]];
+                }
+                front = _mm_loadu_si128((const __m128i*)texels);
+            }
+            else
+            {
+                front = _mm_packs_epi32(pack_color(a0[0], a1[0], a2[0]),
+                                        pack_color(a0[1], a1[1], a2[1]));
+            }
+
+            __m128i* dst = (__m128i*)(span->pixels + i);
+
+            const __m128i old  = _mm_loadu_si128(dst);
+            const __m128i draw = _mm_xor_si128(skip, _mm_set1_epi32(-1));
+
+            _mm_storeu_si128(dst,
+                             libps_renderer_sw_output_pixels_sse2(old,
+                                                                  front,
+                                                                  draw,
+                                                                  &blend));
+        }
+
+        for (unsigned int half = 0; half < 2; ++half)
+        {
+            w0[half] = _mm_add_epi32(w0[half], w0_step);
+            w1[half] = _mm_add_epi32(w1[half], w1_step);
+            w2[half] = _mm_add_epi32(w2[half], w2_step);
+
+            a0[half] = _mm_add_epi32(a0[half], a0_step);
+            a1[half] = _mm_add_epi32(a1[half], a1_step);
+            a2[half] = _mm_add_epi32(a2[half], a2_step);
+        }
+    }
+
+    // Every pixel of a group is stored back, so pixels past the end of the
+    // span (which may belong to another thread) are drawn one at a time.
+    if (i < span->count)
+    {
+        const struct libps_renderer_sw_span tail =
+        libps_renderer_sw_span_advance(span, i);
+
+        libps_renderer_sw_spans_scalar
+        [LIBPS_RENDERER_SW_SPAN_INDEX(textured,
+                                      semi_transparent,
+                                      mode,
+                                      mask_check)](&tail);
+    }
+}
+
+// Draws the `count` pixels `front` over `pixels`, eight pixels at a time.
+LIBPS_RENDERER_SW_SPECIALIZE void
+draw_row(uint16_t* pixels,
+         const uint16_t* front,
+         const unsigned int count,
+         const uint16_t mask_set,
+         const bool textured,
+         const bool semi_transparent,
+         const unsigned int mode,
+         const bool mask_check)
+{
+    assert(pixels != NULL);
+    assert(front != NULL);
+
+    const struct libps_renderer_sw_blend blend =
+    {
+        .semi_transparent = semi_transparent,
+        .mode             = mode,
+        .textured         = textured,
+        .mask_set         = mask_set,
+        .mask_check       = mask_check ? 0x8000 : 0x0000
+    };
+
+    const __m128i draw = _mm_set1_epi32(-1);
+
+    unsigned int i = 0;
+
+    for (; (i + 8) <= count; i += 8)
+    {
+        __m128i* dst = (__m128i*)(pixels + i);
+
+        const __m128i old   = _mm_loadu_si128(dst);
+        const __m128i color = _mm_loadu_si128((const __m128i*)(front + i));
+
+        _mm_storeu_si128(dst,
+                         libps_renderer_sw_output_pixels_sse2(old,
+                                                              color,
+                                                              draw,
+                                                              &blend));
+    }
+
+    if (i < count)
+    {
+        libps_renderer_sw_rows_scalar
+        [LIBPS_RENDERER_SW_SPAN_INDEX(textured,
+                                      semi_transparent,
+                                      mode,
+                                      mask_check)](pixels + i,
+                                                   front + i,
+                                                   count - i,
+                                                   mask_set);
+    }
+}
+
+#define SPAN_NAME(textured, semi_transparent, mode, mask_check)              \
+span_##textured##_##semi_transparent##_##mode##_##mask_check
+
+#define DEFINE_SPAN(textured, semi_transparent, mode, mask_check)            \
+static void SPAN_NAME(textured, semi_transparent, mode, mask_check)          \
+(const struct libps_renderer_sw_span* span)                                  \
+{                                                                            \
+    draw_span(span, textured, semi_transparent, mode, mask_check);           \
+}
+
+#define SPAN_ENTRY(textured, semi_transparent, mode, mask_check)             \
+[LIBPS_RENDERER_SW_SPAN_INDEX(textured, semi_transparent, mode,              \
+                              mask_check)] =                                 \
+&SPAN_NAME(textured, semi_transparent, mode, mask_check),
+
+#define ROW_NAME(textured, semi_transparent, mode, mask_check)               \
+row_##textured##_##semi_transparent##_##mode##_##mask_check
+
+#define DEFINE_ROW(textured, semi_transparent, mode, mask_check)             \
+static void ROW_NAME(textured, semi_transparent, mode, mask_check)           \
+(uint16_t* pixels,                                                           \
+ const uint16_t* front,                                                      \
+ const unsigned int count,                                                   \
+ const uint16_t mask_set)                                                    \
+{                                                                            \
+    draw_row(pixels, front, count, mask_set,                                 \
+             textured, semi_transparent, mode, mask_check);                  \
+}
+
+#define ROW_ENTRY(textured, semi_transparent, mode, mask_check)              \
+[LIBPS_RENDERER_SW_SPAN_INDEX(textured, semi_transparent, mode,              \
+                              mask_check)] =                                 \
+&ROW_NAME(textured, semi_transparent, mode, mask_check),
+
+LIBPS_RENDERER_SW_SPANS(DEFINE_SPAN)
+LIBPS_RENDERER_SW_SPANS(DEFINE_ROW)
+
+// SSE2 span functions
+const libps_renderer_sw_span_fn
+libps_renderer_sw_spans_sse2[LIBPS_RENDERER_SW_SPAN_VARIANTS] =
+{
+    LIBPS_RENDERER_SW_SPANS(SPAN_ENTRY)
+};
+
+// SSE2 row functions
+const libps_renderer_sw_row_fn
+libps_renderer_sw_rows_sse2[LIBPS_RENDERER_SW_SPAN_VARIANTS] =
+{
+    LIBPS_RENDERER_SW_SPANS(ROW_ENTRY)
+};
+#endif // LIBPS_HOST_X86_64
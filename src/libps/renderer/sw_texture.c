@@ -0,0 +1,306 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "gpu.h"
+#include "sw_texture.h"
+#include "../utility/memory.h"
+
+// GP0(E1h) bits selecting the texture page (0-4) and color depth (7-8)
+#define TEXPAGE_MASK 0x019F
+
+// Returns the color depth of texture page `texpage`: 0 for 4bpp, 1 for 8bpp
+// and 2 for 15bpp. The reserved setting behaves like 15bpp.
+static unsigned int texpage_depth(const uint16_t texpage)
+{
+    const unsigned int depth = (texpage >> 7) & 0x03;
+    return (depth == 3) ? 2 : depth;
+}
+
+// Returns `true` if any VRAM block in `width` blocks starting at column
+// `block_x`, and `height` blocks starting at row `block_y`, has been written
+// after `stamp`. Columns wrap around.
+static bool blocks_written(const struct libps_gpu* gpu,
+                           const unsigned int block_x,
+                           const unsigned int block_y,
+                           const unsigned int width,
+                           const unsigned int height,
+                           const uint64_t stamp)
+{
+    for (unsigned int y = block_y; y < (block_y + height); ++y)
+    {
+        for (unsigned int x = block_x; x < (block_x + width); ++x)
+        {
+            const unsigned int block = (x % LIBPS_GPU_VRAM_BLOCKS_X) +
+                                       (y * LIBPS_GPU_VRAM_BLOCKS_X);
+
+            if (gpu->vram_block_stamps[block] > stamp)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Returns `true` if VRAM the texels of `entry` were decoded from has been
+// written since.
+static bool is_stale(const struct libps_gpu* gpu,
+                     const struct libps_renderer_sw_texture* entry)
+{
+    // Texture pages are 64, 128 or 256 pixels wide depending on the color
+    // depth, and always 256 lines tall.
+    const unsigned int depth = texpage_depth(entry->texpage);
+
+    const unsigned int page_x = (entry->texpage & 0x0F) *
+                                (64 / LIBPS_GPU_VRAM_BLOCK_WIDTH);
+
+    const unsigned int page_y = ((entry->texpage & (1 << 4)) ? 256 : 0) /
+                                LIBPS_GPU_VRAM_BLOCK_HEIGHT;
+
+    if (blocks_written(gpu,
+                       page_x,
+                       page_y,
+                       (64 << depth) / LIBPS_GPU_VRAM_BLOCK_WIDTH,
+                       256 / LIBPS_GPU_VRAM_BLOCK_HEIGHT,
+                       entry->stamp))
+    {
+        return true;
+    }
+
+    if (depth == 2)
+    {
+        return false;
+    }
+
+    // The palette is a single line of 16 or 256 pixels.
+    const unsigned int clut_x = (entry->clut & 0x3F) * 16;
+    const unsigned int clut_y = (entry->clut >> 6) & 0x1FF;
+
+    const unsigned int clut_end = clut_x + ((depth == 0) ? 16 : 256) - 1;
+
+    return blocks_written(gpu,
+                          clut_x / LIBPS_GPU_VRAM_BLOCK_WIDTH,
+                          clut_y / LIBPS_GPU_VRAM_BLOCK_HEIGHT,
+                          (clut_end / LIBPS_GPU_VRAM_BLOCK_WIDTH) -
+                          (clut_x / LIBPS_GPU_VRAM_BLOCK_WIDTH) + 1,
+                          1,
+                          entry->stamp);
+}
+
+// Decodes the texels of `entry` from the VRAM of `gpu`.
+static void decode(const struct libps_gpu* gpu,
+                   struct libps_renderer_sw_texture* entry)
+{
+    const uint16_t* vram = gpu->vram;
+
+    const unsigned int page_x = (entry->texpage & 0x0F) * 64;
+    const unsigned int page_y = (entry->texpage & (1 << 4)) ? 256 : 0;
+
+    const unsigned int clut_x = (entry->clut & 0x3F) * 16;
+    const unsigned int clut_y = (entry->clut >> 6) & 0x1FF;
+
+    const uint16_t* clut = &vram[LIBPS_GPU_VRAM_WIDTH * clut_y];
+
+    uint16_t* texels = entry->texels;
+
+    for (unsigned int v = 0; v < LIBPS_RENDERER_SW_TEXTURE_SIZE; ++v)
+    {
+        const uint16_t* line =
+        &vram[LIBPS_GPU_VRAM_WIDTH * ((page_y + v) & 0x1FF)];
+
+        switch (texpage_depth(entry->texpage))
+        {
+            // Each halfword holds four 4-bit palette indices, the first
+            // texel in the lowest bits.
+            case 0:
+                for (unsigned int u = 0; u < 256; ++u)
+                {
+                    const uint16_t data = line[(page_x + (u / 4)) & 0x3FF];
+                    const unsigned int index = (data >> ((u & 3) * 4)) & 0xF;
+
+                    texels[u] = clut[(clut_x + index) & 0x3FF];
+                }
+                break;
+
+            // Each halfword holds two 8-bit palette indices.
+            case 1:
+                for (unsigned int u = 0; u < 256; ++u)
+                {
+                    const uint16_t data = line[(page_x + (u / 2)) & 0x3FF];
+                    const unsigned int index = (data >> ((u & 1) * 8)) & 0xFF;
+
+                    texels[u] = clut[(clut_x + index) & 0x3FF];
+                }
+                break;
+
+            case 2:
+                for (unsigned int u = 0; u < 256; ++u)
+                {
+                    texels[u] = line[(page_x + u) & 0x3FF];
+                }
+                break;
+        }
+        texels += LIBPS_RENDERER_SW_TEXTURE_SIZE;
+    }
+}
+
+// Creates an empty texture cache.
+struct libps_renderer_sw_texture_cache*
+libps_renderer_sw_texture_cache_create(void)
+{
+    struct libps_renderer_sw_texture_cache* cache =
+    libps_safe_malloc(sizeof(struct libps_renderer_sw_texture_cache));
+
+    for (unsigned int i = 0; i < LIBPS_RENDERER_SW_TEXTURE_CACHE_SIZE; ++i)
+    {
+        struct libps_renderer_sw_texture* entry = &cache->entries[i];
+
+        entry->texpage   = 0;
+        entry->clut      = 0;
+        entry->stamp     = 0;
+        entry->last_used = 0;
+
+        entry->texels =
+        libps_safe_malloc(sizeof(uint16_t) *
+                          LIBPS_RENDERER_SW_TEXTURE_SIZE *
+                          LIBPS_RENDERER_SW_TEXTURE_SIZE);
+    }
+
+    cache->lookups = 0;
+    cache->hits    = 0;
+    cache->misses  = 0;
+
+    return cache;
+}
+
+// Destroys a texture cache.
+void
+libps_renderer_sw_texture_cache_destroy(struct libps_renderer_sw_texture_cache*
+                                        cache)
+{
+    assert(cache != NULL);
+
+    for (unsigned int i = 0; i < LIBPS_RENDERER_SW_TEXTURE_CACHE_SIZE; ++i)
+    {
+        libps_safe_free(cache->entries[i].texels);
+    }
+    libps_safe_free(cache);
+}
+
+// Returns the entry for texture page `texpage` with palette `clut`, or `NULL`
+// if there is none. `texpage` and `clut` must already be masked.
+static struct libps_renderer_sw_texture*
+find_entry(struct libps_renderer_sw_texture_cache* cache,
+           const uint16_t texpage,
+           const uint16_t clut)
+{
+    // There are only a few entries, so a linear scan is fine.
+    for (unsigned int i = 0; i < LIBPS_RENDERER_SW_TEXTURE_CACHE_SIZE; ++i)
+    {
+        struct libps_renderer_sw_texture* entry = &cache->entries[i];
+
+        if ((entry->stamp != 0) &&
+            (entry->texpage == texpage) &&
+            (entry->clut == clut))
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Returns the palette part of the cache key of texture page `texpage` with
+// palette `clut`. 15bpp texture pages don't use a palette, so every palette
+// maps to the same entry.
+static uint16_t clut_key(const uint16_t texpage, const uint16_t clut)
+{
+    return (texpage_depth(texpage) == 2) ? 0 : clut;
+}
+
+// Returns the decoded texels of texture page `texpage` with palette `clut` if
+// they are cached and VRAM hasn't been written to since they were decoded,
+// or `NULL` otherwise.
+const uint16_t*
+libps_renderer_sw_texture_cache_find(struct libps_renderer_sw_texture_cache*
+                                     cache,
+                                     const struct libps_gpu* gpu,
+                                     const uint16_t texpage,
+                                     const uint16_t clut)
+{
+    assert(cache != NULL);
+    assert(gpu != NULL);
+
+    const uint16_t key_texpage = texpage & TEXPAGE_MASK;
+    const uint16_t key_clut    = clut_key(texpage, clut);
+
+    struct libps_renderer_sw_texture* entry =
+    find_entry(cache, key_texpage, key_clut);
+
+    if (!entry || is_stale(gpu, entry))
+    {
+        return NULL;
+    }
+
+    entry->last_used = ++cache->lookups;
+    cache->hits++;
+
+    return entry->texels;
+}
+
+// Decodes texture page `texpage` with palette `clut` from the VRAM of `gpu`
+// and returns the texels. This replaces the stale entry of the same texture
+// page and palette if there is one, or the least recently used entry
+// otherwise; texels previously returned for that entry are overwritten.
+const uint16_t*
+libps_renderer_sw_texture_cache_load(struct libps_renderer_sw_texture_cache*
+                                     cache,
+                                     const struct libps_gpu* gpu,
+                                     const uint16_t texpage,
+                                     const uint16_t clut)
+{
+    assert(cache != NULL);
+    assert(gpu != NULL);
+
+    const uint16_t key_texpage = texpage & TEXPAGE_MASK;
+    const uint16_t key_clut    = clut_key(texpage, clut);
+
+    struct libps_renderer_sw_texture* entry =
+    find_entry(cache, key_texpage, key_clut);
+
+    if (!entry)
+    {
+        // Unused entries have never been used, so they are picked first.
+        entry = &cache->entries[0];
+
+        for (unsigned int i = 1; i < LIBPS_RENDERER_SW_TEXTURE_CACHE_SIZE; ++i)
+        {
+            if (cache->entries[i].last_used < entry->last_used)
+            {
+                entry = &cache->entries[i];
+            }
+        }
+    }
+
+    entry->texpage   = key_texpage;
+    entry->clut      = key_clut;
+    entry->stamp     = gpu->vram_stamp;
+    entry->last_used = ++cache->lookups;
+    cache->misses++;
+
+    decode(gpu, entry);
+    return entry->texels;
+}
@@ -0,0 +1,100 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Cache of texture pages decoded to 16bpp texels. A texture page is decoded
+// once per combination of texture page, palette (CLUT) and color depth, and
+// stays valid until the VRAM it was decoded from is written to.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdint.h>
+
+// Number of decoded texture pages kept around
+#define LIBPS_RENDERER_SW_TEXTURE_CACHE_SIZE 32
+
+// Texture pages are 256x256 texels in every color depth.
+#define LIBPS_RENDERER_SW_TEXTURE_SIZE 256
+
+struct libps_gpu;
+
+struct libps_renderer_sw_texture
+{
+    // Texture page (in GP0(E1h) format, only the bits selecting the page and
+    // color depth) and palette the texels were decoded from
+    uint16_t texpage;
+    uint16_t clut;
+
+    // `vram_stamp` of the GPU when the texels were decoded, 0 if this entry
+    // is unused
+    uint64_t stamp;
+
+    // The lookup which last returned this entry, for eviction
+    uint64_t last_used;
+
+    // 256x256 texels, indexed by `u + (v * 256)`
+    uint16_t* texels;
+};
+
+struct libps_renderer_sw_texture_cache
+{
+    struct libps_renderer_sw_texture
+    entries[LIBPS_RENDERER_SW_TEXTURE_CACHE_SIZE];
+
+    // Number of lookups done so far
+    uint64_t lookups;
+
+    // Number of lookups which found a decoded texture page, and which had to
+    // decode one. Only kept for statistics, which reset these.
+    uint64_t hits;
+    uint64_t misses;
+};
+
+// Creates an empty texture cache.
+struct libps_renderer_sw_texture_cache*
+libps_renderer_sw_texture_cache_create(void);
+
+// Destroys a texture cache.
+void
+libps_renderer_sw_texture_cache_destroy(struct libps_renderer_sw_texture_cache*
+                                        cache);
+
+// Returns the decoded texels of texture page `texpage` with palette `clut` if
+// they are cached and VRAM hasn't been written to since they were decoded,
+// or `NULL` otherwise.
+const uint16_t*
+libps_renderer_sw_texture_cache_find(struct libps_renderer_sw_texture_cache*
+                                     cache,
+                                     const struct libps_gpu* gpu,
+                                     const uint16_t texpage,
+                                     const uint16_t clut);
+
+// Decodes texture page `texpage` with palette `clut` from the VRAM of `gpu`
+// and returns the texels. This replaces the stale entry of the same texture
+// page and palette if there is one, or the least recently used entry
+// otherwise; texels previously returned for that entry are overwritten.
+const uint16_t*
+libps_renderer_sw_texture_cache_load(struct libps_renderer_sw_texture_cache*
+                                     cache,
+                                     const struct libps_gpu* gpu,
+                                     const uint16_t texpage,
+                                     const uint16_t clut);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
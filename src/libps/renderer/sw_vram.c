@@ -0,0 +1,254 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sw_scanout.h"
+#include "sw_vram.h"
+#include "../utility/math.h"
+
+// Stores `count` pixels from `src` into `dst`, which may overlap, honouring
+// the mask bit setting of `gpu`.
+void libps_renderer_sw_store_pixels(const struct libps_gpu* gpu,
+                                    uint16_t* dst,
+                                    const uint16_t* src,
+                                    const unsigned int count)
+{
+    assert(gpu != NULL);
+    assert(dst != NULL);
+    assert(src != NULL);
+
+    const uint16_t mask_set   = (gpu->mask_settings & 0x01) ? 0x8000 : 0x0000;
+    const uint16_t mask_check = (gpu->mask_settings & 0x02) ? 0x8000 : 0x0000;
+
+    if ((mask_set | mask_check) == 0)
+    {
+        memmove(dst, src, count * sizeof(uint16_t));
+        return;
+    }
+
+    // Every source pixel must be read before it is overwritten.
+    if (dst > src)
+    {
+        for (unsigned int i = count; i-- != 0;)
+        {
+            if (!(dst[i] & mask_check))
+            {
+                dst[i] = src[i] | mask_set;
+            }
+        }
+    }
+    else
+    {
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if (!(dst[i] & mask_check))
+            {
+                dst[i] = src[i] | mask_set;
+            }
+        }
+    }
+}
+
+// Copies the `width` by `height` pixel area of VRAM at (`src_x`, `src_y`) to
+// (`dst_x`, `dst_y`) within `vram`, which is VRAM upscaled by `scale`.
+static void copy_vram(const struct libps_gpu* gpu,
+                      uint16_t* vram,
+                      const unsigned int scale,
+                      const unsigned int src_x,
+                      const unsigned int src_y,
+                      const unsigned int dst_x,
+                      const unsigned int dst_y,
+                      const unsigned int width,
+                      const unsigned int height)
+{
+    assert(gpu != NULL);
+    assert(vram != NULL);
+
+    const unsigned int vram_width  = LIBPS_GPU_VRAM_WIDTH * scale;
+    const unsigned int vram_height = LIBPS_GPU_VRAM_HEIGHT * scale;
+
+    const unsigned int x1    = src_x * scale;
+    const unsigned int x2    = dst_x * scale;
+    const unsigned int count = width * scale;
+
+    // Rows which cross the right edge of VRAM go through a buffer.
+    const bool wraps = ((x1 + count) > vram_width) ||
+                       ((x2 + count) > vram_width);
+
+    for (unsigned int row = 0; row < (height * scale); ++row)
+    {
+        uint16_t* src =
+        &vram[vram_width * (((src_y * scale) + row) % vram_height)];
+
+        uint16_t* dst =
+        &vram[vram_width * (((dst_y * scale) + row) % vram_height)];
+
+        if (!wraps)
+        {
+            libps_renderer_sw_store_pixels(gpu, dst + x2, src + x1, count);
+            continue;
+        }
+
+        uint16_t pixels[LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_MAX_SCALE];
+
+        for (unsigned int i = 0; i < count;)
+        {
+            const unsigned int x   = (x1 + i) % vram_width;
+            const unsigned int run = LIBPS_MIN(count - i, vram_width - x);
+
+            memcpy(&pixels[i], &src[x], run * sizeof(uint16_t));
+            i += run;
+        }
+
+        for (unsigned int i = 0; i < count;)
+        {
+            const unsigned int x   = (x2 + i) % vram_width;
+            const unsigned int run = LIBPS_MIN(count - i, vram_width - x);
+
+            libps_renderer_sw_store_pixels(gpu, &dst[x], &pixels[i], run);
+            i += run;
+        }
+    }
+}
+
+// Fills the `width` x `height` area of VRAM at (`x`, `y`), which are
+// multiples of 16, with `color`. The area wraps around the edges of VRAM.
+void libps_renderer_sw_vram_fill(struct libps_gpu* gpu,
+                                 const unsigned int x,
+                                 const unsigned int y,
+                                 const unsigned int width,
+                                 const unsigned int height,
+                                 const uint16_t color)
+{
+    assert(gpu != NULL);
+
+    uint16_t pixels[LIBPS_GPU_VRAM_WIDTH];
+
+    for (unsigned int i = 0; i < width; ++i)
+    {
+        pixels[i] = color;
+    }
+
+    // Both the position and the width are multiples of 16, so a row wraps
+    // around at most once.
+    const unsigned int first = LIBPS_MIN(width, LIBPS_GPU_VRAM_WIDTH - x);
+
+    for (unsigned int row = 0; row < height; ++row)
+    {
+        uint16_t* dst = &gpu->vram[LIBPS_GPU_VRAM_WIDTH *
+                                   ((y + row) % LIBPS_GPU_VRAM_HEIGHT)];
+
+        memcpy(&dst[x], pixels, first * sizeof(uint16_t));
+        memcpy(dst, pixels, (width - first) * sizeof(uint16_t));
+    }
+    libps_renderer_sw_vram_store(gpu, x, y, width, height);
+}
+
+// Copies the `width` x `height` area of VRAM at (`src_x`, `src_y`) to
+// (`dst_x`, `dst_y`). Rows are copied from top to bottom like the real GPU
+// does, even when the areas overlap.
+void libps_renderer_sw_vram_copy(struct libps_gpu* gpu,
+                                 const unsigned int src_x,
+                                 const unsigned int src_y,
+                                 const unsigned int dst_x,
+                                 const unsigned int dst_y,
+                                 const unsigned int width,
+                                 const unsigned int height)
+{
+    assert(gpu != NULL);
+
+    copy_vram(gpu, gpu->vram, 1, src_x, src_y, dst_x, dst_y, width, height);
+
+    // Copying the upscaled pixels keeps their detail.
+    if (gpu->upscaled_vram)
+    {
+        copy_vram(gpu,
+                  gpu->upscaled_vram,
+                  gpu->scale,
+                  src_x,
+                  src_y,
+                  dst_x,
+                  dst_y,
+                  width,
+                  height);
+    }
+}
+
+// Copies the `width` x `height` area of `vram` at (`x`, `y`) into the
+// upscaled VRAM, if any, with every pixel becoming a block of pixels. Areas
+// crossing the edges of VRAM wrap around.
+void libps_renderer_sw_vram_store(struct libps_gpu* gpu,
+                                  const unsigned int x,
+                                  const unsigned int y,
+                                  const unsigned int width,
+                                  const unsigned int height)
+{
+    assert(gpu != NULL);
+
+    if (!gpu->upscaled_vram)
+    {
+        return;
+    }
+
+    const unsigned int scale      = gpu->scale;
+    const unsigned int vram_width = LIBPS_GPU_VRAM_WIDTH * scale;
+    const unsigned int count      = width * scale;
+
+    // An upscaled row wraps around the right edge at most once.
+    const unsigned int first = LIBPS_MIN(count, vram_width - (x * scale));
+
+    uint16_t pixels[LIBPS_GPU_VRAM_WIDTH * LIBPS_GPU_MAX_SCALE];
+
+    for (unsigned int row = 0; row < height; ++row)
+    {
+        const unsigned int line = (y + row) % LIBPS_GPU_VRAM_HEIGHT;
+        const uint16_t* src     = &gpu->vram[LIBPS_GPU_VRAM_WIDTH * line];
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            pixels[i] = src[(x + (i / scale)) % LIBPS_GPU_VRAM_WIDTH];
+        }
+
+        for (unsigned int i = 0; i < scale; ++i)
+        {
+            uint16_t* dst =
+            &gpu->upscaled_vram[vram_width * ((line * scale) + i)];
+
+            memcpy(&dst[x * scale], pixels, first * sizeof(uint16_t));
+            memcpy(dst, &pixels[first], (count - first) * sizeof(uint16_t));
+        }
+    }
+}
+
+// Converts the display area `area` of `vram`, or of the upscaled VRAM if
+// `area->scale` is greater than 1, to `format` and stores it in `pixels`.
+void libps_renderer_sw_vram_scanout(struct libps_gpu* gpu,
+                                    const struct libps_gpu_display_area* area,
+                                    uint32_t* pixels,
+                                    const unsigned int stride,
+                                    const enum libps_gpu_scanout_format format)
+{
+    assert(gpu != NULL);
+    assert(area != NULL);
+
+    libps_renderer_sw_scanout((area->scale > 1) ? gpu->upscaled_vram :
+                                                  gpu->vram,
+                              area,
+                              pixels,
+                              stride,
+                              format);
+}
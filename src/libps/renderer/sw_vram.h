@@ -0,0 +1,75 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Operations of the software renderers which access VRAM as a whole rather
+// than drawing primitives: fills, copies and transfers, which keep the
+// upscaled VRAM in step with `vram`, and scanout.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdint.h>
+#include "gpu.h"
+
+// Stores `count` pixels from `src` into `dst`, which may overlap, honouring
+// the mask bit setting of `gpu`.
+void libps_renderer_sw_store_pixels(const struct libps_gpu* gpu,
+                                    uint16_t* dst,
+                                    const uint16_t* src,
+                                    const unsigned int count);
+
+// Fills the `width` x `height` area of VRAM at (`x`, `y`), which are
+// multiples of 16, with `color`. The area wraps around the edges of VRAM.
+void libps_renderer_sw_vram_fill(struct libps_gpu* gpu,
+                                 const unsigned int x,
+                                 const unsigned int y,
+                                 const unsigned int width,
+                                 const unsigned int height,
+                                 const uint16_t color);
+
+// Copies the `width` x `height` area of VRAM at (`src_x`, `src_y`) to
+// (`dst_x`, `dst_y`). Rows are copied from top to bottom like the real GPU
+// does, even when the areas overlap.
+void libps_renderer_sw_vram_copy(struct libps_gpu* gpu,
+                                 const unsigned int src_x,
+                                 const unsigned int src_y,
+                                 const unsigned int dst_x,
+                                 const unsigned int dst_y,
+                                 const unsigned int width,
+                                 const unsigned int height);
+
+// Copies the `width` x `height` area of `vram` at (`x`, `y`) into the
+// upscaled VRAM, if any, with every pixel becoming a block of pixels. Areas
+// crossing the edges of VRAM wrap around.
+void libps_renderer_sw_vram_store(struct libps_gpu* gpu,
+                                  const unsigned int x,
+                                  const unsigned int y,
+                                  const unsigned int width,
+                                  const unsigned int height);
+
+// Converts the display area `area` of `vram`, or of the upscaled VRAM if
+// `area->scale` is greater than 1, to `format` and stores it in `pixels`.
+void libps_renderer_sw_vram_scanout(struct libps_gpu* gpu,
+                                    const struct libps_gpu_display_area* area,
+                                    uint32_t* pixels,
+                                    const unsigned int stride,
+                                    const enum libps_gpu_scanout_format format);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
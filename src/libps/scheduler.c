@@ -0,0 +1,130 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "scheduler.h"
+
+// Recomputes the timestamp of the earliest pending event. There are only a
+// handful of events, so a linear scan beats maintaining a heap.
+static void update_next_timestamp(struct libps_scheduler* scheduler)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (unsigned int id = 0; id < LIBPS_EVENT_MAX; ++id)
+    {
+        const struct libps_event* event = &scheduler->events[id];
+
+        if (event->pending && event->timestamp < next)
+        {
+            next = event->timestamp;
+        }
+    }
+    scheduler->next_timestamp = next;
+}
+
+// Cancels all events and resets the cycle counter. Callbacks are preserved.
+void libps_scheduler_reset(struct libps_scheduler* scheduler)
+{
+    assert(scheduler != NULL);
+
+    for (unsigned int id = 0; id < LIBPS_EVENT_MAX; ++id)
+    {
+        scheduler->events[id].pending   = false;
+        scheduler->events[id].timestamp = 0;
+    }
+
+    scheduler->cycles         = 0;
+    scheduler->next_timestamp = UINT64_MAX;
+}
+
+// Sets the function to call when event `id` fires.
+void libps_scheduler_set_callback(struct libps_scheduler* scheduler,
+                                  const enum libps_event_id id,
+                                  void (*callback)(void* user_data,
+                                                   const unsigned int param),
+                                  void* user_data,
+                                  const unsigned int param)
+{
+    assert(scheduler != NULL);
+    assert(id < LIBPS_EVENT_MAX);
+
+    scheduler->events[id].callback  = callback;
+    scheduler->events[id].user_data = user_data;
+    scheduler->events[id].param     = param;
+}
+
+// Schedules event `id` to fire at absolute cycle `timestamp`, replacing any
+// pending instance of it.
+void libps_scheduler_schedule(struct libps_scheduler* scheduler,
+                              const enum libps_event_id id,
+                              const uint64_t timestamp)
+{
+    assert(scheduler != NULL);
+    assert(id < LIBPS_EVENT_MAX);
+
+    scheduler->events[id].pending   = true;
+    scheduler->events[id].timestamp = timestamp;
+
+    update_next_timestamp(scheduler);
+}
+
+// Cancels event `id` if it is pending.
+void libps_scheduler_cancel(struct libps_scheduler* scheduler,
+                            const enum libps_event_id id)
+{
+    assert(scheduler != NULL);
+    assert(id < LIBPS_EVENT_MAX);
+
+    if (scheduler->events[id].pending)
+    {
+        scheduler->events[id].pending = false;
+        update_next_timestamp(scheduler);
+    }
+}
+
+// Fires every event whose timestamp has been reached, in timestamp order.
+void libps_scheduler_run_events(struct libps_scheduler* scheduler)
+{
+    assert(scheduler != NULL);
+
+    while (scheduler->cycles >= scheduler->next_timestamp)
+    {
+        // Find the earliest due event; callbacks may schedule new events
+        // (including themselves), so this is recomputed every iteration.
+        struct libps_event* due = NULL;
+
+        for (unsigned int id = 0; id < LIBPS_EVENT_MAX; ++id)
+        {
+            struct libps_event* event = &scheduler->events[id];
+
+            if (event->pending &&
+                event->timestamp == scheduler->next_timestamp)
+            {
+                due = event;
+                break;
+            }
+        }
+
+        assert(due != NULL);
+
+        due->pending = false;
+        update_next_timestamp(scheduler);
+
+        if (due->callback)
+        {
+            due->callback(due->user_data, due->param);
+        }
+    }
+}
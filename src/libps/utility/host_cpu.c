@@ -0,0 +1,109 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <stdint.h>
+#include "host_cpu.h"
+
+#ifdef LIBPS_HOST_X86_64
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+// Executes the CPUID instruction for leaf `leaf` and subleaf `subleaf`.
+static void cpuid(const unsigned int leaf,
+                  const unsigned int subleaf,
+                  unsigned int regs[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+
+    __cpuidex(info, (int)leaf, (int)subleaf);
+
+    for (unsigned int i = 0; i < 4; ++i)
+    {
+        regs[i] = (unsigned int)info[i];
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Returns the state components the operating system saves and restores on a
+// context switch (XCR0).
+static uint64_t xgetbv(void)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _xgetbv(0);
+#else
+    uint32_t eax;
+    uint32_t edx;
+
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif // LIBPS_HOST_X86_64
+
+// Returns `true` if the host CPU supports SSE2.
+bool libps_host_cpu_has_sse2(void)
+{
+#ifdef LIBPS_HOST_X86_64
+    unsigned int regs[4];
+    cpuid(1, 0, regs);
+
+    // EDX bit 26
+    return regs[3] & (1 << 26);
+#else
+    return false;
+#endif // LIBPS_HOST_X86_64
+}
+
+// Returns `true` if the host CPU and operating system support AVX2.
+bool libps_host_cpu_has_avx2(void)
+{
+#ifdef LIBPS_HOST_X86_64
+    unsigned int regs[4];
+    cpuid(0, 0, regs);
+
+    if (regs[0] < 7)
+    {
+        return false;
+    }
+
+    cpuid(1, 0, regs);
+
+    // The CPU has to support AVX (ECX bit 28), and the operating system has
+    // to have enabled XSAVE (ECX bit 27) and the saving of the XMM and YMM
+    // registers.
+    if (!(regs[2] & (1 << 27)) || !(regs[2] & (1 << 28)))
+    {
+        return false;
+    }
+
+    if ((xgetbv() & 0x06) != 0x06)
+    {
+        return false;
+    }
+
+    cpuid(7, 0, regs);
+
+    // EBX bit 5
+    return regs[1] & (1 << 5);
+#else
+    return false;
+#endif // LIBPS_HOST_X86_64
+}
@@ -0,0 +1,38 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdbool.h>
+
+// SSE2 is part of the x86-64 baseline, so the SSE2 code builds without any
+// special compiler options. 32-bit x86 hosts use the portable code.
+#if defined(__x86_64__) || defined(_M_X64)
+#define LIBPS_HOST_X86_64
+#endif
+
+// Returns `true` if the host CPU supports SSE2.
+bool libps_host_cpu_has_sse2(void);
+
+// Returns `true` if the host CPU and operating system support AVX2.
+bool libps_host_cpu_has_avx2(void);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
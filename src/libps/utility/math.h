@@ -19,6 +19,8 @@ extern "C"
 {
 #endif // __cplusplus
 #define LIBPS_BCD_TO_DEC(x) (x - (6 * (x >> 4)))
+#define LIBPS_MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define LIBPS_MAX(a, b) (((a) > (b)) ? (a) : (b))
 #ifdef __cplusplus
 }
 #endif // __cplusplus
\ No newline at end of file
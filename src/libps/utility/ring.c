@@ -0,0 +1,38 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "ring.h"
+
+// Creates a ring buffer of `size` words. `size` must be a power of two.
+void libps_ring_setup(struct libps_ring* ring, const unsigned int size)
+{
+    assert(ring != NULL);
+    assert((size != 0) && ((size & (size - 1)) == 0));
+
+    ring->entries = libps_safe_malloc(sizeof(uint32_t) * size);
+    ring->size    = size;
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+}
+
+// Destroys a ring buffer.
+void libps_ring_cleanup(struct libps_ring* ring)
+{
+    assert(ring != NULL);
+    libps_safe_free(ring->entries);
+}
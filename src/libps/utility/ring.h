@@ -0,0 +1,98 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Lock-free ring buffer of 32-bit words for exactly one producer thread and
+// one consumer thread.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct libps_ring
+{
+    uint32_t* entries;
+
+    // Number of entries, which is a power of two
+    unsigned int size;
+
+    // Free-running counts of the words pushed by the producer and popped by
+    // the consumer. The ring is empty when they are equal.
+    atomic_uint head;
+    atomic_uint tail;
+};
+
+// Creates a ring buffer of `size` words. `size` must be a power of two.
+void libps_ring_setup(struct libps_ring* ring, const unsigned int size);
+
+// Destroys a ring buffer.
+void libps_ring_cleanup(struct libps_ring* ring);
+
+// Returns `true` if every word pushed has also been popped.
+static inline bool libps_ring_is_empty(struct libps_ring* ring)
+{
+    return atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
+
+// Adds `data` to the ring. Returns `false` if the ring is full. Only the
+// producer may call this.
+static inline bool libps_ring_push(struct libps_ring* ring,
+                                   const uint32_t data)
+{
+    const unsigned int head = atomic_load_explicit(&ring->head,
+                                                   memory_order_relaxed);
+
+    if ((head - atomic_load(&ring->tail)) == ring->size)
+    {
+        return false;
+    }
+
+    ring->entries[head & (ring->size - 1)] = data;
+    atomic_store(&ring->head, head + 1);
+
+    return true;
+}
+
+// Stores the oldest word in the ring into `data` without removing it.
+// Returns `false` if the ring is empty. Only the consumer may call this.
+static inline bool libps_ring_peek(struct libps_ring* ring, uint32_t* data)
+{
+    const unsigned int tail = atomic_load_explicit(&ring->tail,
+                                                   memory_order_relaxed);
+
+    if (tail == atomic_load(&ring->head))
+    {
+        return false;
+    }
+
+    *data = ring->entries[tail & (ring->size - 1)];
+    return true;
+}
+
+// Removes the oldest word from the ring, which must not be empty. Only the
+// consumer may call this.
+static inline void libps_ring_pop(struct libps_ring* ring)
+{
+    atomic_fetch_add(&ring->tail, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
@@ -0,0 +1,190 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+#include <assert.h>
+#include <stdlib.h>
+#include "memory.h"
+#include "thread.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif // _WIN32
+
+// What a new thread has to run
+struct thread_start
+{
+    void (*func)(void* arg);
+    void* arg;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI thread_entry(LPVOID param)
+#else
+static void* thread_entry(void* param)
+#endif // _WIN32
+{
+    struct thread_start start = *(struct thread_start*)param;
+    libps_safe_free(param);
+
+    start.func(start.arg);
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif // _WIN32
+}
+
+// Starts a thread running `func(arg)`. Calls `abort()` if the thread could
+// not be created.
+void libps_thread_create(libps_thread* thread,
+                         void (*func)(void* arg),
+                         void* arg)
+{
+    assert(thread != NULL);
+    assert(func != NULL);
+
+    struct thread_start* start = libps_safe_malloc(sizeof(*start));
+
+    start->func = func;
+    start->arg  = arg;
+
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, &thread_entry, start, 0, NULL);
+
+    if (*thread == NULL)
+    {
+        abort();
+    }
+#else
+    if (pthread_create(thread, NULL, &thread_entry, start) != 0)
+    {
+        abort();
+    }
+#endif // _WIN32
+}
+
+// Waits for `thread` to exit.
+void libps_thread_join(libps_thread* thread)
+{
+    assert(thread != NULL);
+
+#ifdef _WIN32
+    WaitForSingleObject(*thread, INFINITE);
+    CloseHandle(*thread);
+#else
+    pthread_join(*thread, NULL);
+#endif // _WIN32
+}
+
+// Returns the number of logical processors of the host.
+unsigned int libps_thread_hardware_concurrency(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors;
+#else
+    const long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (unsigned int)count : 1;
+#endif // _WIN32
+}
+
+void libps_mutex_init(libps_mutex* mutex)
+{
+#ifdef _WIN32
+    InitializeSRWLock(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif // _WIN32
+}
+
+void libps_mutex_destroy(libps_mutex* mutex)
+{
+#ifdef _WIN32
+    // SRW locks need no cleanup.
+    (void)mutex;
+#else
+    pthread_mutex_destroy(mutex);
+#endif // _WIN32
+}
+
+void libps_mutex_lock(libps_mutex* mutex)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif // _WIN32
+}
+
+void libps_mutex_unlock(libps_mutex* mutex)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif // _WIN32
+}
+
+void libps_cond_init(libps_cond* cond)
+{
+#ifdef _WIN32
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif // _WIN32
+}
+
+void libps_cond_destroy(libps_cond* cond)
+{
+#ifdef _WIN32
+    // Condition variables need no cleanup.
+    (void)cond;
+#else
+    pthread_cond_destroy(cond);
+#endif // _WIN32
+}
+
+// Atomically unlocks `mutex` and waits for `cond` to be signaled, then locks
+// `mutex` again. Spurious wakeups are possible.
+void libps_cond_wait(libps_cond* cond, libps_mutex* mutex)
+{
+#ifdef _WIN32
+    SleepConditionVariableSRW(cond, mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif // _WIN32
+}
+
+// Wakes up one thread waiting on `cond`.
+void libps_cond_signal(libps_cond* cond)
+{
+#ifdef _WIN32
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif // _WIN32
+}
+
+// Wakes up every thread waiting on `cond`.
+void libps_cond_broadcast(libps_cond* cond)
+{
+#ifdef _WIN32
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif // _WIN32
+}
@@ -0,0 +1,76 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Minimal threading primitives, implemented on top of the Win32 API on
+// Windows and POSIX threads everywhere else.
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+
+#include <stdbool.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+typedef HANDLE libps_thread;
+typedef SRWLOCK libps_mutex;
+typedef CONDITION_VARIABLE libps_cond;
+#else
+#include <pthread.h>
+
+typedef pthread_t libps_thread;
+typedef pthread_mutex_t libps_mutex;
+typedef pthread_cond_t libps_cond;
+#endif // _WIN32
+
+// Starts a thread running `func(arg)`. Calls `abort()` if the thread could
+// not be created.
+void libps_thread_create(libps_thread* thread,
+                         void (*func)(void* arg),
+                         void* arg);
+
+// Waits for `thread` to exit.
+void libps_thread_join(libps_thread* thread);
+
+// Returns the number of logical processors of the host.
+unsigned int libps_thread_hardware_concurrency(void);
+
+void libps_mutex_init(libps_mutex* mutex);
+void libps_mutex_destroy(libps_mutex* mutex);
+void libps_mutex_lock(libps_mutex* mutex);
+void libps_mutex_unlock(libps_mutex* mutex);
+
+void libps_cond_init(libps_cond* cond);
+void libps_cond_destroy(libps_cond* cond);
+
+// Atomically unlocks `mutex` and waits for `cond` to be signaled, then locks
+// `mutex` again. Spurious wakeups are possible.
+void libps_cond_wait(libps_cond* cond, libps_mutex* mutex);
+
+// Wakes up one thread waiting on `cond`.
+void libps_cond_signal(libps_cond* cond);
+
+// Wakes up every thread waiting on `cond`.
+void libps_cond_broadcast(libps_cond* cond);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
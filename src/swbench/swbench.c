@@ -0,0 +1,752 @@
+// Copyright 2020 Michael Rodriguez
+//
+// Permission to use, copy, modify, and/or distribute this software for any
+// purpose with or without fee is hereby granted, provided that the above
+// copyright notice and this permission notice appear in all copies.
+//
+// THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+// WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+// SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+// WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+// OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+// CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+// Draws synthetic primitives straight through the software renderer, with no
+// GP0 parsing, and reports how many pixels and primitives it draws per
+// second. Every run draws the same primitives from a fixed seed, so numbers
+// are comparable between builds.
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "gpu.h"
+#include "scheduler.h"
+#include "renderer/sw_mt.h"
+
+// Primitives are drawn into the right half of VRAM. Textures and palettes
+// are taken from the left half, which is filled with random data.
+#define CLIP_X1 512
+#define CLIP_Y1 0
+#define CLIP_X2 1023
+#define CLIP_Y2 511
+
+// Largest size of a primitive, in pixels
+#define MAX_SIZE 512
+
+// Maximum number of values in a list option
+#define MAX_CHOICES 8
+
+enum shading
+{
+    SHADING_FLAT,
+    SHADING_GOURAUD,
+
+    // Textured primitives only: texels are not blended with the color.
+    SHADING_RAW
+};
+
+// Semi-transparency mode meaning the primitive is opaque
+#define BLEND_OPAQUE 4
+
+// A list of values of an option, one of which is picked for every primitive
+struct choices
+{
+    unsigned int values[MAX_CHOICES];
+    unsigned int count;
+};
+
+struct options
+{
+    // Are rectangles drawn instead of triangles?
+    bool rects;
+
+    // Number of primitives drawn per run
+    unsigned int count;
+
+    // Number of timed runs
+    unsigned int runs;
+
+    // Size of the primitives, in pixels
+    unsigned int min_size;
+    unsigned int max_size;
+
+    // Percentage of the primitives crossing an edge of the drawing area
+    unsigned int clipped;
+
+    // `enum shading` values
+    struct choices shading;
+
+    // Texture depths in bits; 0 is untextured.
+    struct choices depth;
+
+    // Semi-transparency modes, or `BLEND_OPAQUE`
+    struct choices blend;
+
+    // Number of threads the renderer draws with
+    unsigned int threads;
+
+    // Internal resolution multiplier
+    unsigned int scale;
+};
+
+struct primitive
+{
+    struct libps_gpu_vertex v[3];
+
+    // Size of rectangles
+    unsigned int width;
+    unsigned int height;
+
+    // `DRAW_FLAG_*` and GP0(E1h) draw mode to draw the primitive with
+    unsigned int flags;
+    uint16_t draw_mode;
+};
+
+static uint32_t seed = 0x2545F491;
+
+// Returns a pseudorandom number (xorshift32).
+static uint32_t random32(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    return seed;
+}
+
+// Returns a pseudorandom number from `min` to `max`.
+static unsigned int random_range(const unsigned int min,
+                                 const unsigned int max)
+{
+    return min + (random32() % (max - min + 1));
+}
+
+// Returns one of `choices`, picked at random.
+static unsigned int random_choice(const struct choices* choices)
+{
+    return choices->values[random32() % choices->count];
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: swbench [options]\n"
+            "  -p tri|rect      primitive type (default tri)\n"
+            "  -n N             primitives per run (default 20000)\n"
+            "  -r N             timed runs (default 10)\n"
+            "  -z MIN[-MAX]     size in pixels, 1 to %d (default 8-64)\n"
+            "  -c LIST          shading: flat, gouraud, raw (default flat)\n"
+            "  -d LIST          texture depth: 0, 4, 8, 15 (default 0)\n"
+            "  -b LIST          blending: opaque, 0, 1, 2, 3 (default opaque)\n"
+            "  -x PERCENT       primitives crossing the drawing area edge "
+            "(default 0)\n"
+            "  -t N             renderer threads (default 1)\n"
+            "  -s N             internal resolution multiplier (default 1)\n"
+            "\n"
+            "Each LIST is comma separated; every primitive picks one of its "
+            "values.\n",
+            MAX_SIZE);
+}
+
+// Parses `arg`, a number from `min` to `max`, into `*value`. Returns `false`
+// if it isn't one.
+static bool parse_number(const char* arg,
+                         const unsigned int min,
+                         const unsigned int max,
+                         unsigned int* value)
+{
+    char* end;
+    const unsigned long n = strtoul(arg, &end, 10);
+
+    if ((end == arg) || (*end != '\0') || (n < min) || (n > max))
+    {
+        return false;
+    }
+
+    *value = (unsigned int)n;
+    return true;
+}
+
+// Parses the comma separated list `arg` into `choices`. Every entry must be
+// one of the `count` strings `names`, and is stored as the corresponding
+// value of `values`. Returns `false` if `arg` is malformed.
+static bool parse_choices(const char* arg,
+                          const char* const* names,
+                          const unsigned int* values,
+                          const unsigned int count,
+                          struct choices* choices)
+{
+    choices->count = 0;
+
+    while (*arg != '\0')
+    {
+        const size_t length = strcspn(arg, ",");
+        bool found          = false;
+
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            if ((strlen(names[i]) == length) &&
+                (strncmp(arg, names[i], length) == 0))
+            {
+                if (choices->count == MAX_CHOICES)
+                {
+                    return false;
+                }
+
+                choices->values[choices->count++] = values[i];
+                found = true;
+
+                break;
+            }
+        }
+
+        if (!found)
+        {
+            return false;
+        }
+
+        arg += length;
+
+        if (*arg == ',')
+        {
+            arg++;
+        }
+    }
+    return choices->count != 0;
+}
+
+static bool parse_options(const int argc,
+                          char** argv,
+                          struct options* options)
+{
+    static const char* const shading_names[] = { "flat", "gouraud", "raw" };
+    static const unsigned int shading_values[] =
+    {
+        SHADING_FLAT, SHADING_GOURAUD, SHADING_RAW
+    };
+
+    static const char* const depth_names[]   = { "0", "4", "8", "15" };
+    static const unsigned int depth_values[] = { 0, 4, 8, 15 };
+
+    static const char* const blend_names[] =
+    {
+        "opaque", "0", "1", "2", "3"
+    };
+
+    static const unsigned int blend_values[] = { BLEND_OPAQUE, 0, 1, 2, 3 };
+
+    options->rects    = false;
+    options->count    = 20000;
+    options->runs     = 10;
+    options->min_size = 8;
+    options->max_size = 64;
+    options->clipped  = 0;
+    options->threads  = 1;
+    options->scale    = 1;
+
+    options->shading = (struct choices){ { SHADING_FLAT }, 1 };
+    options->depth   = (struct choices){ { 0 }, 1 };
+    options->blend   = (struct choices){ { BLEND_OPAQUE }, 1 };
+
+    for (int i = 1; i < argc; i += 2)
+    {
+        const char* option = argv[i];
+        const char* arg    = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (!arg || (option[0] != '-') || (option[1] == '\0') ||
+            (option[2] != '\0'))
+        {
+            return false;
+        }
+
+        bool ok;
+
+        switch (option[1])
+        {
+            case 'p':
+                options->rects = strcmp(arg, "rect") == 0;
+                ok             = options->rects || (strcmp(arg, "tri") == 0);
+
+                break;
+
+            case 'n':
+                ok = parse_number(arg, 1, 10000000, &options->count);
+                break;
+
+            case 'r':
+                ok = parse_number(arg, 1, 1000, &options->runs);
+                break;
+
+            case 'z':
+            {
+                char min[16];
+                const char* max = strchr(arg, '-');
+
+                const size_t length = max ? (size_t)(max - arg) : strlen(arg);
+
+                if (length >= sizeof(min))
+                {
+                    return false;
+                }
+
+                memcpy(min, arg, length);
+                min[length] = '\0';
+
+                ok = parse_number(min, 1, MAX_SIZE, &options->min_size) &&
+                     parse_number(max ? (max + 1) : min,
+                                  options->min_size,
+                                  MAX_SIZE,
+                                  &options->max_size);
+                break;
+            }
+
+            case 'c':
+                ok = parse_choices(arg,
+                                   shading_names,
+                                   shading_values,
+                                   3,
+                                   &options->shading);
+                break;
+
+            case 'd':
+                ok = parse_choices(arg,
+                                   depth_names,
+                                   depth_values,
+                                   4,
+                                   &options->depth);
+                break;
+
+            case 'b':
+                ok = parse_choices(arg,
+                                   blend_names,
+                                   blend_values,
+                                   5,
+                                   &options->blend);
+                break;
+
+            case 'x':
+                ok = parse_number(arg, 0, 100, &options->clipped);
+                break;
+
+            case 't':
+                ok = parse_number(arg, 1, 256, &options->threads);
+                break;
+
+            case 's':
+                ok = parse_number(arg, 1, LIBPS_GPU_MAX_SCALE, &options->scale);
+                break;
+
+            default:
+                ok = false;
+                break;
+        }
+
+        if (!ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Clips the convex polygon of `count` points `in` against the half plane
+// where `sign * (coordinate axis of the point) <= sign * edge` and stores the
+// result in `out`. Returns the number of points of the result.
+static unsigned int clip_polygon(double in[][2],
+                                 const unsigned int count,
+                                 const unsigned int axis,
+                                 const double edge,
+                                 const double sign,
+                                 double out[][2])
+{
+    unsigned int result = 0;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const double* a = in[i];
+        const double* b = in[(i + 1) % count];
+
+        const double da = sign * (edge - a[axis]);
+        const double db = sign * (edge - b[axis]);
+
+        if (da >= 0.0)
+        {
+            out[result][0] = a[0];
+            out[result][1] = a[1];
+            result++;
+        }
+
+        if ((da >= 0.0) != (db >= 0.0))
+        {
+            const double t = da / (da - db);
+
+            out[result][0] = a[0] + ((b[0] - a[0]) * t);
+            out[result][1] = a[1] + ((b[1] - a[1]) * t);
+            result++;
+        }
+    }
+    return result;
+}
+
+// Returns the area of `primitive` within the drawing area, which is roughly
+// the number of pixels it covers.
+static double visible_area(const struct primitive* primitive,
+                           const bool rect)
+{
+    if (rect)
+    {
+        const int left   = primitive->v[0].x;
+        const int top    = primitive->v[0].y;
+        const int right  = left + (int)primitive->width - 1;
+        const int bottom = top + (int)primitive->height - 1;
+
+        const int width =
+        ((right < CLIP_X2) ? right : CLIP_X2) -
+        ((left > CLIP_X1) ? left : CLIP_X1) + 1;
+
+        const int height =
+        ((bottom < CLIP_Y2) ? bottom : CLIP_Y2) -
+        ((top > CLIP_Y1) ? top : CLIP_Y1) + 1;
+
+        return ((width > 0) && (height > 0)) ? ((double)width * height) : 0.0;
+    }
+
+    // Every triangle clipped by four edges has at most seven points.
+    double a[8][2];
+    double b[8][2];
+
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        a[i][0] = primitive->v[i].x;
+        a[i][1] = primitive->v[i].y;
+    }
+
+    unsigned int count = 3;
+
+    count = clip_polygon(a, count, 0, CLIP_X1,     -1.0, b);
+    count = clip_polygon(b, count, 0, CLIP_X2 + 1,  1.0, a);
+    count = clip_polygon(a, count, 1, CLIP_Y1,     -1.0, b);
+    count = clip_polygon(b, count, 1, CLIP_Y2 + 1,  1.0, a);
+
+    double area = 0.0;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const double* p = a[i];
+        const double* q = a[(i + 1) % count];
+
+        area += (p[0] * q[1]) - (q[0] * p[1]);
+    }
+    return fabs(area) / 2.0;
+}
+
+// Fills `primitive` with a primitive of a random size, position and kind
+// drawn from `options`.
+static void generate_primitive(const struct options* options,
+                               struct primitive* primitive)
+{
+    const int size = (int)random_range(options->min_size, options->max_size);
+    int x;
+    int y;
+
+    if (random_range(1, 100) <= options->clipped)
+    {
+        // Centered on an edge of the drawing area
+        switch (random32() % 4)
+        {
+            case 0:
+                x = CLIP_X1;
+                y = (int)random_range(CLIP_Y1, CLIP_Y2);
+
+                break;
+
+            case 1:
+                x = CLIP_X2;
+                y = (int)random_range(CLIP_Y1, CLIP_Y2);
+
+                break;
+
+            case 2:
+                x = (int)random_range(CLIP_X1, CLIP_X2);
+                y = CLIP_Y1;
+
+                break;
+
+            default:
+                x = (int)random_range(CLIP_X1, CLIP_X2);
+                y = CLIP_Y2;
+
+                break;
+        }
+
+        x -= size / 2;
+        y -= size / 2;
+    }
+    else
+    {
+        // Entirely within the drawing area, as far as it fits
+        const int max_x = CLIP_X2 + 1 - size;
+        const int max_y = CLIP_Y2 + 1 - size;
+
+        x = (int)random_range(CLIP_X1, (max_x > CLIP_X1) ? max_x : CLIP_X1);
+        y = (int)random_range(CLIP_Y1, (max_y > CLIP_Y1) ? max_y : CLIP_Y1);
+    }
+
+    const unsigned int shading = random_choice(&options->shading);
+    const unsigned int depth   = random_choice(&options->depth);
+    const unsigned int blend   = random_choice(&options->blend);
+
+    // One of texture pages 0-3 and two palettes, in the left half of VRAM.
+    // Even with every texture depth, that is few enough decoded pages for
+    // the texture cache to hold all of them, so the runs measure drawing
+    // rather than decoding.
+    const uint16_t texpage = (random32() % 4)                          |
+                             ((depth == 8) ? 0x80 : 0)                 |
+                             ((depth == 15) ? 0x100 : 0)               |
+                             ((blend != BLEND_OPAQUE) ? (blend << 5) : 0);
+
+    const uint16_t palette = (uint16_t)(((256 + (random32() % 2)) << 6) | 8);
+
+    primitive->flags = (shading == SHADING_GOURAUD) ? DRAW_FLAG_SHADED :
+                                                       DRAW_FLAG_MONOCHROME;
+
+    if (depth != 0)
+    {
+        primitive->flags |= DRAW_FLAG_TEXTURED |
+                            ((shading == SHADING_RAW) ?
+                             DRAW_FLAG_RAW_TEXTURE    :
+                             DRAW_FLAG_TEXTURE_BLENDING);
+    }
+
+    if (blend == BLEND_OPAQUE)
+    {
+        primitive->flags |= DRAW_FLAG_OPAQUE;
+    }
+
+    primitive->draw_mode = texpage;
+
+    // The corners of a `size` x `size` square, with the two far corners
+    // moved inwards by up to half the size.
+    const int jitter1 = (int)random_range(0, (unsigned int)size / 2);
+    const int jitter2 = (int)random_range(0, (unsigned int)size / 2);
+
+    const int positions[3][2] =
+    {
+        { x,                y                },
+        { x + size - 1,     y + jitter1      },
+        { x + jitter2,      y + size - 1     }
+    };
+
+    // Both windings are drawn.
+    const bool swap = random32() & 1;
+
+    for (unsigned int i = 0; i < 3; ++i)
+    {
+        const unsigned int j = (swap && (i != 0)) ? (3 - i) : i;
+
+        struct libps_gpu_vertex* v = &primitive->v[i];
+
+        v->x = (int16_t)positions[j][0];
+        v->y = (int16_t)positions[j][1];
+
+        v->color    = random32() & 0x00FFFFFF;
+        v->palette  = palette;
+        v->texpage  = texpage;
+        v->texcoord = (uint16_t)((((positions[j][1] - y) & 0xFF) << 8) |
+                                 ((positions[j][0] - x) & 0xFF));
+    }
+
+    if (shading != SHADING_GOURAUD)
+    {
+        primitive->v[1].color = primitive->v[0].color;
+        primitive->v[2].color = primitive->v[0].color;
+    }
+
+    primitive->width  = (unsigned int)size;
+    primitive->height = (unsigned int)size;
+}
+
+// Draws the `count` primitives `primitives`.
+static void draw_primitives(struct libps_gpu* gpu,
+                            struct primitive* primitives,
+                            const unsigned int count,
+                            const bool rects)
+{
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        struct primitive* primitive = &primitives[i];
+
+        gpu->cmd_packet.flags = primitive->flags;
+        gpu->draw_mode        = primitive->draw_mode;
+
+        if (rects)
+        {
+            gpu->renderer->draw_rect(gpu,
+                                     &primitive->v[0],
+                                     primitive->width,
+                                     primitive->height);
+        }
+        else
+        {
+            gpu->renderer->draw_polygon(gpu,
+                                        &primitive->v[0],
+                                        &primitive->v[1],
+                                        &primitive->v[2]);
+        }
+    }
+
+    // Drawing may still be in progress on other threads.
+    libps_gpu_sync(gpu);
+}
+
+// Returns the current time in seconds.
+static double now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+
+    return (double)ts.tv_sec + ((double)ts.tv_nsec / 1e9);
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+// Prints the median, minimum, maximum and relative standard deviation of the
+// `count` values `values`, sorting them.
+static void print_statistics(const char* name,
+                             double* values,
+                             const unsigned int count)
+{
+    qsort(values, count, sizeof(double), &compare_doubles);
+
+    double sum = 0.0;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        sum += values[i];
+    }
+
+    const double mean = sum / count;
+    double variance   = 0.0;
+
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        variance += (values[i] - mean) * (values[i] - mean);
+    }
+    variance /= count;
+
+    const double median = (count % 2) ?
+                          values[count / 2] :
+                          ((values[(count / 2) - 1] + values[count / 2]) / 2);
+
+    printf("%-14s median %10.3f  min %10.3f  max %10.3f  stddev %5.2f%%\n",
+           name,
+           median,
+           values[0],
+           values[count - 1],
+           (mean > 0.0) ? ((sqrt(variance) / mean) * 100.0) : 0.0);
+}
+
+int main(int argc, char** argv)
+{
+    struct options options;
+
+    if (!parse_options(argc, argv, &options))
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    struct libps_scheduler scheduler;
+    struct libps_gpu gpu;
+
+    libps_gpu_setup(&gpu, &scheduler);
+    libps_scheduler_reset(&scheduler);
+    libps_gpu_reset(&gpu);
+
+    if (options.threads > 1)
+    {
+        libps_renderer_sw_mt_setup(&gpu, options.threads);
+    }
+    libps_gpu_set_scale(&gpu, options.scale);
+
+    // Random textures and palettes
+    for (unsigned int y = 0; y < LIBPS_GPU_VRAM_HEIGHT; ++y)
+    {
+        for (unsigned int x = 0; x < CLIP_X1; ++x)
+        {
+            gpu.vram[(y * LIBPS_GPU_VRAM_WIDTH) + x] = (uint16_t)random32();
+        }
+    }
+    libps_gpu_mark_vram(&gpu, 0, 0, CLIP_X1, LIBPS_GPU_VRAM_HEIGHT);
+
+    gpu.drawing_area.x1 = CLIP_X1;
+    gpu.drawing_area.y1 = CLIP_Y1;
+    gpu.drawing_area.x2 = CLIP_X2;
+    gpu.drawing_area.y2 = CLIP_Y2;
+
+    struct primitive* primitives =
+    malloc(options.count * sizeof(struct primitive));
+
+    double* mpixels               = malloc(options.runs * sizeof(double));
+    double* primitives_per_second = malloc(options.runs * sizeof(double));
+
+    if (!primitives || !mpixels || !primitives_per_second)
+    {
+        fprintf(stderr, "swbench: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    double pixels = 0.0;
+
+    for (unsigned int i = 0; i < options.count; ++i)
+    {
+        generate_primitive(&options, &primitives[i]);
+        pixels += visible_area(&primitives[i], options.rects);
+    }
+
+    printf("%u %s of %u-%u pixels, %.1f pixels each on average, "
+           "%u thread%s, scale %u\n",
+           options.count,
+           options.rects ? "rectangles" : "triangles",
+           options.min_size,
+           options.max_size,
+           pixels / options.count,
+           options.threads,
+           (options.threads == 1) ? "" : "s",
+           options.scale);
+
+    // The first run warms up the caches, including the texture cache.
+    draw_primitives(&gpu, primitives, options.count, options.rects);
+
+    for (unsigned int run = 0; run < options.runs; ++run)
+    {
+        const double start = now();
+        draw_primitives(&gpu, primitives, options.count, options.rects);
+        const double time = now() - start;
+
+        mpixels[run]               = (pixels / time) / 1e6;
+        primitives_per_second[run] = options.count / time;
+    }
+
+    print_statistics("Mpixels/s", mpixels, options.runs);
+    print_statistics("primitives/s", primitives_per_second, options.runs);
+
+    free(primitives_per_second);
+    free(mpixels);
+    free(primitives);
+
+    libps_gpu_cleanup(&gpu);
+    return EXIT_SUCCESS;
+}
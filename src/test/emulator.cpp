@@ -25,6 +25,20 @@ Emulator::Emulator(QObject* parent, const QString& bios_file) : QThread(parent)
     fclose(bios_file_handle);
 
     sys = libps_system_create(bios);
+    vram_stamp   = 0;
+    display_area = {};
+
+    gpu_recording_changed = false;
+    gpu_stats_enabled     = false;
+
+    frame_skipping_enabled = false;
+    skipping_frame         = false;
+
+    // The statistics are passed to the GUI thread by value.
+    qRegisterMetaType<libps_gpu_stats>();
+
+    libps_system_set_render_threads(sys, 0);
+    libps_system_set_gpu_thread(sys, QThread::idealThreadCount() > 1);
 
     sys->bus.cdrom.user_data = this;
 
@@ -69,8 +83,6 @@ Emulator::Emulator(QObject* parent, const QString& bios_file) : QThread(parent)
     tracing = false;
 
     trace_file = fopen("trace.txt", "w");
-
-    total_cycles = 0;
 }
 
 Emulator::~Emulator()
@@ -96,8 +108,6 @@ void Emulator::stop_run_loop()
     {
         running = false;
         libps_system_reset(sys);
-
-        total_cycles = 0;
         exit();
     }
 }
@@ -142,10 +152,44 @@ void Emulator::run_ps_x_exe(const QString& file_name)
     start_run_loop();
 }
 
+// Starts recording the GPU commands into `file_name` at the start of the
+// next frame. See gpu_recorder.h.
+void Emulator::start_gpu_recording(const QString& file_name)
+{
+    QMutexLocker lock(&gpu_recording_mutex);
+
+    gpu_recording_file    = file_name;
+    gpu_recording_changed = true;
+}
+
+// Stops recording the GPU commands at the start of the next frame.
+void Emulator::stop_gpu_recording()
+{
+    QMutexLocker lock(&gpu_recording_mutex);
+
+    gpu_recording_file.clear();
+    gpu_recording_changed = true;
+}
+
+// Starts (`enabled` is `true`) or stops collecting GPU statistics at the start
+// of the next frame.
+void Emulator::set_gpu_stats_enabled(const bool enabled)
+{
+    gpu_stats_enabled.storeRelease(enabled);
+}
+
+// Allows (`enabled` is `true`) or disallows skipping the drawing of the next
+// frame whenever a frame took longer to emulate than it lasts on the real
+// system. Skipped frames are not rendered.
+void Emulator::set_frame_skipping_enabled(const bool enabled)
+{
+    frame_skipping_enabled.storeRelease(enabled);
+}
+
 // Returns the number of total cycles taken by the emulator.
-unsigned int Emulator::total_cycles_taken() noexcept
+quint64 Emulator::total_cycles_taken() noexcept
 {
-    return total_cycles;
+    return sys->bus.scheduler.cycles;
 }
 
 // Called when it is time to inject the PS-X EXE specified by `run_ps_x_exe()`.
@@ -204,10 +248,37 @@ void Emulator::run()
         QElapsedTimer timer;
         timer.start();
 
-        for (unsigned int cycle = 0;
-             cycle < 33868800 / 60;
-             cycle += 2,
-             total_cycles += 2)
+        {
+            QMutexLocker lock(&gpu_recording_mutex);
+
+            if (gpu_recording_changed)
+            {
+                if (gpu_recording_file.isEmpty())
+                {
+                    libps_gpu_stop_recording(&sys->bus.gpu);
+                }
+                else
+                {
+                    libps_gpu_start_recording(&sys->bus.gpu,
+                                              qPrintable(gpu_recording_file));
+                }
+                gpu_recording_changed = false;
+            }
+        }
+
+        const bool stats_enabled = gpu_stats_enabled.loadAcquire();
+
+        if (stats_enabled != sys->bus.gpu.stats_enabled)
+        {
+            libps_gpu_set_stats_enabled(&sys->bus.gpu, stats_enabled);
+        }
+
+        // Run until the GPU enters vertical blank, which is when a frame is
+        // complete.
+        const unsigned int frame_count  = sys->bus.gpu.frame_count;
+        const quint64      start_cycles = sys->bus.scheduler.cycles;
+
+        while (sys->bus.gpu.frame_count == frame_count)
         {
             if (!running)
             {
@@ -287,15 +358,76 @@ void Emulator::run()
             libps_system_step(sys);
         }
 
-        sys->bus.i_stat |= LIBPS_IRQ_VBLANK;
+        // The frame is only converted again if VRAM changed or the display
+        // area moved.
+        struct libps_gpu_display_area area;
+        libps_gpu_get_display_area(&sys->bus.gpu, &area);
+
+        uint32_t vram_dirty[LIBPS_GPU_VRAM_DIRTY_WORDS];
+
+        // A skipped frame was never completely drawn, so it isn't rendered.
+        // What it wrote to VRAM stays dirty until the next frame which is.
+        const bool vram_changed =
+        !skipping_frame && libps_gpu_get_dirty_vram(&sys->bus.gpu,
+                                                    &vram_stamp,
+                                                    vram_dirty);
+
+        const bool area_changed =
+        (area.x           != display_area.x)           ||
+        (area.y           != display_area.y)           ||
+        (area.width       != display_area.width)       ||
+        (area.height      != display_area.height)      ||
+        (area.scale       != display_area.scale)       ||
+        (area.color_24bit != display_area.color_24bit) ||
+        (area.disabled    != display_area.disabled);
+
+        if (!skipping_frame && (vram_changed || area_changed) &&
+            (area.width != 0) && (area.height != 0))
+        {
+            display_area = area;
+
+            QImage frame(area.width  * area.scale,
+                         area.height * area.scale,
+                         QImage::Format_RGB32);
+
+            libps_gpu_scanout(&sys->bus.gpu,
+                              &area,
+                              reinterpret_cast<uint32_t*>(frame.bits()),
+                              frame.bytesPerLine() / sizeof(uint32_t),
+                              LIBPS_GPU_SCANOUT_XRGB8888);
+
+            emit render_frame(frame);
+        }
+
+        if (stats_enabled)
+        {
+            struct libps_gpu_stats stats;
+            libps_gpu_get_stats(&sys->bus.gpu, &stats);
+
+            emit gpu_stats(stats);
+        }
 
-        emit render_frame(sys->bus.gpu.vram);
+        // Pace the frame to the amount of time it takes on the real system,
+        // which depends on the video mode.
+        const qint64 frame_time =
+        ((sys->bus.scheduler.cycles - start_cycles) * 1000) / 33868800;
 
         const qint64 elapsed = timer.elapsed();
-           
-        if (elapsed < (1000 / 60))
+
+        // If the frame ran late, the next one is skipped to catch up, but
+        // never two in a row so that something is still shown.
+        const bool skip = frame_skipping_enabled.loadAcquire() &&
+                          !skipping_frame && (elapsed > frame_time);
+
+        if (skip != skipping_frame)
+        {
+            libps_gpu_set_frame_skipping(&sys->bus.gpu, skip);
+            skipping_frame = skip;
+        }
+
+        if (elapsed < frame_time)
         {
-            QThread::msleep((1000 / 60) - elapsed);
+            QThread::msleep(frame_time - elapsed);
         }
     }
 }
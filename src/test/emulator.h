@@ -16,6 +16,8 @@
 
 #include <array>
 #include <QtCore>
+#include <QImage>
+#include "../libps/include/gpu.h"
 
 // Forward declaration
 struct libps_system;
@@ -62,8 +64,25 @@ public:
     // "File -> Run PS-X EXE..." on the main window.
     void run_ps_x_exe(const QString& file_name);
 
+    // Starts recording the GPU commands into `file_name` at the start of the
+    // next frame. See gpu_recorder.h.
+    void start_gpu_recording(const QString& file_name);
+
+    // Stops recording the GPU commands at the start of the next frame.
+    void stop_gpu_recording();
+
+    // Starts (`enabled` is `true`) or stops collecting GPU statistics at the
+    // start of the next frame. While they are collected, `gpu_stats()` is
+    // emitted after every frame.
+    void set_gpu_stats_enabled(const bool enabled);
+
+    // Allows (`enabled` is `true`) or disallows skipping the drawing of the
+    // next frame whenever a frame took longer to emulate than it lasts on
+    // the real system. Skipped frames are not rendered.
+    void set_frame_skipping_enabled(const bool enabled);
+
     // Returns the number of total cycles taken by the emulator.
-    unsigned int total_cycles_taken() noexcept;
+    quint64 total_cycles_taken() noexcept;
 
     
     bool tracing;
@@ -116,9 +135,6 @@ private:
     // Current sector data
     uint8_t sector_data[2352];
 
-    // The total number of cycles taken by the emulator.
-    unsigned int total_cycles;
-
     // Current position in the game image
     unsigned int cdrom_image_pos;
 
@@ -128,6 +144,31 @@ private:
     // Emulator instance
     struct libps_system* sys;
 
+    // VRAM write stamp as of the last frame rendered
+    quint64 vram_stamp;
+
+    // Display area of the last frame rendered
+    struct libps_gpu_display_area display_area;
+
+    // The GPU is only touched by the emulation thread, so requests to start
+    // or stop recording are applied by it between two frames.
+    QMutex gpu_recording_mutex;
+
+    // Has recording been requested to start or stop?
+    bool gpu_recording_changed;
+
+    // File to record into, or empty to stop recording
+    QString gpu_recording_file;
+
+    // Should GPU statistics be collected? Applied between two frames as well.
+    QAtomicInt gpu_stats_enabled;
+
+    // May frames be skipped when emulation falls behind?
+    QAtomicInt frame_skipping_enabled;
+
+    // Is the frame being emulated skipped?
+    bool skipping_frame;
+
 signals:
 #ifdef LIBPS_DEBUG
     // Exception other than an interrupt or system call was raised by the CPU.
@@ -160,6 +201,11 @@ signals:
     // TTY string has been printed
     void tty_string(const QString& string);
 
-    // Time to render a frame
-    void render_frame(const uint16_t* vram);
-};
\ No newline at end of file
+    // Time to render a frame. `frame` holds the display area of VRAM.
+    void render_frame(const QImage& frame);
+
+    // A frame is complete. `stats` holds the GPU statistics of it.
+    void gpu_stats(const struct libps_gpu_stats& stats);
+};
+
+Q_DECLARE_METATYPE(libps_gpu_stats)
\ No newline at end of file
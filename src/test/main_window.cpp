@@ -16,11 +16,11 @@
 
 MainWindow::MainWindow()
 {
-    vram_image = new QImage(1024, 512, QImage::Format_RGB555);
-    vram_image->fill(Qt::black);
+    QImage frame(320, 240, QImage::Format_RGB32);
+    frame.fill(Qt::black);
 
-    vram_image_view = new QLabel(this);
-    vram_image_view->setPixmap(QPixmap::fromImage(*vram_image));
+    frame_view = new QLabel(this);
+    frame_view->setPixmap(QPixmap::fromImage(frame));
 
     file_menu = menuBar()->addMenu(tr("&File"));
 
@@ -52,13 +52,43 @@ MainWindow::MainWindow()
     emulation_menu->addAction(pause_emu);
     emulation_menu->addAction(reset_emu);
 
+    skip_frames = new QAction(tr("Skip frames when slow"), this);
+    skip_frames->setCheckable(true);
+
+    emulation_menu->addSeparator();
+    emulation_menu->addAction(skip_frames);
+
     debug_menu = menuBar()->addMenu(tr("&Debug"));
 
     display_libps_log = new QAction(tr("Display libps log"), this);
     debug_menu->addAction(display_libps_log);
 
+    record_gpu_commands = new QAction(tr("Record GPU commands..."), this);
+    record_gpu_commands->setCheckable(true);
+
+    debug_menu->addAction(record_gpu_commands);
+
+    show_gpu_stats = new QAction(tr("Show GPU statistics"), this);
+    show_gpu_stats->setCheckable(true);
+
+    debug_menu->addAction(show_gpu_stats);
+
+    gpu_stats_view = new QLabel(frame_view);
+    gpu_stats_view->setFont(
+    QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    gpu_stats_view->setStyleSheet("QLabel { color: white; padding: 4px; "
+                                  "background-color: rgba(0, 0, 0, 160); }");
+    gpu_stats_view->move(0, 0);
+    gpu_stats_view->hide();
+
+    connect(show_gpu_stats,
+            &QAction::toggled,
+            gpu_stats_view,
+            &QLabel::setVisible);
+
     setWindowFlags(Qt::MSWindowsFixedSizeDialogHint);
-    setCentralWidget(vram_image_view);
+    setCentralWidget(frame_view);
 }
 
 MainWindow::~MainWindow()
@@ -92,13 +122,36 @@ void MainWindow::on_run_ps_x_exe()
     }
 }
 
-// Updates the VRAM image displayed.
-void MainWindow::render_frame(const uint16_t* vram)
+// Displays `frame`, the display area of VRAM.
+void MainWindow::render_frame(const QImage& frame)
 {
-    memcpy(vram_image->bits(), vram, vram_image->sizeInBytes());
-
-    // This is seriously awful.
-    QImage img = vram_image->rgbSwapped();
+    frame_view->setPixmap(QPixmap::fromImage(frame));
+}
 
-    vram_image_view->setPixmap(QPixmap::fromImage(img));
-}
\ No newline at end of file
+void MainWindow::render_gpu_stats(const struct libps_gpu_stats& stats)
+{
+    const auto line = [](const QString& name, const quint64 value)
+    {
+        return QString("%1 %2\n").arg(name, -16).arg(value, 10);
+    };
+
+    QString text;
+
+    text += line(tr("GP0 words"),         stats.gp0_words);
+    text += line(tr("Triangles"),         stats.triangles);
+    text += line(tr("Quads"),             stats.quads);
+    text += line(tr("Rectangles"),        stats.rectangles);
+    text += line(tr("Lines"),             stats.lines);
+    text += line(tr("Fills"),             stats.fills);
+    text += line(tr("Pixels written"),    stats.pixels_written);
+    text += line(tr("Pixels clipped"),    stats.pixels_clipped);
+    text += line(tr("Pixels masked"),     stats.pixels_masked);
+    text += line(tr("Texture hits"),      stats.texture_cache_hits);
+    text += line(tr("Texture misses"),    stats.texture_cache_misses);
+    text += line(tr("Upload bytes"),      stats.vram_upload_bytes);
+    text += line(tr("Download bytes"),    stats.vram_download_bytes);
+    text += line(tr("Copy bytes"),        stats.vram_copy_bytes);
+
+    gpu_stats_view->setText(text.trimmed());
+    gpu_stats_view->adjustSize();
+}
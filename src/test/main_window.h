@@ -15,6 +15,7 @@
 #pragma once
 
 #include <QtWidgets>
+#include "../libps/include/gpu.h"
 
 class MainWindow : public QMainWindow
 {
@@ -24,8 +25,11 @@ public:
     MainWindow();
     ~MainWindow();
 
-    // Renders the VRAM data.
-    void render_frame(const uint16_t* vram);
+    // Displays `frame`, the display area of VRAM.
+    void render_frame(const QImage& frame);
+
+    // Displays `stats`, the GPU statistics of the last frame, over the frame.
+    void render_gpu_stats(const struct libps_gpu_stats& stats);
 
     // "File -> Insert CD-ROM image..."
     QAction* insert_cdrom_image;
@@ -36,6 +40,12 @@ public:
     // "Debug -> Display libps log"
     QAction* display_libps_log;
 
+    // "Debug -> Record GPU commands...", checked while recording
+    QAction* record_gpu_commands;
+
+    // "Debug -> Show GPU statistics", checked while they are shown
+    QAction* show_gpu_stats;
+
     // "Emulation -> Start" or "Emulation -> Resume" depending on the run state
     // of the emulator
     QAction* start_emu;
@@ -49,12 +59,16 @@ public:
     // "Emulation -> Reset"
     QAction* reset_emu;
 
+    // "Emulation -> Skip frames when slow", checked while frames may be
+    // skipped
+    QAction* skip_frames;
+
 private:
-    // Image
-    QImage* vram_image;
+    // Frame view
+    QLabel* frame_view;
 
-    // Image view
-    QLabel* vram_image_view;
+    // GPU statistics, shown over the top left corner of the frame view
+    QLabel* gpu_stats_view;
 
     QMenu* file_menu;
     QMenu* emulation_menu;
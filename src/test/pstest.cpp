@@ -65,6 +65,7 @@ staging:
 
     connect(emulator, &Emulator::finished,     emulator,    &QObject::deleteLater);
     connect(emulator, &Emulator::render_frame, main_window, &MainWindow::render_frame);
+    connect(emulator, &Emulator::gpu_stats,    main_window, &MainWindow::render_gpu_stats);
     connect(emulator, &Emulator::system_error, this,        &PSTest::emu_report_system_error);
     connect(emulator, &Emulator::bios_call,    this,        &PSTest::emu_bios_call);
 
@@ -84,9 +85,12 @@ staging:
     connect(main_window->stop_emu,  &QAction::triggered, this, &PSTest::stop_emu);
     connect(main_window->reset_emu, &QAction::triggered, this, &PSTest::reset_emu);
     connect(main_window->pause_emu, &QAction::triggered, this, &PSTest::pause_emu);
+    connect(main_window->skip_frames, &QAction::toggled, this, &PSTest::skip_frames);
 
     // "Debug" menu
-    connect(main_window->display_libps_log, &QAction::triggered, this, &PSTest::display_libps_log);
+    connect(main_window->display_libps_log,   &QAction::triggered, this, &PSTest::display_libps_log);
+    connect(main_window->record_gpu_commands, &QAction::toggled,   this, &PSTest::record_gpu_commands);
+    connect(main_window->show_gpu_stats,      &QAction::toggled,   this, &PSTest::show_gpu_stats);
 
     main_window->setWindowTitle("libps debugging station");
     main_window->resize(1024, 512);
@@ -135,6 +139,37 @@ void PSTest::display_libps_log()
     libps_log->show();
 }
 
+// Called when the user toggles `Debug -> Record GPU commands...`.
+void PSTest::record_gpu_commands(const bool checked)
+{
+    if (!checked)
+    {
+        emulator->stop_gpu_recording();
+        return;
+    }
+
+    const QString file_name =
+    QFileDialog::getSaveFileName(main_window,
+                                 tr("Save GPU command dump"),
+                                 "",
+                                 tr("GPU command dumps (*.gpudump)"));
+
+    if (file_name.isEmpty())
+    {
+        main_window->record_gpu_commands->setChecked(false);
+    }
+    else
+    {
+        emulator->start_gpu_recording(file_name);
+    }
+}
+
+// Called when the user toggles `Debug -> Show GPU statistics`.
+void PSTest::show_gpu_stats(const bool checked)
+{
+    emulator->set_gpu_stats_enabled(checked);
+}
+
 // Called when the user triggers `Emulation -> Start`. This function is also
 // called upon startup, and is used also to resume emulation from a paused
 // state.
@@ -187,6 +222,12 @@ void PSTest::reset_emu()
     emulator->start_run_loop();
 }
 
+// Called when the user toggles `Emulation -> Skip frames when slow`.
+void PSTest::skip_frames(const bool checked)
+{
+    emulator->set_frame_skipping_enabled(checked);
+}
+
 // Called when a TTY string has been generated
 void PSTest::on_tty_string(const QString& tty_string)
 {
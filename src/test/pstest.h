@@ -38,6 +38,12 @@ private:
     // Called when the user triggers `Debug -> Display libps log`.
     void display_libps_log();
 
+    // Called when the user toggles `Debug -> Record GPU commands...`.
+    void record_gpu_commands(const bool checked);
+
+    // Called when the user toggles `Debug -> Show GPU statistics`.
+    void show_gpu_stats(const bool checked);
+
     // Called when the user triggers `Emulation -> Start`. This function is
     // also called upon startup, and is used also to resume emulation from a
     // paused state.
@@ -52,6 +58,9 @@ private:
     // Called when the user triggers `Emulation -> Reset`.
     void reset_emu();
 
+    // Called when the user toggles `Emulation -> Skip frames when slow`.
+    void skip_frames(const bool checked);
+
 #ifdef LIBPS_DEBUG
     // Called when an unknown word load has been attempted
     void on_debug_unknown_memory_load(const uint32_t paddr,